@@ -0,0 +1,528 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <glib/gi18n.h>
+#include <math.h>
+#include <string.h>
+#include "analysis.h"
+#include "dsp.h"
+#include "main.h"
+#include "trace.h"
+
+#define ANALYSIS_STEPS_PER_SECOND 10
+#define ANALYSIS_SEGMENT_STEPS 300
+#define ANALYSIS_WARMUP_STEPS 5
+#define ANALYSIS_BLOCK_STEPS 4
+#define ANALYSIS_SHORT_TERM_STEPS 30
+#define ANALYSIS_PHASES 4
+#define ANALYSIS_TAPS 12
+#define ANALYSIS_ABSOLUTE_GATE -70.0
+#define ANALYSIS_RELATIVE_GATE -10.0
+
+typedef struct
+{
+    ChunkHandle *pChunkHandle;
+    guint nChannels;
+    guint nStep;
+    gdouble *lWeights;
+    DspBiquad cPreFilter;
+    DspBiquad cRlbFilter;
+
+} AnalysisSource;
+
+typedef struct
+{
+    gfloat lTaps[ANALYSIS_PHASES * ANALYSIS_TAPS];
+    gint bCancel;
+    GMutex pMutex;
+    GCond pCond;
+    gint64 nFramesDone;
+    guint nDone;
+
+} AnalysisShared;
+
+typedef struct
+{
+    AnalysisShared *pShared;
+    AnalysisSource *pSource;
+    gint64 nStartFrame;
+    gint64 nFrames;
+    gint64 nWarmupFrames;
+    gfloat *lPeak;
+    gfloat *lTruePeak;
+    gdouble *lSum;
+    gdouble *lSquares;
+    gdouble *lSteps;
+    guint nSteps;
+    gboolean bError;
+
+} AnalysisJob;
+
+typedef struct
+{
+    gfloat *lBuffer;
+    gfloat *lPlanar;
+    gfloat *lWeighted;
+    DspBiquad *lPreFilters;
+    DspBiquad *lRlbFilters;
+
+} AnalysisState;
+
+static gdouble analysis_GetLoudness(gdouble fEnergy)
+{
+    return (fEnergy > 0) ? -0.691 + 10.0 * log10(fEnergy) : -INFINITY;
+}
+
+static gfloat analysis_GetDecibels(gdouble fValue)
+{
+    return (fValue > 0) ? (gfloat)(20.0 * log10(fValue)) : -INFINITY;
+}
+
+// ITU-R BS.1770 K-weighting, designed for the actual rate instead of using the 48 kHz coefficients
+
+static void analysis_InitFilters(AnalysisSource *pSource, guint nRate)
+{
+    gdouble fK = tan(G_PI * 1681.974450955533 / nRate);
+    gdouble fQ = 0.7071752369554196;
+    gdouble fVh = pow(10.0, 3.999843853973347 / 20.0);
+    gdouble fVb = pow(fVh, 0.4996667741545416);
+    gdouble fA0 = 1.0 + fK / fQ + fK * fK;
+    pSource->cPreFilter = (DspBiquad){(fVh + fVb * fK / fQ + fK * fK) / fA0, 2.0 * (fK * fK - fVh) / fA0, (fVh - fVb * fK / fQ + fK * fK) / fA0, 2.0 * (fK * fK - 1.0) / fA0, (1.0 - fK / fQ + fK * fK) / fA0, 0, 0};
+
+    fK = tan(G_PI * 38.13547087602444 / nRate);
+    fQ = 0.5003270373238773;
+    fA0 = 1.0 + fK / fQ + fK * fK;
+    pSource->cRlbFilter = (DspBiquad){1.0, -2.0, 1.0, 2.0 * (fK * fK - 1.0) / fA0, (1.0 - fK / fQ + fK * fK) / fA0, 0, 0};
+}
+
+// Blackman windowed sinc, stored newest sample last so it lines up with the history in dsp_InterpolatedPeak
+
+static void analysis_InitTaps(AnalysisShared *pShared)
+{
+    gint nCentre = (ANALYSIS_PHASES * ANALYSIS_TAPS) / 2;
+
+    for (guint nPhase = 0; nPhase < ANALYSIS_PHASES; nPhase++)
+    {
+        for (guint nTap = 0; nTap < ANALYSIS_TAPS; nTap++)
+        {
+            gint nIndex = nPhase + ANALYSIS_PHASES * (ANALYSIS_TAPS - 1 - nTap);
+            gdouble fTime = GDOUBLE(nIndex - nCentre) / ANALYSIS_PHASES;
+            gdouble fSinc = (nIndex == nCentre) ? 1.0 : sin(G_PI * fTime) / (G_PI * fTime);
+            gdouble fWindow = 0.42 + 0.5 * cos(G_PI * (nIndex - nCentre) / nCentre) + 0.08 * cos(2.0 * G_PI * (nIndex - nCentre) / nCentre);
+            pShared->lTaps[nPhase * ANALYSIS_TAPS + nTap] = (gfloat)(fSinc * fWindow);
+        }
+    }
+}
+
+static void analysis_InitWeights(AnalysisSource *pSource, GstAudioInfo *pAudioInfo)
+{
+    pSource->lWeights = g_malloc(sizeof(gdouble) * pSource->nChannels);
+
+    for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+    {
+        switch (pAudioInfo->position[nChannel])
+        {
+            case GST_AUDIO_CHANNEL_POSITION_LFE1:
+                pSource->lWeights[nChannel] = 0.0;
+                break;
+            case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+            case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+            case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+            case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+                pSource->lWeights[nChannel] = 1.41;
+                break;
+            default:
+                pSource->lWeights[nChannel] = 1.0;
+                break;
+        }
+    }
+}
+
+static gboolean analysis_Process(AnalysisJob *pJob, AnalysisState *pState, gint64 nStartFrame, guint nFrames, gboolean bMeasure, gdouble *fEnergy)
+{
+    AnalysisShared *pShared = pJob->pShared;
+    AnalysisSource *pSource = pJob->pSource;
+
+    for (guint nFrame = 0; nFrame < nFrames;)
+    {
+        guint nRead = chunk_Read(pSource->pChunkHandle, nStartFrame + nFrame, nFrames - nFrame, (gchar*)(pState->lBuffer + nFrame * pSource->nChannels), TRUE, FALSE);
+
+        if (nRead == 0)
+        {
+            return TRUE;
+        }
+
+        nFrame += nRead;
+    }
+
+    guint nPlaneSize = ANALYSIS_TAPS - 1 + pSource->nStep;
+    *fEnergy = 0;
+
+    for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+    {
+        gfloat *lPlane = pState->lPlanar + nChannel * nPlaneSize;
+        gfloat *lSamples = lPlane + ANALYSIS_TAPS - 1;
+        dsp_Deinterleave(pState->lBuffer, nFrames, pSource->nChannels, nChannel, lSamples);
+        dsp_Biquad(&pState->lPreFilters[nChannel], lSamples, pState->lWeighted, nFrames);
+        dsp_Biquad(&pState->lRlbFilters[nChannel], pState->lWeighted, pState->lWeighted, nFrames);
+
+        if (bMeasure)
+        {
+            pJob->lPeak[nChannel] = MAX(pJob->lPeak[nChannel], dsp_Peak(lSamples, nFrames));
+            pJob->lTruePeak[nChannel] = MAX(pJob->lTruePeak[nChannel], dsp_InterpolatedPeak(lSamples, nFrames, pShared->lTaps, ANALYSIS_TAPS, ANALYSIS_PHASES));
+            dsp_Sums(lSamples, nFrames, &pJob->lSum[nChannel], &pJob->lSquares[nChannel]);
+
+            if (pSource->lWeights[nChannel] > 0)
+            {
+                gdouble fSum = 0;
+                gdouble fSquares = 0;
+                dsp_Sums(pState->lWeighted, nFrames, &fSum, &fSquares);
+                *fEnergy += pSource->lWeights[nChannel] * fSquares / nFrames;
+            }
+        }
+
+        memmove(lPlane, lPlane + nFrames, sizeof(gfloat) * (ANALYSIS_TAPS - 1));
+    }
+
+    return FALSE;
+}
+
+// Each segment is preceded by a short warm-up so the filters and the interpolator carry the same state as a sequential pass would
+
+static void analysis_OnSegment(gpointer pData, gpointer pUserData)
+{
+    AnalysisJob *pJob = pData;
+    AnalysisShared *pShared = pUserData;
+    AnalysisSource *pSource = pJob->pSource;
+    gint64 nTraceStart = trace_Begin();
+    AnalysisState cState;
+    cState.lBuffer = g_malloc(sizeof(gfloat) * pSource->nStep * pSource->nChannels);
+    cState.lPlanar = g_malloc0(sizeof(gfloat) * (ANALYSIS_TAPS - 1 + pSource->nStep) * pSource->nChannels);
+    cState.lWeighted = g_malloc(sizeof(gfloat) * pSource->nStep);
+    cState.lPreFilters = g_malloc(sizeof(DspBiquad) * pSource->nChannels);
+    cState.lRlbFilters = g_malloc(sizeof(DspBiquad) * pSource->nChannels);
+
+    for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+    {
+        cState.lPreFilters[nChannel] = pSource->cPreFilter;
+        cState.lRlbFilters[nChannel] = pSource->cRlbFilter;
+    }
+
+    gdouble fEnergy = 0;
+
+    for (gint64 nFrame = 0; nFrame < pJob->nWarmupFrames && !pJob->bError;)
+    {
+        guint nFrames = MIN(pSource->nStep, pJob->nWarmupFrames - nFrame);
+        pJob->bError = analysis_Process(pJob, &cState, pJob->nStartFrame - pJob->nWarmupFrames + nFrame, nFrames, FALSE, &fEnergy);
+        nFrame += nFrames;
+    }
+
+    for (gint64 nFrame = 0; nFrame < pJob->nFrames && !pJob->bError && !g_atomic_int_get(&pShared->bCancel);)
+    {
+        guint nFrames = MIN(pSource->nStep, pJob->nFrames - nFrame);
+        pJob->bError = analysis_Process(pJob, &cState, pJob->nStartFrame + nFrame, nFrames, TRUE, &fEnergy);
+
+        if (nFrames == pSource->nStep)
+        {
+            pJob->lSteps[pJob->nSteps++] = fEnergy;
+        }
+
+        nFrame += nFrames;
+        g_mutex_lock(&pShared->pMutex);
+        pShared->nFramesDone += nFrames;
+        g_mutex_unlock(&pShared->pMutex);
+    }
+
+    g_free(cState.lRlbFilters);
+    g_free(cState.lPreFilters);
+    g_free(cState.lWeighted);
+    g_free(cState.lPlanar);
+    g_free(cState.lBuffer);
+    trace_End("analysis_OnSegment", nTraceStart);
+    g_mutex_lock(&pShared->pMutex);
+    pShared->nDone++;
+    g_cond_broadcast(&pShared->pCond);
+    g_mutex_unlock(&pShared->pMutex);
+}
+
+static void analysis_GetLoudnessRange(gdouble *lSteps, guint nSteps, Analysis *pAnalysis)
+{
+    guint nBlocks = (nSteps >= ANALYSIS_BLOCK_STEPS) ? nSteps - ANALYSIS_BLOCK_STEPS + 1 : 0;
+    gdouble fAbsolute = pow(10.0, (ANALYSIS_ABSOLUTE_GATE + 0.691) / 10.0);
+    gdouble *lBlocks = g_malloc(sizeof(gdouble) * MAX(nBlocks, 1));
+    gdouble fTotal = 0;
+    guint nGated = 0;
+
+    for (guint nBlock = 0; nBlock < nBlocks; nBlock++)
+    {
+        lBlocks[nBlock] = 0;
+
+        for (guint nStep = 0; nStep < ANALYSIS_BLOCK_STEPS; nStep++)
+        {
+            lBlocks[nBlock] += lSteps[nBlock + nStep] / ANALYSIS_BLOCK_STEPS;
+        }
+
+        if (lBlocks[nBlock] > fAbsolute)
+        {
+            fTotal += lBlocks[nBlock];
+            nGated++;
+        }
+    }
+
+    gdouble fRelative = nGated ? (fTotal / nGated) * pow(10.0, ANALYSIS_RELATIVE_GATE / 10.0) : 0;
+    fTotal = 0;
+    nGated = 0;
+
+    for (guint nBlock = 0; nBlock < nBlocks; nBlock++)
+    {
+        if (lBlocks[nBlock] > fAbsolute && lBlocks[nBlock] > fRelative)
+        {
+            fTotal += lBlocks[nBlock];
+            nGated++;
+        }
+    }
+
+    pAnalysis->fIntegrated = (gfloat)(nGated ? analysis_GetLoudness(fTotal / nGated) : -INFINITY);
+    pAnalysis->fShortTermMax = -INFINITY;
+
+    for (guint nStart = 0; nStart + ANALYSIS_SHORT_TERM_STEPS <= nSteps; nStart++)
+    {
+        gdouble fEnergy = 0;
+
+        for (guint nStep = 0; nStep < ANALYSIS_SHORT_TERM_STEPS; nStep++)
+        {
+            fEnergy += lSteps[nStart + nStep] / ANALYSIS_SHORT_TERM_STEPS;
+        }
+
+        pAnalysis->fShortTermMax = MAX(pAnalysis->fShortTermMax, (gfloat)analysis_GetLoudness(fEnergy));
+    }
+
+    g_free(lBlocks);
+}
+
+// Jobs are the segments of every region, so several files are analysed side by side on one pool
+
+gboolean analysis_Regions(AnalysisRegion *lRegions, guint nRegions, Progress *pProgress)
+{
+    AnalysisSource *lSources = g_malloc0(sizeof(AnalysisSource) * nRegions);
+    GList *lJobs = NULL;
+    gint64 nTotalFrames = 0;
+    gboolean bError = FALSE;
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        g_object_ref(lRegions[nRegion].pChunk);
+        lSources[nRegion].pChunkHandle = chunk_Open(lRegions[nRegion].pChunk, FALSE);
+        bError |= (lSources[nRegion].pChunkHandle == NULL) || (lRegions[nRegion].nFrames <= 0);
+        nTotalFrames += lRegions[nRegion].nFrames;
+    }
+
+    if (bError || nRegions == 0)
+    {
+        for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+        {
+            if (lSources[nRegion].pChunkHandle)
+            {
+                chunk_Close(lSources[nRegion].pChunkHandle, FALSE);
+            }
+
+            g_object_unref(lRegions[nRegion].pChunk);
+        }
+
+        g_free(lSources);
+
+        return TRUE;
+    }
+
+    progress_Begin(pProgress, _("Analysing"));
+
+    AnalysisShared cShared = {.bCancel = FALSE};
+    g_mutex_init(&cShared.pMutex);
+    g_cond_init(&cShared.pCond);
+    analysis_InitTaps(&cShared);
+    GThreadPool *pPool = g_thread_pool_new(analysis_OnSegment, &cShared, MAX(1, g_get_num_processors()), FALSE, NULL);
+    guint nJobs = 0;
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        AnalysisRegion *pRegion = &lRegions[nRegion];
+        AnalysisSource *pSource = &lSources[nRegion];
+        pSource->nChannels = pRegion->pChunk->pAudioInfo->channels;
+        pSource->nStep = MAX(1, pRegion->pChunk->pAudioInfo->rate / ANALYSIS_STEPS_PER_SECOND);
+        analysis_InitFilters(pSource, pRegion->pChunk->pAudioInfo->rate);
+        analysis_InitWeights(pSource, pRegion->pChunk->pAudioInfo);
+
+        gint64 nSegmentFrames = (gint64)pSource->nStep * ANALYSIS_SEGMENT_STEPS;
+
+        for (gint64 nOffset = 0; nOffset < pRegion->nFrames; nOffset += nSegmentFrames)
+        {
+            AnalysisJob *pJob = g_malloc0(sizeof(AnalysisJob));
+            pJob->pShared = &cShared;
+            pJob->pSource = pSource;
+            pJob->nStartFrame = pRegion->nStartFrame + nOffset;
+            pJob->nFrames = MIN(nSegmentFrames, pRegion->nFrames - nOffset);
+            pJob->nWarmupFrames = MIN(nOffset, (gint64)pSource->nStep * ANALYSIS_WARMUP_STEPS);
+            pJob->lPeak = g_malloc0(sizeof(gfloat) * pSource->nChannels);
+            pJob->lTruePeak = g_malloc0(sizeof(gfloat) * pSource->nChannels);
+            pJob->lSum = g_malloc0(sizeof(gdouble) * pSource->nChannels);
+            pJob->lSquares = g_malloc0(sizeof(gdouble) * pSource->nChannels);
+            pJob->lSteps = g_malloc(sizeof(gdouble) * ANALYSIS_SEGMENT_STEPS);
+            lJobs = g_list_append(lJobs, pJob);
+            nJobs++;
+        }
+    }
+
+    for (GList *l = lJobs; l != NULL; l = l->next)
+    {
+        g_thread_pool_push(pPool, l->data, NULL);
+    }
+
+    g_mutex_lock(&cShared.pMutex);
+
+    while (cShared.nDone < nJobs)
+    {
+        gint64 nEndTime = g_get_monotonic_time() + 50 * G_TIME_SPAN_MILLISECOND;
+
+        if (!g_cond_wait_until(&cShared.pCond, &cShared.pMutex, nEndTime))
+        {
+            gint64 nFramesDone = cShared.nFramesDone;
+            g_mutex_unlock(&cShared.pMutex);
+
+            if (!bError && progress_Update(pProgress, GFLOAT(nFramesDone) / GFLOAT(nTotalFrames)))
+            {
+                g_atomic_int_set(&cShared.bCancel, TRUE);
+                bError = TRUE;
+            }
+
+            g_mutex_lock(&cShared.pMutex);
+        }
+    }
+
+    g_mutex_unlock(&cShared.pMutex);
+    g_thread_pool_free(pPool, FALSE, TRUE);
+
+    GList *l = lJobs;
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        AnalysisRegion *pRegion = &lRegions[nRegion];
+        AnalysisSource *pSource = &lSources[nRegion];
+        gint64 nSegmentFrames = (gint64)pSource->nStep * ANALYSIS_SEGMENT_STEPS;
+        guint nRegionJobs = (guint)((pRegion->nFrames + nSegmentFrames - 1) / nSegmentFrames);
+        gdouble *lSteps = g_malloc(sizeof(gdouble) * nRegionJobs * ANALYSIS_SEGMENT_STEPS);
+        gdouble *lSum = g_malloc0(sizeof(gdouble) * pSource->nChannels);
+        guint nSteps = 0;
+        gdouble fPeak = 0;
+        gdouble fTruePeak = 0;
+        gdouble fSquares = 0;
+        gdouble fDcOffset = 0;
+
+        for (guint nJob = 0; nJob < nRegionJobs; nJob++, l = l->next)
+        {
+            AnalysisJob *pJob = l->data;
+            bError |= pJob->bError;
+
+            for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+            {
+                fPeak = MAX(fPeak, pJob->lPeak[nChannel]);
+                fTruePeak = MAX(fTruePeak, pJob->lTruePeak[nChannel]);
+                fSquares += pJob->lSquares[nChannel];
+                lSum[nChannel] += pJob->lSum[nChannel];
+            }
+
+            memcpy(lSteps + nSteps, pJob->lSteps, sizeof(gdouble) * pJob->nSteps);
+            nSteps += pJob->nSteps;
+            g_free(pJob->lSteps);
+            g_free(pJob->lSquares);
+            g_free(pJob->lSum);
+            g_free(pJob->lTruePeak);
+            g_free(pJob->lPeak);
+            g_free(pJob);
+        }
+
+        for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+        {
+            fDcOffset = MAX(fDcOffset, fabs(lSum[nChannel] / pRegion->nFrames));
+        }
+
+        if (!bError)
+        {
+            Analysis *pAnalysis = &pRegion->cAnalysis;
+            pAnalysis->fSamplePeak = analysis_GetDecibels(fPeak);
+            pAnalysis->fTruePeak = analysis_GetDecibels(MAX(fPeak, fTruePeak));
+            pAnalysis->fRms = analysis_GetDecibels(sqrt(fSquares / ((gdouble)pRegion->nFrames * pSource->nChannels)));
+            pAnalysis->fDcOffset = (gfloat)(fDcOffset * 100.0);
+            analysis_GetLoudnessRange(lSteps, nSteps, pAnalysis);
+        }
+
+        g_free(lSum);
+        g_free(lSteps);
+        g_free(pSource->lWeights);
+        chunk_Close(pSource->pChunkHandle, FALSE);
+        g_object_unref(pRegion->pChunk);
+    }
+
+    g_list_free(lJobs);
+    g_free(lSources);
+    g_mutex_clear(&cShared.pMutex);
+    g_cond_clear(&cShared.pCond);
+    progress_End(pProgress);
+
+    return bError;
+}
+
+gboolean analysis_Run(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, Analysis *pAnalysis, Progress *pProgress)
+{
+    AnalysisRegion cRegion = {pChunk, nStartFrame, nFrames};
+
+    if (analysis_Regions(&cRegion, 1, pProgress))
+    {
+        return TRUE;
+    }
+
+    *pAnalysis = cRegion.cAnalysis;
+
+    return FALSE;
+}
+
+// Loudness gain is held back so the true peak stays at or below fCeiling, bLimited tells the caller it fell short of fLevel
+
+gboolean analysis_GetGain(Analysis *pAnalysis, AnalysisTarget nTarget, gdouble fLevel, gdouble fCeiling, gfloat *fFactor, gboolean *bLimited)
+{
+    gfloat fMeasured = (nTarget == ANALYSIS_TARGET_LOUDNESS) ? pAnalysis->fIntegrated : pAnalysis->fSamplePeak;
+    *bLimited = FALSE;
+
+    if (isinf(fMeasured))
+    {
+        return TRUE;
+    }
+
+    gdouble fGain = fLevel - fMeasured;
+
+    if (nTarget == ANALYSIS_TARGET_LOUDNESS && pAnalysis->fTruePeak + fGain > fCeiling)
+    {
+        fGain = fCeiling - pAnalysis->fTruePeak;
+        *bLimited = TRUE;
+    }
+
+    *fFactor = (gfloat)pow(10.0, fGain / 20.0);
+
+    return FALSE;
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef ANALYSIS_H_INCLUDED
+#define ANALYSIS_H_INCLUDED
+
+#define ANALYSIS_CEILING -1.0
+
+#include "chunk.h"
+
+typedef struct
+{
+    gfloat fSamplePeak;
+    gfloat fTruePeak;
+    gfloat fRms;
+    gfloat fDcOffset;
+    gfloat fIntegrated;
+    gfloat fShortTermMax;
+
+} Analysis;
+
+typedef struct
+{
+    Chunk *pChunk;
+    gint64 nStartFrame;
+    gint64 nFrames;
+    Analysis cAnalysis;
+
+} AnalysisRegion;
+
+typedef enum
+{
+    ANALYSIS_TARGET_PEAK,
+    ANALYSIS_TARGET_LOUDNESS
+
+} AnalysisTarget;
+
+gboolean analysis_Regions(AnalysisRegion *lRegions, guint nRegions, Progress *pProgress);
+gboolean analysis_Run(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, Analysis *pAnalysis, Progress *pProgress);
+gboolean analysis_GetGain(Analysis *pAnalysis, AnalysisTarget nTarget, gdouble fLevel, gdouble fCeiling, gfloat *fFactor, gboolean *bLimited);
+
+#endif
@@ -0,0 +1,590 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <glib/gi18n.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "chunk.h"
+#include "export.h"
+#include "analysis.h"
+
+typedef struct
+{
+    gchar *sScriptPath;
+    gchar *sInput;
+    gint nLine;
+    Chunk *pChunk;
+    Progress cProgress;
+
+} BatchState;
+
+static void batch_Error(BatchState *pState, gchar *sMessage)
+{
+    g_printerr("%s:%d: %s\n", pState->sScriptPath, pState->nLine, sMessage);
+}
+
+static void batch_Warning(BatchState *pState, gchar *sMessage)
+{
+    g_printerr("%s:%d: %s %s\n", pState->sScriptPath, pState->nLine, _("Warning:"), sMessage);
+}
+
+static void batch_OnProgressBegin(gchar *sDescription, gpointer pUserData)
+{
+    BatchState *pState = (BatchState*)pUserData;
+
+    if (sDescription == NULL)
+    {
+        sDescription = _("Processing data");
+    }
+
+    g_print("%s: %s...\n", pState->sInput ? pState->sInput : pState->sScriptPath, sDescription);
+}
+
+static void batch_SetChunk(BatchState *pState, Chunk *pChunk)
+{
+    if (pState->pChunk)
+    {
+        g_object_unref(pState->pChunk);
+    }
+
+    pState->pChunk = pChunk;
+}
+
+static gchar *batch_Expand(BatchState *pState, gchar *sToken)
+{
+    if (pState->sInput == NULL || strchr(sToken, '{') == NULL)
+    {
+        return g_strdup(sToken);
+    }
+
+    gchar *sBaseName = g_path_get_basename(pState->sInput);
+    gchar *sExtension = strrchr(sBaseName, '.');
+
+    if (sExtension && sExtension != sBaseName)
+    {
+        *sExtension = '\0';
+    }
+
+    gchar *sDirName = g_path_get_dirname(pState->sInput);
+    gchar *lPlaceholders[] = {"{input}", "{name}", "{dir}", NULL};
+    gchar *lValues[] = {pState->sInput, sBaseName, sDirName, NULL};
+    gchar *sExpanded = g_strdup(sToken);
+
+    for (guint nPlaceholder = 0; lPlaceholders[nPlaceholder] != NULL; nPlaceholder++)
+    {
+        gchar **lParts = g_strsplit(sExpanded, lPlaceholders[nPlaceholder], -1);
+        g_free(sExpanded);
+        sExpanded = g_strjoinv(lValues[nPlaceholder], lParts);
+        g_strfreev(lParts);
+    }
+
+    g_free(sBaseName);
+    g_free(sDirName);
+
+    return sExpanded;
+}
+
+static gboolean batch_ParsePosition(BatchState *pState, gchar *sValue, gint64 *nPosition)
+{
+    gint64 nFrames = pState->pChunk->nFrames;
+    gchar *sEnd = NULL;
+    gint64 nValue;
+
+    if (g_str_equal(sValue, "end"))
+    {
+        *nPosition = nFrames;
+
+        return FALSE;
+    }
+
+    if (g_str_has_suffix(sValue, "s"))
+    {
+        gdouble fSeconds = g_ascii_strtod(sValue, &sEnd);
+        nValue = (gint64)(fSeconds * pState->pChunk->pAudioInfo->rate);
+    }
+    else
+    {
+        nValue = g_ascii_strtoll(sValue, &sEnd, 10);
+    }
+
+    if (sEnd == sValue || (*sEnd != '\0' && !g_str_equal(sEnd, "s")))
+    {
+        gchar *sMessage = g_strdup_printf(_("Invalid position '%s'"), sValue);
+        batch_Error(pState, sMessage);
+        g_free(sMessage);
+
+        return TRUE;
+    }
+
+    if (sValue[0] == '-')
+    {
+        nValue += nFrames;
+    }
+
+    *nPosition = CLAMP(nValue, 0, nFrames);
+
+    return FALSE;
+}
+
+static gboolean batch_ParseNumber(BatchState *pState, gchar *sValue, gdouble *fValue)
+{
+    gchar *sEnd = NULL;
+    *fValue = g_ascii_strtod(sValue, &sEnd);
+
+    if (sEnd == sValue || *sEnd != '\0' || !isfinite(*fValue))
+    {
+        gchar *sMessage = g_strdup_printf(_("Invalid number '%s'"), sValue);
+        batch_Error(pState, sMessage);
+        g_free(sMessage);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean batch_ParseRange(BatchState *pState, gchar *sStart, gchar *sEnd, gint64 *nStart, gint64 *nEnd)
+{
+    if (batch_ParsePosition(pState, sStart, nStart) || batch_ParsePosition(pState, sEnd, nEnd))
+    {
+        return TRUE;
+    }
+
+    if (*nStart >= *nEnd)
+    {
+        batch_Error(pState, _("Empty range"));
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean batch_Load(BatchState *pState, gchar *sFilePath)
+{
+    Chunk *pChunk = chunk_Load(sFilePath, &pState->cProgress);
+
+    if (pChunk == NULL)
+    {
+        return TRUE;
+    }
+
+    batch_SetChunk(pState, pChunk);
+
+    return FALSE;
+}
+
+static gboolean batch_Fade(BatchState *pState, gint64 nStart, gint64 nEnd, gfloat fStartFactor, gfloat fEndFactor)
+{
+    Chunk *pChunkPart = chunk_GetPart(pState->pChunk, nStart, nEnd - nStart);
+    gint64 nPartFrames = pChunkPart->nFrames;
+    Chunk *pChunkFaded = chunk_Fade(pChunkPart, fStartFactor, fEndFactor, &pState->cProgress);
+    g_object_unref(pChunkPart);
+
+    if (!pChunkFaded)
+    {
+        return TRUE;
+    }
+
+    batch_SetChunk(pState, chunk_ReplacePart(pState->pChunk, nStart, nPartFrames, pChunkFaded));
+    g_object_unref(pChunkFaded);
+
+    return FALSE;
+}
+
+static gboolean batch_Mix(BatchState *pState, gchar *sFilePath, gint64 nOffset)
+{
+    Chunk *pChunkOther = chunk_Load(sFilePath, &pState->cProgress);
+
+    if (pChunkOther == NULL)
+    {
+        return TRUE;
+    }
+
+    if (gst_audio_info_is_equal(pState->pChunk->pAudioInfo, pChunkOther->pAudioInfo) == FALSE)
+    {
+        batch_Error(pState, _("You cannot mix different sound formats"));
+        g_object_unref(pChunkOther);
+
+        return TRUE;
+    }
+
+    if (nOffset >= pState->pChunk->nFrames)
+    {
+        Chunk *pChunk = chunk_Append(pState->pChunk, pChunkOther);
+        g_object_unref(pChunkOther);
+        batch_SetChunk(pState, pChunk);
+
+        return FALSE;
+    }
+
+    Chunk *pChunkPart = chunk_GetPart(pState->pChunk, nOffset, MIN(pChunkOther->nFrames, pState->pChunk->nFrames - nOffset));
+    gint64 nPartFrames = pChunkPart->nFrames;
+    Chunk *pChunkMixed = chunk_Mix(pChunkPart, pChunkOther, &pState->cProgress);
+    g_object_unref(pChunkPart);
+    g_object_unref(pChunkOther);
+
+    if (!pChunkMixed)
+    {
+        return TRUE;
+    }
+
+    batch_SetChunk(pState, chunk_ReplacePart(pState->pChunk, nOffset, nPartFrames, pChunkMixed));
+    g_object_unref(pChunkMixed);
+
+    return FALSE;
+}
+
+static gboolean batch_Mixdown(BatchState *pState, gboolean bSoftLimit, gint nArgs, gchar **lArgs)
+{
+    guint nInputs = 1 + nArgs / 3;
+    MixInput *lInputs = g_new0(MixInput, nInputs);
+    lInputs[0].pChunk = g_object_ref(pState->pChunk);
+    lInputs[0].fGain = 1.0;
+    gboolean bError = FALSE;
+
+    for (guint nInput = 1; nInput < nInputs && !bError; nInput++)
+    {
+        gchar **lInput = lArgs + (nInput - 1) * 3;
+        gdouble fGain;
+        bError = batch_ParsePosition(pState, lInput[2], &lInputs[nInput].nOffset) || batch_ParseNumber(pState, lInput[1], &fGain);
+
+        if (bError)
+        {
+            break;
+        }
+
+        lInputs[nInput].fGain = (gfloat)pow(10.0, fGain / 20.0);
+        lInputs[nInput].pChunk = chunk_Load(lInput[0], &pState->cProgress);
+        bError = (lInputs[nInput].pChunk == NULL);
+
+        if (!bError && gst_audio_info_is_equal(pState->pChunk->pAudioInfo, lInputs[nInput].pChunk->pAudioInfo) == FALSE)
+        {
+            batch_Error(pState, _("You cannot mix different sound formats"));
+            bError = TRUE;
+        }
+    }
+
+    Chunk *pChunkMixed = bError ? NULL : chunk_MixInputs(lInputs, nInputs, bSoftLimit, &pState->cProgress);
+
+    for (guint nInput = 0; nInput < nInputs; nInput++)
+    {
+        if (lInputs[nInput].pChunk)
+        {
+            g_object_unref(lInputs[nInput].pChunk);
+        }
+    }
+
+    g_free(lInputs);
+
+    if (!pChunkMixed)
+    {
+        return TRUE;
+    }
+
+    batch_SetChunk(pState, pChunkMixed);
+
+    return FALSE;
+}
+
+static gboolean batch_Normalize(BatchState *pState, AnalysisTarget nTarget, gchar *sLevel, gchar *sCeiling)
+{
+    Analysis cAnalysis;
+    gfloat fFactor;
+    gboolean bLimited;
+    gdouble fLevel;
+    gdouble fCeiling = ANALYSIS_CEILING;
+
+    if (batch_ParseNumber(pState, sLevel, &fLevel) || (sCeiling != NULL && batch_ParseNumber(pState, sCeiling, &fCeiling)))
+    {
+        return TRUE;
+    }
+
+    if (analysis_Run(pState->pChunk, 0, pState->pChunk->nFrames, &cAnalysis, &pState->cProgress))
+    {
+        return TRUE;
+    }
+
+    // A silent stem is left as it is rather than failing the whole run
+    if (analysis_GetGain(&cAnalysis, nTarget, fLevel, fCeiling, &fFactor, &bLimited))
+    {
+        batch_Warning(pState, _("The audio is silent and cannot be normalised"));
+
+        return FALSE;
+    }
+
+    if (bLimited)
+    {
+        gchar *sMessage = g_strdup_printf(_("The gain was limited to keep the peak at %.1f dBTP, the audio is now %.1f LUFS"), fCeiling, cAnalysis.fIntegrated + 20.0 * log10(fFactor));
+        batch_Warning(pState, sMessage);
+        g_free(sMessage);
+    }
+
+    Chunk *pChunk = chunk_Gain(pState->pChunk, fFactor, &pState->cProgress);
+
+    if (!pChunk)
+    {
+        return TRUE;
+    }
+
+    batch_SetChunk(pState, pChunk);
+
+    return FALSE;
+}
+
+static gboolean batch_Execute(BatchState *pState, gint nArgs, gchar **lArgs)
+{
+    gchar *sCommand = lArgs[0];
+    gint64 nStart = 0;
+    gint64 nEnd = 0;
+
+    if (g_str_equal(sCommand, "load") && nArgs == 2)
+    {
+        return batch_Load(pState, lArgs[1]);
+    }
+
+    if (pState->pChunk == NULL)
+    {
+        batch_Error(pState, _("No file loaded"));
+
+        return TRUE;
+    }
+
+    if (g_str_equal(sCommand, "save") && nArgs == 2)
+    {
+        return chunk_Save(pState->pChunk, lArgs[1], &pState->cProgress);
+    }
+    else if (g_str_equal(sCommand, "export") && nArgs >= 4 && (nArgs - 1) % 3 == 0)
+    {
+        guint nRegions = (nArgs - 1) / 3;
+        ExportRegion *lRegions = g_new(ExportRegion, nRegions);
+        gboolean bError = FALSE;
+
+        for (guint nRegion = 0; nRegion < nRegions && !bError; nRegion++)
+        {
+            bError = batch_ParseRange(pState, lArgs[nRegion * 3 + 2], lArgs[nRegion * 3 + 3], &nStart, &nEnd);
+            lRegions[nRegion].nStartFrame = nStart;
+            lRegions[nRegion].nFrames = nEnd - nStart;
+            lRegions[nRegion].sFilePath = lArgs[nRegion * 3 + 1];
+        }
+
+        if (!bError)
+        {
+            bError = export_Regions(pState->pChunk, lRegions, nRegions, &pState->cProgress);
+        }
+
+        g_free(lRegions);
+
+        return bError;
+    }
+    else if (g_str_equal(sCommand, "trim") && nArgs == 3)
+    {
+        if (batch_ParseRange(pState, lArgs[1], lArgs[2], &nStart, &nEnd))
+        {
+            return TRUE;
+        }
+
+        batch_SetChunk(pState, chunk_GetPart(pState->pChunk, nStart, nEnd - nStart));
+
+        return FALSE;
+    }
+    else if (g_str_equal(sCommand, "cut") && nArgs == 3)
+    {
+        if (batch_ParseRange(pState, lArgs[1], lArgs[2], &nStart, &nEnd))
+        {
+            return TRUE;
+        }
+
+        if (nEnd - nStart == pState->pChunk->nFrames)
+        {
+            batch_Error(pState, _("Cannot cut the whole file"));
+
+            return TRUE;
+        }
+
+        batch_SetChunk(pState, chunk_RemovePart(pState->pChunk, nStart, nEnd - nStart));
+
+        return FALSE;
+    }
+    else if (g_str_equal(sCommand, "fade") && nArgs == 5)
+    {
+        gdouble fFrom;
+        gdouble fTo;
+
+        if (batch_ParseRange(pState, lArgs[1], lArgs[2], &nStart, &nEnd) || batch_ParseNumber(pState, lArgs[3], &fFrom) || batch_ParseNumber(pState, lArgs[4], &fTo))
+        {
+            return TRUE;
+        }
+
+        return batch_Fade(pState, nStart, nEnd, fFrom, fTo);
+    }
+    else if (g_str_equal(sCommand, "fadein") && nArgs == 2)
+    {
+        if (batch_ParseRange(pState, "0", lArgs[1], &nStart, &nEnd))
+        {
+            return TRUE;
+        }
+
+        return batch_Fade(pState, nStart, nEnd, 0.0, 1.0);
+    }
+    else if (g_str_equal(sCommand, "fadeout") && nArgs == 2)
+    {
+        if (batch_ParsePosition(pState, lArgs[1], &nEnd))
+        {
+            return TRUE;
+        }
+
+        if (nEnd == 0)
+        {
+            batch_Error(pState, _("Empty range"));
+
+            return TRUE;
+        }
+
+        return batch_Fade(pState, pState->pChunk->nFrames - nEnd, pState->pChunk->nFrames, 1.0, 0.0);
+    }
+    else if (g_str_equal(sCommand, "mixdown") && nArgs >= 5 && nArgs % 3 == 2 && g_str_equal(lArgs[1], "soft"))
+    {
+        return batch_Mixdown(pState, TRUE, nArgs - 2, lArgs + 2);
+    }
+    else if (g_str_equal(sCommand, "mixdown") && nArgs >= 4 && nArgs % 3 == 1)
+    {
+        return batch_Mixdown(pState, FALSE, nArgs - 1, lArgs + 1);
+    }
+    else if (g_str_equal(sCommand, "normalize-peak") && nArgs == 2)
+    {
+        return batch_Normalize(pState, ANALYSIS_TARGET_PEAK, lArgs[1], NULL);
+    }
+    else if (g_str_equal(sCommand, "normalize-loudness") && (nArgs == 2 || nArgs == 3))
+    {
+        return batch_Normalize(pState, ANALYSIS_TARGET_LOUDNESS, lArgs[1], nArgs == 3 ? lArgs[2] : NULL);
+    }
+    else if (g_str_equal(sCommand, "mix") && (nArgs == 2 || nArgs == 3))
+    {
+        if (nArgs == 3 && batch_ParsePosition(pState, lArgs[2], &nStart))
+        {
+            return TRUE;
+        }
+
+        return batch_Mix(pState, lArgs[1], nStart);
+    }
+
+    gchar *sMessage = g_strdup_printf(_("Unknown command or wrong number of arguments: '%s'"), sCommand);
+    batch_Error(pState, sMessage);
+    g_free(sMessage);
+
+    return TRUE;
+}
+
+static gboolean batch_RunScript(BatchState *pState, gchar **lLines)
+{
+    gboolean bError = FALSE;
+
+    if (pState->sInput != NULL)
+    {
+        bError = batch_Load(pState, pState->sInput);
+    }
+
+    for (pState->nLine = 1; !bError && lLines[pState->nLine - 1] != NULL; pState->nLine++)
+    {
+        gchar *sLine = g_strstrip(lLines[pState->nLine - 1]);
+
+        if (sLine[0] == '\0' || sLine[0] == '#')
+        {
+            continue;
+        }
+
+        gint nArgs = 0;
+        gchar **lArgs = NULL;
+        GError *pError = NULL;
+
+        if (!g_shell_parse_argv(sLine, &nArgs, &lArgs, &pError))
+        {
+            batch_Error(pState, pError->message);
+            g_error_free(pError);
+            bError = TRUE;
+
+            break;
+        }
+
+        for (gint nArg = 1; nArg < nArgs; nArg++)
+        {
+            gchar *sExpanded = batch_Expand(pState, lArgs[nArg]);
+            g_free(lArgs[nArg]);
+            lArgs[nArg] = sExpanded;
+        }
+
+        bError = batch_Execute(pState, nArgs, lArgs);
+        g_strfreev(lArgs);
+    }
+
+    batch_SetChunk(pState, NULL);
+
+    return bError;
+}
+
+gint batch_Run(gchar *sScriptPath, gchar **lFiles, gint nFiles)
+{
+    gchar *sScript = NULL;
+    GError *pError = NULL;
+
+    if (!g_file_get_contents(sScriptPath, &sScript, NULL, &pError))
+    {
+        g_printerr("%s\n", pError->message);
+        g_error_free(pError);
+
+        return EXIT_FAILURE;
+    }
+
+    BatchState cState;
+    cState.sScriptPath = sScriptPath;
+    cState.pChunk = NULL;
+    cState.cProgress.pOnBegin = batch_OnProgressBegin;
+    cState.cProgress.pOnProgress = NULL;
+    cState.cProgress.pOnEnd = NULL;
+    cState.cProgress.pUserData = &cState;
+    gint nFailed = 0;
+
+    for (gint nFile = 0; nFile < MAX(nFiles, 1); nFile++)
+    {
+        gchar **lLines = g_strsplit(sScript, "\n", -1);
+        cState.sInput = nFiles ? lFiles[nFile] : NULL;
+
+        if (batch_RunScript(&cState, lLines))
+        {
+            nFailed++;
+        }
+
+        g_strfreev(lLines);
+    }
+
+    g_free(sScript);
+
+    if (nFailed)
+    {
+        g_printerr(_("%d of %d runs failed\n"), nFailed, MAX(nFiles, 1));
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
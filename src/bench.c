@@ -0,0 +1,808 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <gst/app/gstappsink.h>
+#include "bench.h"
+#include "chunk.h"
+#include "blockcache.h"
+#include "export.h"
+#include "scratch.h"
+#include "viewcache.h"
+#include "main.h"
+
+#define BENCH_RATE 48000
+#define BENCH_WIDTH 1920
+#define BENCH_CONVERT_BLOCKS 32
+#define BENCH_STRESS_THREADS 8
+#define BENCH_STRESS_FRAMES 16384
+#define BENCH_STRESS_READS 256
+
+typedef struct
+{
+    guint nChannels;
+    guint nBits;
+    guint nSeconds;
+
+} BenchSource;
+
+typedef struct
+{
+    FILE *pOutput;
+    gchar *sSuite;
+    BenchSource *pSource;
+    guint nParts;
+    GArray *lLatencies;
+    gint64 nTimeLast;
+    gboolean bStressOnly;
+    gboolean bFlacOnly;
+
+} Bench;
+
+typedef struct
+{
+    Chunk *pChunk;
+    guint64 *lHashes[2];
+    guint nBlocks;
+    guint nThread;
+    GArray *lLatencies;
+    guint nMismatches;
+
+} BenchStress;
+
+static BenchSource m_lSourcesQuick[] =
+{
+    {1, 16, 60},
+    {2, 16, 60},
+    {2, 24, 60},
+    {2, 32, 60},
+    {8, 24, 60},
+    {0, 0, 0}
+};
+
+static BenchSource m_lSourcesFull[] =
+{
+    {1, 16, 60},
+    {1, 24, 60},
+    {1, 32, 60},
+    {2, 16, 60},
+    {2, 24, 60},
+    {2, 32, 60},
+    {8, 16, 60},
+    {8, 24, 60},
+    {8, 32, 60},
+    {2, 16, 600},
+    {8, 24, 600},
+    {2, 24, 3600},
+    {8, 32, 3600},
+    {2, 16, 14400},
+    {0, 0, 0}
+};
+
+static BenchSource m_lSourcesFlac[] =
+{
+    {1, 16, 5},
+    {2, 16, 5},
+    {2, 24, 5},
+    {8, 16, 5},
+    {8, 24, 5},
+    {0, 0, 0}
+};
+
+static guint m_lPartsQuick[] = {1, 100, 10000, 0};
+static guint m_lPartsFull[] = {1, 10, 100, 1000, 10000, 0};
+static guint m_lZooms[] = {1, 64, 4096, 0};
+
+static gint64 bench_Now()
+{
+    struct timespec cTime;
+    clock_gettime(CLOCK_MONOTONIC, &cTime);
+
+    return (gint64)cTime.tv_sec * 1000000000 + cTime.tv_nsec;
+}
+
+static gint bench_CompareLatency(gconstpointer pA, gconstpointer pB)
+{
+    gint64 nA = *(gint64*)pA;
+    gint64 nB = *(gint64*)pB;
+
+    return (nA > nB) - (nA < nB);
+}
+
+static gdouble bench_Percentile(GArray *lLatencies, gdouble fPercentile)
+{
+    if (lLatencies->len == 0)
+    {
+        return 0;
+    }
+
+    guint nIndex = (guint)(fPercentile * (lLatencies->len - 1) + 0.5);
+
+    return GDOUBLE(g_array_index(lLatencies, gint64, nIndex)) / 1000.0;
+}
+
+static void bench_Begin(Bench *pBench)
+{
+    g_array_set_size(pBench->lLatencies, 0);
+    pBench->nTimeLast = bench_Now();
+}
+
+static void bench_Lap(Bench *pBench)
+{
+    gint64 nTime = bench_Now();
+    gint64 nLatency = nTime - pBench->nTimeLast;
+    g_array_append_val(pBench->lLatencies, nLatency);
+    pBench->nTimeLast = nTime;
+}
+
+static void bench_Report(Bench *pBench, gchar *sScenario, guint nZoom, gint64 nFrames, gint64 nTime)
+{
+    struct rusage cUsage;
+    getrusage(RUSAGE_SELF, &cUsage);
+    g_array_sort(pBench->lLatencies, bench_CompareLatency);
+    gdouble fSeconds = GDOUBLE(nTime) / 1000000000.0;
+
+    fprintf(pBench->pOutput, "{\"suite\": \"%s\", \"scenario\": \"%s\", \"channels\": %u, \"bits\": %u, \"seconds\": %u, \"parts\": %u, \"zoom\": %u, \"frames\": %"G_GINT64_FORMAT", \"time_s\": %.6f, \"frames_per_second\": %.1f, \"calls\": %u, \"latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}, \"peak_rss_kb\": %ld}\n",
+            pBench->sSuite, sScenario, pBench->pSource->nChannels, pBench->pSource->nBits, pBench->pSource->nSeconds, pBench->nParts, nZoom, nFrames, fSeconds, fSeconds > 0 ? GDOUBLE(nFrames) / fSeconds : 0.0, pBench->lLatencies->len,
+            bench_Percentile(pBench->lLatencies, 0.5), bench_Percentile(pBench->lLatencies, 0.9), bench_Percentile(pBench->lLatencies, 0.99), bench_Percentile(pBench->lLatencies, 1.0), cUsage.ru_maxrss);
+    fflush(pBench->pOutput);
+}
+
+static gboolean bench_OnProgress(gfloat fProgress, gpointer pUserData)
+{
+    bench_Lap((Bench*)pUserData);
+
+    return FALSE;
+}
+
+static void bench_SetAudioInfo(GstAudioInfo *pAudioInfo, BenchSource *pSource)
+{
+    GstAudioFormat nFormat = GST_AUDIO_FORMAT_S16LE;
+
+    if (pSource->nBits == 24)
+    {
+        nFormat = GST_AUDIO_FORMAT_S24LE;
+    }
+    else if (pSource->nBits == 32)
+    {
+        nFormat = GST_AUDIO_FORMAT_S32LE;
+    }
+
+    GstAudioChannelPosition lPositions71[] = {GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT, GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER, GST_AUDIO_CHANNEL_POSITION_LFE1, GST_AUDIO_CHANNEL_POSITION_REAR_LEFT, GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT, GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT, GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT};
+    gst_audio_info_set_format(pAudioInfo, nFormat, BENCH_RATE, pSource->nChannels, pSource->nChannels == 8 ? lPositions71 : NULL);
+}
+
+static gboolean bench_Generate(BenchSource *pSource, gchar *sFilePath)
+{
+    GstAudioInfo cAudioInfo;
+    bench_SetAudioInfo(&cAudioInfo, pSource);
+    GstWriter *pGstWriter = gstwriter_New(sFilePath, &cAudioInfo, "wavenc");
+
+    if (!pGstWriter)
+    {
+        return TRUE;
+    }
+
+    gint64 nFrames = (gint64)pSource->nSeconds * BENCH_RATE;
+    guint nBytesPerSample = pSource->nBits / 8;
+    gdouble fScale = GDOUBLE((G_GINT64_CONSTANT(1) << (pSource->nBits - 1)) - 1);
+    guint nBufferFrames = BUFFER_SIZE / cAudioInfo.bpf;
+    guint8 *lBuffer = g_malloc(nBufferFrames * cAudioInfo.bpf);
+    guint32 nNoise = 1;
+    gboolean bError = FALSE;
+
+    for (gint64 nFrame = 0; nFrame < nFrames && !bError;)
+    {
+        guint nFramesToWrite = MIN(nBufferFrames, nFrames - nFrame);
+        guint8 *pByte = lBuffer;
+
+        for (guint nBufferFrame = 0; nBufferFrame < nFramesToWrite; nBufferFrame++, nFrame++)
+        {
+            for (guint nChannel = 0; nChannel < pSource->nChannels; nChannel++)
+            {
+                nNoise = nNoise * 1664525 + 1013904223;
+                gdouble fSample = 0.5 * sin(2.0 * G_PI * 220.0 * (nChannel + 1) * GDOUBLE(nFrame) / BENCH_RATE) + 0.1 * (GDOUBLE(nNoise) / G_MAXUINT32 - 0.5);
+                gint32 nSample = (gint32)(fSample * fScale);
+
+                for (guint nByte = 0; nByte < nBytesPerSample; nByte++)
+                {
+                    *pByte++ = (guint8)(nSample >> (nByte * 8));
+                }
+            }
+        }
+
+        if (gstwriter_Write(pGstWriter, nFramesToWrite, (gchar*)lBuffer, nFrame == nFrames) != nFramesToWrite)
+        {
+            bError = TRUE;
+        }
+    }
+
+    g_free(lBuffer);
+    gstwriter_Free(pGstWriter);
+
+    return bError;
+}
+
+static Chunk *bench_Fragment(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, guint nParts)
+{
+    if (nParts == 1)
+    {
+        return chunk_GetPart(pChunk, nStartFrame, nFrames);
+    }
+
+    // Build the parts in bit-reversed order, so sequential reads jump around the source like they do after real edits
+    guint nPartsLeft = nParts / 2;
+    gint64 nFramesLeft = nFrames * nPartsLeft / nParts;
+    Chunk *pChunkLeft = bench_Fragment(pChunk, nStartFrame, nFramesLeft, nPartsLeft);
+    Chunk *pChunkRight = bench_Fragment(pChunk, nStartFrame + nFramesLeft, nFrames - nFramesLeft, nParts - nPartsLeft);
+    Chunk *pChunkOut = chunk_Append(pChunkRight, pChunkLeft);
+    g_object_unref(pChunkLeft);
+    g_object_unref(pChunkRight);
+
+    return pChunkOut;
+}
+
+static void bench_ForgetCache(Chunk *pChunk)
+{
+    for (GList *l = pChunk->lParts; l != NULL; l = l->next)
+    {
+        blockcache_Forget(((DataPart*)l->data)->pDataSource);
+    }
+}
+
+static void bench_Read(Bench *pBench, Chunk *pChunk, gboolean bFloat)
+{
+    ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
+
+    if (pChunkHandle == NULL)
+    {
+        return;
+    }
+
+    guint nFrameSize = bFloat ? pChunk->pAudioInfo->channels * 4 : pChunk->pAudioInfo->bpf;
+    gchar *lBuffer = g_malloc(BUFFER_SIZE);
+    gint64 nFrames = 0;
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+
+    while (nFrames < pChunk->nFrames)
+    {
+        guint nFramesRead = chunk_Read(pChunkHandle, nFrames, BUFFER_SIZE / nFrameSize, lBuffer, bFloat, FALSE);
+        bench_Lap(pBench);
+
+        if (nFramesRead == 0)
+        {
+            break;
+        }
+
+        nFrames += nFramesRead;
+    }
+
+    bench_Report(pBench, bFloat ? "chunk_read_float" : "chunk_read", 0, nFrames, bench_Now() - nTimeStart);
+    chunk_Close(pChunkHandle, FALSE);
+    g_free(lBuffer);
+}
+
+static guint64 bench_Hash(gchar *lBytes, gsize nBytes)
+{
+    guint64 nHash = 14695981039346656037ULL;
+
+    for (gsize nByte = 0; nByte < nBytes; nByte++)
+    {
+        nHash = (nHash ^ (guint8)lBytes[nByte]) * 1099511628211ULL;
+    }
+
+    return nHash;
+}
+
+static gpointer bench_OnStress(gpointer pData)
+{
+    BenchStress *pStress = (BenchStress*)pData;
+    gboolean bFloat = pStress->nThread % 2;
+    guint nFrameSize = bFloat ? pStress->pChunk->pAudioInfo->channels * 4 : pStress->pChunk->pAudioInfo->bpf;
+    gchar *lBuffer = g_malloc(BENCH_STRESS_FRAMES * nFrameSize);
+    guint32 nRandom = pStress->nThread + 1;
+
+    for (guint nRead = 0; nRead < BENCH_STRESS_READS; nRead++)
+    {
+        nRandom = nRandom * 1664525 + 1013904223;
+        guint nBlock = nRandom % pStress->nBlocks;
+        gint64 nStartFrame = (gint64)nBlock * BENCH_STRESS_FRAMES;
+        guint nFrames = MIN(BENCH_STRESS_FRAMES, pStress->pChunk->nFrames - nStartFrame);
+        gint64 nTimeStart = bench_Now();
+        guint nFramesRead = chunk_Read(pStress->pChunk, nStartFrame, nFrames, lBuffer, bFloat, FALSE);
+        gint64 nLatency = bench_Now() - nTimeStart;
+        g_array_append_val(pStress->lLatencies, nLatency);
+
+        if (nFramesRead != nFrames || bench_Hash(lBuffer, (gsize)nFrames * nFrameSize) != pStress->lHashes[bFloat][nBlock])
+        {
+            pStress->nMismatches++;
+        }
+    }
+
+    g_free(lBuffer);
+
+    return NULL;
+}
+
+static gboolean bench_Stress(Bench *pBench, Chunk *pChunk)
+{
+    ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
+
+    if (pChunkHandle == NULL)
+    {
+        return TRUE;
+    }
+
+    // Hash every block with a single reader first, then let the threads check their random reads against it
+    guint nBlocks = (pChunk->nFrames + BENCH_STRESS_FRAMES - 1) / BENCH_STRESS_FRAMES;
+    guint64 *lHashes[2] = {g_new(guint64, nBlocks), g_new(guint64, nBlocks)};
+    gchar *lBuffer = g_malloc(BENCH_STRESS_FRAMES * MAX(pChunk->pAudioInfo->bpf, pChunk->pAudioInfo->channels * 4));
+    gboolean bError = FALSE;
+
+    for (guint nFloat = 0; nFloat < 2 && !bError; nFloat++)
+    {
+        guint nFrameSize = nFloat ? pChunk->pAudioInfo->channels * 4 : pChunk->pAudioInfo->bpf;
+
+        for (guint nBlock = 0; nBlock < nBlocks && !bError; nBlock++)
+        {
+            gint64 nStartFrame = (gint64)nBlock * BENCH_STRESS_FRAMES;
+            guint nFrames = MIN(BENCH_STRESS_FRAMES, pChunk->nFrames - nStartFrame);
+            bError = chunk_Read(pChunkHandle, nStartFrame, nFrames, lBuffer, nFloat, FALSE) != nFrames;
+            lHashes[nFloat][nBlock] = bench_Hash(lBuffer, (gsize)nFrames * nFrameSize);
+        }
+    }
+
+    g_free(lBuffer);
+
+    BenchStress lStress[BENCH_STRESS_THREADS];
+    GThread *lThreads[BENCH_STRESS_THREADS];
+    guint nMismatches = 0;
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+
+    for (guint nThread = 0; nThread < BENCH_STRESS_THREADS && !bError; nThread++)
+    {
+        lStress[nThread].pChunk = pChunkHandle;
+        lStress[nThread].lHashes[0] = lHashes[0];
+        lStress[nThread].lHashes[1] = lHashes[1];
+        lStress[nThread].nBlocks = nBlocks;
+        lStress[nThread].nThread = nThread;
+        lStress[nThread].lLatencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+        lStress[nThread].nMismatches = 0;
+        lThreads[nThread] = g_thread_new("bench_Stress", bench_OnStress, &lStress[nThread]);
+    }
+
+    for (guint nThread = 0; nThread < BENCH_STRESS_THREADS && !bError; nThread++)
+    {
+        g_thread_join(lThreads[nThread]);
+        g_array_append_vals(pBench->lLatencies, lStress[nThread].lLatencies->data, lStress[nThread].lLatencies->len);
+        g_array_free(lStress[nThread].lLatencies, TRUE);
+        nMismatches += lStress[nThread].nMismatches;
+    }
+
+    if (!bError)
+    {
+        bench_Report(pBench, "datasource_concurrent", 0, (gint64)pBench->lLatencies->len * BENCH_STRESS_FRAMES, bench_Now() - nTimeStart);
+    }
+
+    if (nMismatches)
+    {
+        g_printerr("datasource_concurrent: %u of %u reads returned wrong data\n", nMismatches, BENCH_STRESS_THREADS * BENCH_STRESS_READS);
+        bError = TRUE;
+    }
+
+    g_free(lHashes[0]);
+    g_free(lHashes[1]);
+    chunk_Close(pChunkHandle, FALSE);
+
+    return bError;
+}
+
+static void bench_ViewCache(Bench *pBench, Chunk *pChunk, guint nZoom)
+{
+    gint64 nFrames = MAX(pChunk->nFrames / nZoom, 1);
+    gint64 nStartFrame = (pChunk->nFrames - nFrames) / 2;
+    ViewCache *pViewCache = viewcache_New();
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+
+    while (viewcache_Update(pViewCache, pChunk, nStartFrame, nStartFrame + nFrames, BENCH_WIDTH, NULL, NULL))
+    {
+        bench_Lap(pBench);
+    }
+
+    bench_Report(pBench, "viewcache_update", nZoom, nFrames, bench_Now() - nTimeStart);
+    viewcache_Free(pViewCache);
+}
+
+static void bench_Convert(Bench *pBench, Chunk *pChunk)
+{
+    GstAudioInfo *pAudioInfo = pChunk->pAudioInfo;
+    guint nFrames = BUFFER_SIZE / (pAudioInfo->channels * 4);
+    gchar *lFloat = g_malloc0(nFrames * pAudioInfo->channels * 4);
+    gchar *lBytes = g_malloc0(nFrames * pAudioInfo->bpf);
+
+    for (gint nDirection = 0; nDirection < 2; nDirection++)
+    {
+        gint64 nTimeStart = bench_Now();
+        bench_Begin(pBench);
+
+        for (guint nBlock = 0; nBlock < BENCH_CONVERT_BLOCKS; nBlock++)
+        {
+            gstconverter_ConvertBuffer(lFloat, lBytes, nFrames, pAudioInfo, nDirection == 1);
+            bench_Lap(pBench);
+        }
+
+        bench_Report(pBench, nDirection == 1 ? "convert_from_float" : "convert_to_float", 0, (gint64)nFrames * BENCH_CONVERT_BLOCKS, bench_Now() - nTimeStart);
+    }
+
+    g_free(lFloat);
+    g_free(lBytes);
+}
+
+static void bench_Process(Bench *pBench, Chunk *pChunk)
+{
+    Progress cProgress = {NULL, bench_OnProgress, NULL, pBench};
+
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+    Chunk *pChunkOut = chunk_Fade(pChunk, 1.0, 0.0, &cProgress);
+    bench_Report(pBench, "chunk_fade", 0, pChunk->nFrames, bench_Now() - nTimeStart);
+
+    if (pChunkOut)
+    {
+        g_object_unref(pChunkOut);
+    }
+
+    nTimeStart = bench_Now();
+    bench_Begin(pBench);
+    pChunkOut = chunk_Mix(pChunk, pChunk, &cProgress);
+    bench_Report(pBench, "chunk_mix", 0, pChunk->nFrames, bench_Now() - nTimeStart);
+
+    if (pChunkOut)
+    {
+        g_object_unref(pChunkOut);
+    }
+
+    gchar *sFilePath = scratch_GetFileName(pChunk->nBytes);
+    nTimeStart = bench_Now();
+    bench_Begin(pBench);
+    chunk_Save(pChunk, sFilePath, &cProgress);
+    bench_Report(pBench, "chunk_save", 0, pChunk->nFrames, bench_Now() - nTimeStart);
+    scratch_Unref(sFilePath);
+    g_free(sFilePath);
+}
+
+static gboolean bench_DecodeFlac(gchar *sFilePath, GstAudioInfo *pAudioInfo, GByteArray *lDecoded, guint8 *lMd5)
+{
+    FILE *pFile = fopen(sFilePath, "rb");
+    guint8 lHeader[42];
+
+    if (pFile == NULL)
+    {
+        return TRUE;
+    }
+
+    gboolean bError = fread(lHeader, 1, sizeof(lHeader), pFile) != sizeof(lHeader) || memcmp(lHeader, "fLaC", 4) != 0;
+    fclose(pFile);
+
+    if (bError)
+    {
+        return TRUE;
+    }
+
+    // The digest sits at the end of STREAMINFO, after the 4-byte marker and the 4-byte block header
+    memcpy(lMd5, lHeader + 26, 16);
+    gchar *sCommand = g_strdup_printf("filesrc name=src ! flacparse ! flacdec ! audioconvert ! audio/x-raw, format=%s, layout=interleaved ! appsink name=sink sync=false", pAudioInfo->finfo->name);
+    GError *pError = NULL;
+    GstElement *pPipeline = gst_parse_launch(sCommand, &pError);
+    g_free(sCommand);
+
+    if (pError != NULL || pPipeline == NULL)
+    {
+        g_printerr("flac_roundtrip: %s\n", pError ? pError->message : "could not create the decoder");
+        g_clear_error(&pError);
+        g_clear_object(&pPipeline);
+
+        return TRUE;
+    }
+
+    GstElement *pSource = gst_bin_get_by_name(GST_BIN_CAST(pPipeline), "src");
+    GstElement *pSink = gst_bin_get_by_name(GST_BIN_CAST(pPipeline), "sink");
+    g_object_set(pSource, "location", sFilePath, NULL);
+    gst_element_set_state(pPipeline, GST_STATE_PLAYING);
+    GstSample *pSample;
+
+    while ((pSample = gst_app_sink_pull_sample(GST_APP_SINK_CAST(pSink))) != NULL)
+    {
+        GstMapInfo cMapInfo;
+        GstBuffer *pBuffer = gst_sample_get_buffer(pSample);
+
+        if (gst_buffer_map(pBuffer, &cMapInfo, GST_MAP_READ))
+        {
+            g_byte_array_append(lDecoded, cMapInfo.data, cMapInfo.size);
+            gst_buffer_unmap(pBuffer, &cMapInfo);
+        }
+
+        gst_sample_unref(pSample);
+    }
+
+    GstBus *pBus = gst_pipeline_get_bus(GST_PIPELINE_CAST(pPipeline));
+    GstMessage *pMessage = gst_bus_pop_filtered(pBus, GST_MESSAGE_ERROR);
+
+    if (pMessage != NULL)
+    {
+        gst_message_parse_error(pMessage, &pError, NULL);
+        g_printerr("flac_roundtrip: %s\n", pError->message);
+        g_clear_error(&pError);
+        gst_message_unref(pMessage);
+        bError = TRUE;
+    }
+
+    gst_object_unref(pBus);
+    gst_element_set_state(pPipeline, GST_STATE_NULL);
+    gst_object_unref(pSink);
+    gst_object_unref(pSource);
+    gst_object_unref(pPipeline);
+
+    return bError;
+}
+
+static gboolean bench_Flac(Bench *pBench, Chunk *pChunk)
+{
+    // Encode with the native encoder, decode with flacdec, and expect every sample and the STREAMINFO digest back
+    Progress cProgress = {NULL, bench_OnProgress, NULL, pBench};
+    gchar *sFilePath = scratch_GetFileName(pChunk->nBytes);
+    gboolean bFatal = FALSE;
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+    gboolean bError = export_Flac(pChunk, 0, pChunk->nFrames, sFilePath, &cProgress, &bFatal);
+    GByteArray *lDecoded = g_byte_array_new();
+    guint8 lMd5[16];
+
+    if (!bError)
+    {
+        bench_Report(pBench, "flac_encode", 0, pChunk->nFrames, bench_Now() - nTimeStart);
+        bError = bench_DecodeFlac(sFilePath, pChunk->pAudioInfo, lDecoded, lMd5);
+    }
+
+    if (!bError)
+    {
+        gchar *lBytes = g_malloc(pChunk->nBytes);
+        ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
+        gint64 nFrames = 0;
+
+        while (pChunkHandle != NULL && nFrames < pChunk->nFrames)
+        {
+            guint nRead = chunk_Read(pChunkHandle, nFrames, MIN(BUFFER_SIZE / pChunk->pAudioInfo->bpf, pChunk->nFrames - nFrames), lBytes + nFrames * pChunk->pAudioInfo->bpf, FALSE, FALSE);
+
+            if (nRead == 0)
+            {
+                break;
+            }
+
+            nFrames += nRead;
+        }
+
+        if (pChunkHandle != NULL)
+        {
+            chunk_Close(pChunkHandle, FALSE);
+        }
+
+        gsize nDigest = 16;
+        guint8 lDigest[16];
+        GChecksum *pChecksum = g_checksum_new(G_CHECKSUM_MD5);
+        g_checksum_update(pChecksum, lDecoded->data, lDecoded->len);
+        g_checksum_get_digest(pChecksum, lDigest, &nDigest);
+        g_checksum_free(pChecksum);
+
+        if (nFrames != pChunk->nFrames || lDecoded->len != pChunk->nBytes || memcmp(lDecoded->data, lBytes, pChunk->nBytes) != 0)
+        {
+            g_printerr("flac_roundtrip: %u channels, %u bits: decoded samples differ from the source\n", pChunk->pAudioInfo->channels, GST_AUDIO_INFO_DEPTH(pChunk->pAudioInfo));
+            bError = TRUE;
+        }
+        else if (memcmp(lDigest, lMd5, 16) != 0)
+        {
+            g_printerr("flac_roundtrip: %u channels, %u bits: STREAMINFO MD5 does not match the decoded samples\n", pChunk->pAudioInfo->channels, GST_AUDIO_INFO_DEPTH(pChunk->pAudioInfo));
+            bError = TRUE;
+        }
+
+        g_free(lBytes);
+    }
+
+    g_byte_array_free(lDecoded, TRUE);
+    scratch_Unref(sFilePath);
+    g_free(sFilePath);
+
+    return bError;
+}
+
+static gboolean bench_RunSource(Bench *pBench, BenchSource *pSource, guint *lParts)
+{
+    pBench->pSource = pSource;
+    pBench->nParts = 1;
+    gchar *sFilePath = scratch_GetFileName((gint64)pSource->nSeconds * BENCH_RATE * pSource->nChannels * (pSource->nBits / 8));
+
+    if (bench_Generate(pSource, sFilePath))
+    {
+        g_printerr("Failed to generate %s\n", sFilePath);
+        g_free(sFilePath);
+
+        return TRUE;
+    }
+
+    gint64 nTimeStart = bench_Now();
+    bench_Begin(pBench);
+    Chunk *pChunk = chunk_Load(sFilePath, NULL);
+    bench_Lap(pBench);
+    scratch_Unref(sFilePath);
+    g_free(sFilePath);
+
+    if (pChunk == NULL)
+    {
+        return TRUE;
+    }
+
+    bench_Report(pBench, "chunk_load", 0, pChunk->nFrames, bench_Now() - nTimeStart);
+
+    if (pBench->bFlacOnly)
+    {
+        gboolean bFailed = bench_Flac(pBench, pChunk);
+        g_object_unref(pChunk);
+
+        return bFailed;
+    }
+
+    gboolean bFailed = FALSE;
+
+    for (guint nPart = 0; lParts[nPart] != 0; nPart++)
+    {
+        if (lParts[nPart] > pChunk->nFrames)
+        {
+            continue;
+        }
+
+        pBench->nParts = lParts[nPart];
+        Chunk *pChunkFragmented = bench_Fragment(pChunk, 0, pChunk->nFrames, pBench->nParts);
+
+        // Every timed section starts from a cold block cache, the stress run comes last since it fills it
+        if (!pBench->bStressOnly)
+        {
+            bench_ForgetCache(pChunkFragmented);
+            bench_Read(pBench, pChunkFragmented, FALSE);
+            bench_ForgetCache(pChunkFragmented);
+            bench_Read(pBench, pChunkFragmented, TRUE);
+
+            for (guint nZoom = 0; m_lZooms[nZoom] != 0; nZoom++)
+            {
+                bench_ForgetCache(pChunkFragmented);
+                bench_ViewCache(pBench, pChunkFragmented, m_lZooms[nZoom]);
+            }
+        }
+
+        if (bench_Stress(pBench, pChunkFragmented))
+        {
+            bFailed = TRUE;
+        }
+
+        g_object_unref(pChunkFragmented);
+    }
+
+    pBench->nParts = 1;
+
+    if (pBench->bStressOnly)
+    {
+        g_object_unref(pChunk);
+
+        return bFailed;
+    }
+
+    bench_ForgetCache(pChunk);
+    bench_Convert(pBench, pChunk);
+    bench_ForgetCache(pChunk);
+    bench_Process(pBench, pChunk);
+    g_object_unref(pChunk);
+
+    return bFailed;
+}
+
+gint bench_Run(gchar *sSuite, gchar *sOutputPath)
+{
+    BenchSource *lSources;
+    guint *lParts;
+    gboolean bStressOnly = FALSE;
+    gboolean bFlacOnly = FALSE;
+
+    // The stress suite only checks concurrent reads against a single reader, so it can run as a test
+    if (g_str_equal(sSuite, "stress"))
+    {
+        lSources = m_lSourcesQuick;
+        lParts = m_lPartsQuick;
+        bStressOnly = TRUE;
+    }
+    else if (g_str_equal(sSuite, "flac"))
+    {
+        lSources = m_lSourcesFlac;
+        lParts = m_lPartsQuick;
+        bFlacOnly = TRUE;
+    }
+    else if (g_str_equal(sSuite, "quick"))
+    {
+        lSources = m_lSourcesQuick;
+        lParts = m_lPartsQuick;
+    }
+    else if (g_str_equal(sSuite, "full"))
+    {
+        lSources = m_lSourcesFull;
+        lParts = m_lPartsFull;
+    }
+    else
+    {
+        g_printerr("Unknown benchmark suite '%s', use 'quick', 'full', 'stress' or 'flac'\n", sSuite);
+
+        return EXIT_FAILURE;
+    }
+
+    Bench cBench;
+    cBench.sSuite = sSuite;
+    cBench.pOutput = stdout;
+    cBench.lLatencies = g_array_new(FALSE, FALSE, sizeof(gint64));
+    cBench.bStressOnly = bStressOnly;
+    cBench.bFlacOnly = bFlacOnly;
+
+    if (sOutputPath)
+    {
+        cBench.pOutput = fopen(sOutputPath, "w");
+
+        if (cBench.pOutput == NULL)
+        {
+            g_printerr("Could not open %s: %s\n", sOutputPath, strerror(errno));
+            g_array_free(cBench.lLatencies, TRUE);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    gint nFailed = 0;
+
+    for (guint nSource = 0; lSources[nSource].nChannels != 0; nSource++)
+    {
+        if (bench_RunSource(&cBench, &lSources[nSource], lParts))
+        {
+            nFailed++;
+        }
+    }
+
+    if (sOutputPath)
+    {
+        fclose(cBench.pOutput);
+    }
+
+    g_array_free(cBench.lLatencies, TRUE);
+
+    return nFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <gio/gio.h>
+#include <string.h>
+#include "blockcache.h"
+#include "counters.h"
+#include "main.h"
+
+typedef struct
+{
+    DataSource *pDataSource;
+    gint64 nBlock;
+    gchar *lData;
+    guint nFrames;
+    gsize nBytes;
+    GList *lLink;
+
+} BlockCacheEntry;
+
+static GHashTable *m_lEntries = NULL;
+static GQueue m_qEntries = G_QUEUE_INIT;
+static gsize m_nBytes = 0;
+static gsize m_nBudget = 256 * 1024 * 1024;
+G_LOCK_DEFINE_STATIC(BLOCKCACHE);
+
+static guint blockcache_Hash(gconstpointer pKey)
+{
+    const BlockCacheEntry *pEntry = pKey;
+
+    return g_direct_hash(pEntry->pDataSource) ^ (guint)(pEntry->nBlock * 2654435761u);
+}
+
+static gboolean blockcache_Equal(gconstpointer pKey1, gconstpointer pKey2)
+{
+    const BlockCacheEntry *pEntry1 = pKey1;
+    const BlockCacheEntry *pEntry2 = pKey2;
+
+    return pEntry1->pDataSource == pEntry2->pDataSource && pEntry1->nBlock == pEntry2->nBlock;
+}
+
+static void blockcache_Remove(BlockCacheEntry *pEntry)
+{
+    g_hash_table_remove(m_lEntries, pEntry);
+    g_queue_delete_link(&m_qEntries, pEntry->lLink);
+    m_nBytes -= pEntry->nBytes;
+    counters_Add(COUNTER_BLOCKCACHE_BYTES, -(gssize)pEntry->nBytes);
+    g_free(pEntry->lData);
+    g_free(pEntry);
+}
+
+void blockcache_Init()
+{
+    m_lEntries = g_hash_table_new(blockcache_Hash, blockcache_Equal);
+
+    GSettings *pSettings = getSettings("block-cache-size");
+
+    if (pSettings != NULL)
+    {
+        m_nBudget = (gsize)g_settings_get_uint(pSettings, "block-cache-size") * 1024 * 1024;
+        g_object_unref(pSettings);
+    }
+}
+
+void blockcache_Free()
+{
+    G_LOCK(BLOCKCACHE);
+
+    while (m_qEntries.head != NULL)
+    {
+        blockcache_Remove(m_qEntries.head->data);
+    }
+
+    g_hash_table_destroy(m_lEntries);
+    m_lEntries = NULL;
+
+    G_UNLOCK(BLOCKCACHE);
+}
+
+gboolean blockcache_Enabled()
+{
+    return m_lEntries != NULL && m_nBudget > 0;
+}
+
+gboolean blockcache_Read(DataSource *pDataSource, gint64 nBlock, guint nOffset, guint nFrames, gchar *lBuffer)
+{
+    BlockCacheEntry cKey = {pDataSource, nBlock};
+
+    G_LOCK(BLOCKCACHE);
+
+    BlockCacheEntry *pEntry = m_lEntries ? g_hash_table_lookup(m_lEntries, &cKey) : NULL;
+
+    if (pEntry == NULL || nOffset + nFrames > pEntry->nFrames)
+    {
+        G_UNLOCK(BLOCKCACHE);
+        counters_Add(COUNTER_BLOCKCACHE_MISSES, 1);
+
+        return FALSE;
+    }
+
+    guint nFrameSize = pDataSource->pAudioInfo->channels * 4;
+    memcpy(lBuffer, pEntry->lData + nOffset * nFrameSize, nFrames * nFrameSize);
+    g_queue_unlink(&m_qEntries, pEntry->lLink);
+    g_queue_push_head_link(&m_qEntries, pEntry->lLink);
+
+    G_UNLOCK(BLOCKCACHE);
+    counters_Add(COUNTER_BLOCKCACHE_HITS, 1);
+
+    return TRUE;
+}
+
+void blockcache_Insert(DataSource *pDataSource, gint64 nBlock, gchar *lBuffer, guint nFrames)
+{
+    gsize nBytes = (gsize)nFrames * pDataSource->pAudioInfo->channels * 4;
+
+    if (!blockcache_Enabled() || nBytes > m_nBudget)
+    {
+        return;
+    }
+
+    BlockCacheEntry cKey = {pDataSource, nBlock};
+
+    G_LOCK(BLOCKCACHE);
+
+    BlockCacheEntry *pEntry = g_hash_table_lookup(m_lEntries, &cKey);
+
+    if (pEntry != NULL)
+    {
+        blockcache_Remove(pEntry);
+    }
+
+    while (m_nBytes + nBytes > m_nBudget && m_qEntries.tail != NULL)
+    {
+        blockcache_Remove(m_qEntries.tail->data);
+    }
+
+    pEntry = g_malloc(sizeof(BlockCacheEntry));
+    pEntry->pDataSource = pDataSource;
+    pEntry->nBlock = nBlock;
+    pEntry->lData = g_malloc(nBytes);
+    memcpy(pEntry->lData, lBuffer, nBytes);
+    pEntry->nFrames = nFrames;
+    pEntry->nBytes = nBytes;
+    g_queue_push_head(&m_qEntries, pEntry);
+    pEntry->lLink = m_qEntries.head;
+    g_hash_table_add(m_lEntries, pEntry);
+    m_nBytes += nBytes;
+    counters_Add(COUNTER_BLOCKCACHE_BYTES, nBytes);
+
+    G_UNLOCK(BLOCKCACHE);
+}
+
+void blockcache_Forget(DataSource *pDataSource)
+{
+    G_LOCK(BLOCKCACHE);
+
+    GList *l = m_qEntries.head;
+
+    while (l != NULL)
+    {
+        GList *lNext = l->next;
+        BlockCacheEntry *pEntry = l->data;
+
+        if (pEntry->pDataSource == pDataSource)
+        {
+            blockcache_Remove(pEntry);
+        }
+
+        l = lNext;
+    }
+
+    G_UNLOCK(BLOCKCACHE);
+}
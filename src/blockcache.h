@@ -0,0 +1,35 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef BLOCKCACHE_H_INCLUDED
+#define BLOCKCACHE_H_INCLUDED
+
+#include "datasource.h"
+
+#define BLOCKCACHE_FRAMES 32768
+
+void blockcache_Init();
+void blockcache_Free();
+gboolean blockcache_Enabled();
+gboolean blockcache_Read(DataSource *pDataSource, gint64 nBlock, guint nOffset, guint nFrames, gchar *lBuffer);
+void blockcache_Insert(DataSource *pDataSource, gint64 nBlock, gchar *lBuffer, guint nFrames);
+void blockcache_Forget(DataSource *pDataSource);
+
+#endif
@@ -21,28 +21,38 @@
 
 #include <libodiosacd/libodiosacd.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include "message.h"
 #include "chunk.h"
 #include "tempfile.h"
 #include "main.h"
-#include "mainwindow.h"
+#include "trace.h"
+#include "scratch.h"
+#include "export.h"
+#include "dsp.h"
 
 G_DEFINE_TYPE(Chunk, chunk, G_TYPE_OBJECT)
 
 typedef struct
 {
-    struct _MainWindow *pMainWindow;
+    Progress *pProgress;
     gchar *sFilePath;
+    gchar *sDirectory;
     gfloat fProgress;
     gboolean bCancel;
 
 } ConvertParams;
 
 static GList *m_lChunks = NULL;
+G_LOCK_DEFINE_STATIC(CHUNKS);
 
 guint chunk_AliveCount()
 {
-    return g_list_length(m_lChunks);
+    G_LOCK(CHUNKS);
+    guint nCount = g_list_length(m_lChunks);
+    G_UNLOCK(CHUNKS);
+
+    return nCount;
 }
 
 static void chunk_OnDispose(GObject *pObject)
@@ -50,7 +60,7 @@ static void chunk_OnDispose(GObject *pObject)
     g_info("chunk_OnDispose %p", pObject);
     Chunk *pChunk = OE_CHUNK(pObject);
 
-    g_assert(pChunk->nOpenCount == 0);
+    g_assert(g_atomic_int_get(&pChunk->nOpenCount) == 0);
 
     if (pChunk->lParts)
     {
@@ -68,7 +78,9 @@ static void chunk_OnDispose(GObject *pObject)
     gst_audio_info_free(pChunk->pAudioInfo);
     pChunk->lParts = NULL;
     G_OBJECT_CLASS(chunk_parent_class)->dispose(pObject);
+    G_LOCK(CHUNKS);
     m_lChunks = g_list_remove(m_lChunks, pChunk);
+    G_UNLOCK(CHUNKS);
 }
 
 static void chunk_class_init(ChunkClass *cls)
@@ -82,7 +94,9 @@ static void chunk_init(Chunk *pObject)
     pObject->nFrames = 0;
     pObject->nBytes = 0;
     pObject->lParts = NULL;
+    G_LOCK(CHUNKS);
     m_lChunks = g_list_append(m_lChunks, pObject);
+    G_UNLOCK(CHUNKS);
 }
 
 static Chunk *chunk_new()
@@ -106,96 +120,141 @@ static void chunk_CalcLength(Chunk *pChunk)
     pChunk->nBytes = nFrames * pChunk->pAudioInfo->bpf;
 }
 
-Chunk *chunk_Mix(Chunk *pChunk1, Chunk *pChunk2, struct _MainWindow *pMainWindow)
+static void chunk_CloseInputs(ChunkHandle **lHandles, guint nInputs)
 {
-    guint nFramesRead = 0;
-    guint nTotalFramesRead = 0;
-    gint64 nMixLen = MIN(pChunk1->nFrames, pChunk2->nFrames);
-    ChunkHandle *pChunkHandle1 = chunk_Open(pChunk1, FALSE);
-
-    if (pChunkHandle1 == NULL)
+    for (guint nInput = 0; nInput < nInputs; nInput++)
     {
-        return NULL;
+        if (lHandles[nInput])
+        {
+            chunk_Close(lHandles[nInput], FALSE);
+        }
     }
 
-    ChunkHandle *pChunkHandle2 = chunk_Open(pChunk2, FALSE);
+    g_free(lHandles);
+}
 
-    if (pChunkHandle2 == NULL)
-    {
-        chunk_Close(pChunkHandle1, FALSE);
-        return NULL;
-    }
+// All inputs share one format; each one is summed into the block where it overlaps, so N inputs cost one pass and one write
 
-    TempFile *pTempFile = tempfile_Init(pChunk1->pAudioInfo);
-    mainwindow_BeginProgress(pMainWindow, _("Mixing"));
-    gchar lBuffer1[BUFFER_SIZE];
-    gchar lBuffer2[BUFFER_SIZE];
-    gchar lBufferMixed[BUFFER_SIZE];
+Chunk *chunk_MixInputs(MixInput *lInputs, guint nInputs, gboolean bSoftLimit, Progress *pProgress)
+{
+    GstAudioInfo *pAudioInfo = lInputs[0].pChunk->pAudioInfo;
+    ChunkHandle **lHandles = g_malloc0(sizeof(ChunkHandle*) * nInputs);
+    gint64 nMixLen = 0;
 
-    for (guint nStartFrame = 0; nStartFrame < nMixLen; nStartFrame += nFramesRead)
+    for (guint nInput = 0; nInput < nInputs; nInput++)
     {
-        guint nFramesRead1 = chunk_Read(pChunkHandle1, nStartFrame, BUFFER_SIZE / (pChunk1->pAudioInfo->channels * 4), (gchar*)lBuffer1, TRUE, FALSE);
-        guint nFramesRead2 = chunk_Read(pChunkHandle2, nStartFrame, BUFFER_SIZE / (pChunk1->pAudioInfo->channels * 4), (gchar*)lBuffer2, TRUE, FALSE);
+        // Inputs can only start at or after the beginning of the mix
+        if (lInputs[nInput].nOffset < 0)
+        {
+            g_warning("chunk_MixInputs: negative offset %" G_GINT64_FORMAT " for input %u", lInputs[nInput].nOffset, nInput);
+            chunk_CloseInputs(lHandles, nInputs);
+
+            return NULL;
+        }
 
-        if (nFramesRead1 == 0 || nFramesRead2 == 0)
+        lHandles[nInput] = chunk_Open(lInputs[nInput].pChunk, FALSE);
+
+        if (lHandles[nInput] == NULL)
         {
-            tempfile_Abort(pTempFile);
-            chunk_Close(pChunkHandle1, FALSE);
-            chunk_Close(pChunkHandle2, FALSE);
-            mainwindow_EndProgress(pMainWindow);
+            chunk_CloseInputs(lHandles, nInputs);
 
             return NULL;
         }
 
-        nFramesRead = MIN(nFramesRead1, nFramesRead2);
-        nTotalFramesRead += nFramesRead;
+        nMixLen = MAX(nMixLen, lInputs[nInput].nOffset + lInputs[nInput].pChunk->nFrames);
+    }
+
+    TempFile *pTempFile = tempfile_InitIntermediate(pAudioInfo, nMixLen);
+
+    if (pTempFile == NULL)
+    {
+        chunk_CloseInputs(lHandles, nInputs);
+
+        return NULL;
+    }
+
+    progress_Begin(pProgress, _("Mixing"));
+    guint nBlockFrames = BUFFER_SIZE / (pAudioInfo->channels * 4);
+    gfloat *lMixed = g_malloc(BUFFER_SIZE);
+    gfloat *lInput = g_malloc(BUFFER_SIZE);
+    gchar *lBytes = g_malloc(nBlockFrames * pAudioInfo->bpf);
+    gboolean bError = FALSE;
+
+    for (gint64 nStartFrame = 0; nStartFrame < nMixLen && !bError;)
+    {
+        guint nFrames = MIN(nBlockFrames, nMixLen - nStartFrame);
+        memset(lMixed, 0, nFrames * pAudioInfo->channels * 4);
 
-        for (guint nSample = 0; nSample < nFramesRead * pChunk1->pAudioInfo->channels; nSample++)
+        for (guint nInput = 0; nInput < nInputs && !bError; nInput++)
         {
-            gfloat fSample = ((gfloat *)lBuffer1)[nSample] + ((gfloat *)lBuffer2)[nSample];
+            gint64 nFirst = MAX(nStartFrame, lInputs[nInput].nOffset);
+            gint64 nLast = MIN(nStartFrame + nFrames, lInputs[nInput].nOffset + lInputs[nInput].pChunk->nFrames);
 
-            if (fSample > 1.0)
+            for (gint64 nFrame = nFirst; nFrame < nLast && !bError;)
             {
-                fSample = 1.0;
+                guint nFramesRead = chunk_Read(lHandles[nInput], nFrame - lInputs[nInput].nOffset, nLast - nFrame, (gchar*)lInput, TRUE, FALSE);
+                bError = (nFramesRead == 0);
+                dsp_Accumulate(lMixed + (nFrame - nStartFrame) * pAudioInfo->channels, lInput, lInputs[nInput].fGain, nFramesRead * pAudioInfo->channels);
+                nFrame += nFramesRead;
             }
-            else if (fSample < -1.0)
-            {
-                fSample = -1.0;
-            }
-
-            ((gfloat *)lBufferMixed)[nSample] = fSample;
         }
 
-        gboolean bError = FALSE;
+        if (bError)
+        {
+            break;
+        }
 
-        if (pChunk1->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
+        if (bSoftLimit)
         {
-            gchar *lBytes = g_malloc(nFramesRead * pChunk1->pAudioInfo->bpf);
-            gstconverter_ConvertBuffer(lBufferMixed, lBytes, nFramesRead, pChunk1->pAudioInfo, TRUE);
-            bError = tempfile_Write(pTempFile, lBytes, nFramesRead * pChunk1->pAudioInfo->bpf);
-            g_free(lBytes);
-            lBytes = NULL;
+            dsp_SoftLimit(lMixed, nFrames * pAudioInfo->channels);
         }
         else
         {
-            bError = tempfile_Write(pTempFile, lBufferMixed, nFramesRead * pChunk1->pAudioInfo->bpf);
+            dsp_Clip(lMixed, nFrames * pAudioInfo->channels);
         }
 
-        if (bError || mainwindow_Progress(pMainWindow, GFLOAT(nTotalFramesRead) / GFLOAT(nMixLen)))
+        if (!pTempFile->bFloat && pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
         {
-            tempfile_Abort(pTempFile);
-            chunk_Close(pChunkHandle1, FALSE);
-            chunk_Close(pChunkHandle2, FALSE);
-            mainwindow_EndProgress(pMainWindow);
-
-            return NULL;
+            gstconverter_ConvertBuffer((gchar*)lMixed, lBytes, nFrames, pAudioInfo, TRUE);
+            bError = tempfile_Write(pTempFile, lBytes, nFrames * pAudioInfo->bpf);
+        }
+        else
+        {
+            bError = tempfile_Write(pTempFile, (gchar*)lMixed, nFrames * pAudioInfo->channels * 4);
         }
+
+        nStartFrame += nFrames;
+        bError = bError || progress_Update(pProgress, GFLOAT(nStartFrame) / GFLOAT(nMixLen));
+    }
+
+    g_free(lBytes);
+    g_free(lInput);
+    g_free(lMixed);
+    chunk_CloseInputs(lHandles, nInputs);
+
+    if (bError)
+    {
+        tempfile_Abort(pTempFile);
+        progress_End(pProgress);
+
+        return NULL;
     }
 
-    chunk_Close(pChunkHandle1, FALSE);
-    chunk_Close(pChunkHandle2, FALSE);
     Chunk *pChunkMixed = tempfile_Finished(pTempFile);
-    mainwindow_EndProgress(pMainWindow);
+    progress_End(pProgress);
+
+    return pChunkMixed;
+}
+
+// Only the overlap is rendered, the longer chunk's tail is appended as it is
+
+Chunk *chunk_Mix(Chunk *pChunk1, Chunk *pChunk2, Progress *pProgress)
+{
+    gint64 nMixLen = MIN(pChunk1->nFrames, pChunk2->nFrames);
+    MixInput lInputs[2] = {{chunk_GetPart(pChunk1, 0, nMixLen), 0, 1.0}, {chunk_GetPart(pChunk2, 0, nMixLen), 0, 1.0}};
+    Chunk *pChunkMixed = chunk_MixInputs(lInputs, 2, FALSE, pProgress);
+    g_object_unref(lInputs[0].pChunk);
+    g_object_unref(lInputs[1].pChunk);
 
     if (!pChunkMixed)
     {
@@ -264,14 +323,14 @@ ChunkHandle *chunk_Open(Chunk *pChunk, gboolean bPlayer)
         }
     }
 
-    pChunk->nOpenCount++;
+    g_atomic_int_inc(&pChunk->nOpenCount);
 
     return pChunk;
 }
 
 void chunk_Close(ChunkHandle *pChunkHandle, gboolean bPlayer)
 {
-    g_assert(pChunkHandle->nOpenCount > 0);
+    g_assert(g_atomic_int_get(&pChunkHandle->nOpenCount) > 0);
 
     for (GList *l = pChunkHandle->lParts; l != NULL; l = l->next)
     {
@@ -279,10 +338,10 @@ void chunk_Close(ChunkHandle *pChunkHandle, gboolean bPlayer)
         datasource_Close(pDataPart->pDataSource, bPlayer);
     }
 
-    pChunkHandle->nOpenCount--;
+    g_atomic_int_dec_and_test(&pChunkHandle->nOpenCount);
 }
 
-gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, struct _MainWindow *pMainWindow)
+gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, Progress *pProgress)
 {
     if (g_file_test(sFilePath, G_FILE_TEST_EXISTS))
     {
@@ -292,15 +351,23 @@ gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, struct _MainWindow *pMainWi
         }
     }
 
-    mainwindow_BeginProgress(pMainWindow, _("Saving"));
+    progress_Begin(pProgress, _("Saving"));
     gboolean bFatal = FALSE;
     gboolean bError = FALSE;
 
-    GstWriter *pGstWriter = gstwriter_New(sFilePath, pChunk->pAudioInfo);
+    if (export_IsNativeFlac(sFilePath, pChunk->pAudioInfo))
+    {
+        bError = export_Flac(pChunk, 0, pChunk->nFrames, sFilePath, pProgress, &bFatal);
+
+        goto END;
+    }
+
+    const gchar *sEncoder = export_GetEncoder(sFilePath);
+    GstWriter *pGstWriter = gstwriter_New(sFilePath, pChunk->pAudioInfo, sEncoder ? sEncoder : "wavenc");
 
     if (!pGstWriter)
     {
-        gchar *sMessage = g_strdup_printf(_("Failed to open '%s'!"), sFilePath);
+        gchar *sMessage = g_strdup_printf(_("The encoder '%s' for '%s' is not installed!"), sEncoder ? sEncoder : "wavenc", sFilePath);
         message_Error(sMessage);
         g_free(sMessage);
         bError = -1;
@@ -323,9 +390,9 @@ gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, struct _MainWindow *pMainWi
 
     gchar pBuffer[BUFFER_SIZE];
     guint nFramesRead;
-    guint nTotalFramesWritten = 0;
+    gint64 nTotalFramesWritten = 0;
 
-    for (guint nStartFrame = 0; nStartFrame < pChunk->nFrames; nStartFrame += nFramesRead)
+    for (gint64 nStartFrame = 0; nStartFrame < pChunk->nFrames; nStartFrame += nFramesRead)
     {
         nFramesRead = chunk_Read(pChunkHandle, nStartFrame, BUFFER_SIZE / pChunk->pAudioInfo->bpf, pBuffer, FALSE, FALSE);
 
@@ -359,7 +426,7 @@ gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, struct _MainWindow *pMainWi
             goto END;
         }
 
-        if (mainwindow_Progress(pMainWindow, GFLOAT(nTotalFramesWritten) / GFLOAT(pChunk->nFrames)))
+        if (progress_Update(pProgress, GFLOAT(nTotalFramesWritten) / GFLOAT(pChunk->nFrames)))
         {
             chunk_Close(pChunkHandle, FALSE);
             gstwriter_Free(pGstWriter);
@@ -380,14 +447,14 @@ gboolean chunk_Save(Chunk *pChunk, gchar *sFilePath, struct _MainWindow *pMainWi
 
 END:
 
-    if (bError && bFatal && !mainwindow_Progress(pMainWindow, 0))
+    if (bError && bFatal && !progress_Update(pProgress, 0))
     {
         gchar *sMessage = g_strdup_printf(_("File %s may be destroyed since saving failed. Try to free some disk space and save again. If you exit now, the file's contents could be left in a bad state."), sFilePath);
         message_Warning(sMessage);
         g_free(sMessage);
     }
 
-    mainwindow_EndProgress(pMainWindow);
+    progress_End(pProgress);
 
     return bError;
 }
@@ -396,7 +463,7 @@ static gboolean chunk_OnGstConvert(gfloat fProgress, gpointer pUserData)
 {
     ConvertParams *pConvertParams = (ConvertParams*)pUserData;
 
-    return mainwindow_Progress(pConvertParams->pMainWindow, fProgress);
+    return progress_Update(pConvertParams->pProgress, fProgress);
 }
 
 static bool chunk_OnSacdConvert(gfloat fProgress, gchar *sFilePath, int nTrack, gpointer pUserData)
@@ -421,10 +488,10 @@ static gboolean chunk_SacdConvert(gpointer pUserData)
 {
     ConvertParams *pConvertParams = (ConvertParams*)pUserData;
 
-    return odiolibsacd_Convert("/tmp/odio-edit/", 88200, chunk_OnSacdConvert, pConvertParams);
+    return odiolibsacd_Convert(pConvertParams->sDirectory, 88200, chunk_OnSacdConvert, pConvertParams);
 }
 
-Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
+Chunk *chunk_Load(gchar *sFilePath, Progress *pProgress)
 {
     if (!g_file_test(sFilePath, G_FILE_TEST_EXISTS))
     {
@@ -450,7 +517,8 @@ Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
     gchar *sFilePathLower = g_utf8_strdown(sFilePath, -1);
     ConvertParams cConvertParams;
     cConvertParams.sFilePath = NULL;
-    cConvertParams.pMainWindow = pMainWindow;
+    cConvertParams.sDirectory = NULL;
+    cConvertParams.pProgress = pProgress;
     cConvertParams.fProgress = 0.0;
     cConvertParams.bCancel = FALSE;
 
@@ -463,54 +531,108 @@ Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
             gchar *sMessage = g_strdup_printf(_("Failed to open '%s'"), sFilePath);
             message_Error(sMessage);
             g_free(sMessage);
+            g_free(sFilePathLower);
 
             return NULL;
         }
 
-        mainwindow_BeginProgress(pMainWindow, _("Loading"));
+        // The decoded PCM is about the size of the DSD input
+        GStatBuf cStat;
+        gint64 nBytes = (g_stat(sFilePath, &cStat) == 0) ? cStat.st_size : 0;
+
+        if (scratch_Check(nBytes))
+        {
+            odiolibsacd_Close();
+            g_free(sFilePathLower);
+
+            return NULL;
+        }
+
+        cConvertParams.sDirectory = scratch_GetDirectory(nBytes);
+        progress_Begin(pProgress, _("Loading"));
         GThread *pThread = g_thread_new(NULL, (GThreadFunc)chunk_SacdConvert, &cConvertParams);
 
         while (cConvertParams.fProgress < 1 && !cConvertParams.bCancel)
         {
             g_usleep(40000);
-            cConvertParams.bCancel = mainwindow_Progress(pMainWindow, cConvertParams.fProgress);
+            cConvertParams.bCancel = progress_Update(pProgress, cConvertParams.fProgress);
         }
 
         bError = g_thread_join(pThread);
+        g_free(cConvertParams.sDirectory);
+        odiolibsacd_Close();
+        progress_End(pProgress);
 
         if (bError)
         {
             gchar *sMessage = g_strdup_printf(_("Failed to decode '%s'"), sFilePath);
             message_Error(sMessage);
             g_free(sMessage);
-
-            return NULL;
+            cConvertParams.bCancel = TRUE;
         }
 
-        if (!cConvertParams.bCancel)
+        if (!cConvertParams.bCancel && cConvertParams.sFilePath != NULL)
         {
-            sTempFile = cConvertParams.sFilePath;
+            sTempFile = scratch_Adopt(cConvertParams.sFilePath);
         }
+        else
+        {
+            // A cancelled or failed decode may already have written part of its file
+            if (cConvertParams.sFilePath != NULL)
+            {
+                g_unlink(cConvertParams.sFilePath);
+            }
 
-        odiolibsacd_Close();
-        mainwindow_EndProgress(pMainWindow);
+            cConvertParams.bCancel = TRUE;
+        }
+
+        g_free(cConvertParams.sFilePath);
     }
     else
     {
-        sTempFile = tempfile_GetFileName();
         GstConverter *pGstConverter = gstconverter_New(sFilePath, chunk_OnGstConvert, &cConvertParams);
-        mainwindow_BeginProgress(pMainWindow, _("Loading"));
 
-        if (gstconverter_ConvertFile(pGstConverter, sTempFile))
+        if (pGstConverter == NULL)
+        {
+            gchar *sMessage = g_strdup_printf(_("Failed to open '%s'"), sFilePath);
+            message_Error(sMessage);
+            g_free(sMessage);
+            cConvertParams.bCancel = TRUE;
+        }
+        else if (pGstConverter->bNoRoom)
         {
-            file_Unlink(sTempFile);
-            g_free(sTempFile);
+            // The converter checked before naming a temporary file, this only reports it
+            scratch_Check(pGstConverter->nFrames * pGstConverter->pGstBase->pAudioInfo->bpf);
             cConvertParams.bCancel = TRUE;
         }
+        else
+        {
+            progress_Begin(pProgress, _("Loading"));
+
+            if (!gstconverter_ConvertFile(pGstConverter))
+            {
+                GStatBuf cStat;
+                sTempFile = pGstConverter->sFileOut;
+                pGstConverter->sFileOut = NULL;
+
+                if (g_stat(sTempFile, &cStat) == 0)
+                {
+                    scratch_SetSize(sTempFile, cStat.st_size);
+                }
+            }
+            else
+            {
+                cConvertParams.bCancel = TRUE;
+            }
 
-        mainwindow_EndProgress(pMainWindow);
-        gstconverter_Free(pGstConverter);
-        pGstConverter = NULL;
+            progress_End(pProgress);
+        }
+
+        if (pGstConverter != NULL)
+        {
+            gstconverter_Free(pGstConverter);
+            pGstConverter = NULL;
+        }
     }
 
     g_free(sFilePathLower);
@@ -520,6 +642,15 @@ Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
         return NULL;
     }
 
+    Chunk *pChunk = tempfile_Open(sTempFile);
+
+    if (pChunk != NULL)
+    {
+        g_free(sTempFile);
+
+        return pChunk;
+    }
+
     nType = DATASOURCE_GSTTEMP;
     pGstReaderData = gstreader_New(sTempFile);
 
@@ -528,6 +659,8 @@ Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
         gchar *sMessage = g_strdup_printf(_("Failed to open '%s'"), sFilePath);
         message_Error(sMessage);
         g_free(sMessage);
+        scratch_Unref(sTempFile);
+        g_free(sTempFile);
 
         return NULL;
     }
@@ -537,16 +670,10 @@ Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow)
     pDataSource->pAudioInfo = gst_audio_info_copy(pGstReaderData->pGstBase->pAudioInfo);
     pDataSource->nFrames = pGstReaderData->nFrames;
     pDataSource->nBytes = pDataSource->nFrames * pDataSource->pAudioInfo->bpf;
-    pDataSource->nOpenCountData = 1;
-    pDataSource->nOpenCountPlayer = 0;
     pDataSource->pData.pGstReader.sFilePath = g_strdup(sFilePath);
     pDataSource->pData.pGstReader.sTempFilePath = sTempFile;
-    pDataSource->pData.pGstReader.pHandleData = pGstReaderData;
-    pDataSource->pData.pGstReader.nPosData = 0;
-    pDataSource->pData.pGstReader.pHandlePlayer = NULL;
-    pDataSource->pData.pGstReader.nPosPlayer = 0;
-    datasource_Close(pDataSource, FALSE);
-    Chunk *pChunk = chunk_NewFromDatasource(pDataSource);
+    gstreader_Free(pGstReaderData);
+    pChunk = chunk_NewFromDatasource(pDataSource);
 
     return pChunk;
 }
@@ -555,6 +682,7 @@ guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *
 {
     g_assert(nStartFrame < pChunk->nFrames);
 
+    gint64 nTraceStart = trace_Begin();
     guint nFramesReadTotal = 0;
 
     for (GList *l = pChunk->lParts; l != NULL; l = l->next)
@@ -563,12 +691,12 @@ guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *
 
         if (pDataPart->nFrames > nStartFrame)
         {
-            guint nOffset = pDataPart->nFrames - nStartFrame;
+            gint64 nOffset = pDataPart->nFrames - nStartFrame;
             guint nFramesToRead = nFrames;
 
             if (nOffset < nFrames)
             {
-                nFramesToRead = nOffset;
+                nFramesToRead = (guint)nOffset;
             }
 
             guint nFramesRead = datasource_Read(pDataPart->pDataSource, pDataPart->nPosition + nStartFrame, nFramesToRead, lBuffer, bFloat, bPlayer);
@@ -578,7 +706,9 @@ guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *
 
             if (nFramesRead == 0)
             {
-                return 0;
+                nFramesReadTotal = 0;
+
+                break;
             }
 
             nFramesReadTotal += nFramesRead;
@@ -596,7 +726,7 @@ guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *
 
             if (nFrames == 0 || l->next == NULL)
             {
-                return nFramesReadTotal;
+                break;
             }
         }
         else
@@ -605,6 +735,8 @@ guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *
         }
     }
 
+    trace_End("chunk_Read", nTraceStart);
+
     return nFramesReadTotal;
 }
 
@@ -825,7 +957,7 @@ Chunk *chunk_ReplacePart(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, Chun
     return pChunkOut;
 }
 
-Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct _MainWindow *pMainWindow)
+static Chunk *chunk_Ramp(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, gchar *sDescription, Progress *pProgress)
 {
     ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
 
@@ -834,11 +966,18 @@ Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct
         return NULL;
     }
 
-    gint64 nFramesDone = 0;
     gint64 nFramesLeft = pChunk->nFrames;
     gint64 nFramesPos = 0;
-    TempFile *pTempFile = tempfile_Init(pChunk->pAudioInfo);
-    mainwindow_BeginProgress(pMainWindow, _("Fading"));
+    TempFile *pTempFile = tempfile_InitIntermediate(pChunk->pAudioInfo, pChunk->nFrames);
+
+    if (pTempFile == NULL)
+    {
+        chunk_Close(pChunkHandle, FALSE);
+
+        return NULL;
+    }
+
+    progress_Begin(pProgress, sDescription);
     gchar lBuffer[BUFFER_SIZE];
 
     while (nFramesLeft > 0)
@@ -849,26 +988,16 @@ Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct
         {
             chunk_Close(pChunkHandle, FALSE);
             tempfile_Abort(pTempFile);
-            mainwindow_EndProgress(pMainWindow);
+            progress_End(pProgress);
 
             return NULL;
         }
 
-        for (guint nFrame = 0; nFrame < nFramesRead; nFrame++)
-        {
-            gfloat fFactor = fStartFactor + ((fEndFactor - fStartFactor) * (GFLOAT(nFramesDone) / GFLOAT(pChunk->nFrames)));
-
-            for (gint nChannel = 0; nChannel < pChunkHandle->pAudioInfo->channels; nChannel++)
-            {
-                ((gfloat *)lBuffer)[nFrame * pChunkHandle->pAudioInfo->channels + nChannel] *= fFactor;
-            }
-
-            nFramesDone++;
-        }
+        dsp_Fade((gfloat *)lBuffer, nFramesRead, pChunkHandle->pAudioInfo->channels, fStartFactor, fEndFactor, nFramesPos, pChunk->nFrames);
 
         gboolean bError = FALSE;
 
-        if (pChunkHandle->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
+        if (!pTempFile->bFloat && pChunkHandle->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
         {
             gchar *lBytes = g_malloc(nFramesRead * pChunkHandle->pAudioInfo->bpf);
             gstconverter_ConvertBuffer(lBuffer, lBytes, nFramesRead, pChunkHandle->pAudioInfo, TRUE);
@@ -878,14 +1007,14 @@ Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct
         }
         else
         {
-            bError = tempfile_Write(pTempFile, lBuffer, nFramesRead * pChunkHandle->pAudioInfo->bpf);
+            bError = tempfile_Write(pTempFile, lBuffer, nFramesRead * pChunkHandle->pAudioInfo->channels * 4);
         }
 
         if (bError)
         {
             chunk_Close(pChunkHandle, FALSE);
             tempfile_Abort(pTempFile);
-            mainwindow_EndProgress(pMainWindow);
+            progress_End(pProgress);
 
             return NULL;
         }
@@ -893,11 +1022,11 @@ Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct
         nFramesLeft -= nFramesRead;
         nFramesPos += nFramesRead;
 
-        if (mainwindow_Progress(pMainWindow, GFLOAT(nFramesPos) / GFLOAT(pChunk->nFrames)))
+        if (progress_Update(pProgress, GFLOAT(nFramesPos) / GFLOAT(pChunk->nFrames)))
         {
             chunk_Close(pChunkHandle, FALSE);
             tempfile_Abort(pTempFile);
-            mainwindow_EndProgress(pMainWindow);
+            progress_End(pProgress);
 
             return NULL;
         }
@@ -905,11 +1034,21 @@ Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct
 
     chunk_Close(pChunkHandle, FALSE);
     Chunk *pChunkFaded = tempfile_Finished(pTempFile);
-    mainwindow_EndProgress(pMainWindow);
+    progress_End(pProgress);
 
     return pChunkFaded;
 }
 
+Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, Progress *pProgress)
+{
+    return chunk_Ramp(pChunk, fStartFactor, fEndFactor, _("Fading"), pProgress);
+}
+
+Chunk *chunk_Gain(Chunk *pChunk, gfloat fFactor, Progress *pProgress)
+{
+    return chunk_Ramp(pChunk, fFactor, fFactor, _("Changing gain"), pProgress);
+}
+
 /*Chunk* chunk_NewWithRamp(GstAudioInfo *pAudioInfo, gint64 nFrames, gfloat *startvals, gfloat *endvals, struct _MainWindow *pMainWindow)
 {
     gint i, k;
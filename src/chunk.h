@@ -24,12 +24,11 @@
 
 #include <gtk/gtk.h>
 #include "datasource.h"
+#include "progress.h"
 
 #define OE_TYPE_CHUNK chunk_get_type()
 G_DECLARE_FINAL_TYPE(Chunk, chunk, OE, CHUNK, GObject)
 
-struct _MainWindow;
-
 struct _Chunk
 {
     GObject parent_instance;
@@ -37,7 +36,7 @@ struct _Chunk
     GList *lParts;
     gint64 nFrames;
     gint64 nBytes;
-    guint nOpenCount;
+    gint nOpenCount;
 };
 
 typedef struct
@@ -50,21 +49,31 @@ typedef struct
 
 typedef Chunk ChunkHandle;
 
+typedef struct
+{
+    Chunk *pChunk;
+    gint64 nOffset;
+    gfloat fGain;
+
+} MixInput;
+
 Chunk *chunk_NewFromDatasource(DataSource *pDataSource);
 guint chunk_AliveCount();
 ChunkHandle *chunk_Open(Chunk *pChunk, gboolean bPlayer);
 //gboolean chunk_readFloat(ChunkHandle *pChunk, gint64 nStartFrame, gchar *lBuffer);
 guint chunk_Read(ChunkHandle *pChunk, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer);
 void chunk_Close(ChunkHandle *pChunk, gboolean bPlayer);
-Chunk *chunk_Mix(Chunk *pChunk1, Chunk *pChunk2, struct _MainWindow *pMainWindow);
-Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, struct _MainWindow *pMainWindow);
+Chunk *chunk_Mix(Chunk *pChunk1, Chunk *pChunk2, Progress *pProgress);
+Chunk *chunk_MixInputs(MixInput *lInputs, guint nInputs, gboolean bSoftLimit, Progress *pProgress);
+Chunk *chunk_Fade(Chunk *pChunk, gfloat fStartFactor, gfloat fEndFactor, Progress *pProgress);
+Chunk *chunk_Gain(Chunk *pChunk, gfloat fFactor, Progress *pProgress);
 Chunk *chunk_Append(Chunk *pChunk, Chunk *pChunkPart);
 //Chunk *chunk_InterpolateEndpoints(Chunk *pChunk, struct _MainWindow *pMainWindow);
 Chunk *chunk_Insert(Chunk *pChunk, Chunk *pChunkPart, gint64 nPosition);
 Chunk *chunk_GetPart(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames);
 Chunk *chunk_RemovePart(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames);
 Chunk *chunk_ReplacePart(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, Chunk *pChunkPart);
-Chunk *chunk_Load(gchar *sFilePath, struct _MainWindow *pMainWindow);
-gboolean chunk_Save(Chunk *chunk, gchar *sFilePath, struct _MainWindow *pMainWindow);
+Chunk *chunk_Load(gchar *sFilePath, Progress *pProgress);
+gboolean chunk_Save(Chunk *chunk, gchar *sFilePath, Progress *pProgress);
 
 #endif
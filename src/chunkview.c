@@ -22,12 +22,16 @@
 #include <math.h>
 #include "chunkview.h"
 #include "main.h"
+#include "trace.h"
 
 G_DEFINE_TYPE(ChunkView, chunkview, GTK_TYPE_DRAWING_AREA)
 
+#define CHUNKVIEW_FRAME_INTERVAL 16667
+
 enum {VIEW_CHANGED_SIGNAL, SELECTION_CHANGED_SIGNAL, CURSOR_CHANGED_SIGNAL, DOUBLE_CLICK_SIGNAL, LAST_SIGNAL};
 
 static gboolean m_bDragging = FALSE;
+static gboolean m_bScrubbing = FALSE;
 static gint64 m_nDragStart;
 static gint64 m_nDragEnd;
 static gboolean m_bAutoScroll = FALSE;
@@ -38,13 +42,15 @@ static guint m_nFontHeight = 0;
 static guint m_nFontWidth = 0;
 static guint m_lChunkViewSignals[LAST_SIGNAL] = {0};
 static void chunkview_RedrawFrames(ChunkView *pChunkView, gint64 nStart, gint64 nEnd);
+static void chunkview_Invalidate(ChunkView *pChunkView, gint nLeft, gint nRight);
+static void chunkview_InvalidateAll(ChunkView *pChunkView);
 static gint chunkview_CalcX(ChunkView *pChunkView, gint64 nFrame);
 static gboolean chunkview_AutoScroll();
 static guint chunkview_FindTimescalePoints(guint32 nSampleRate, gint64 nStartFrame, gint64 nEndFrame, gint64 *lPoints, gint *nPoints, gint64 *lMidPoints, gint *nMidPoints, gint64 *lMinorPoints, gint *nMinorPoints);
 
 static void chunkview_OnChanged(Document *pDocument, ChunkView *pChunkView)
 {
-    gtk_widget_queue_draw(GTK_WIDGET(pChunkView));
+    chunkview_InvalidateAll(pChunkView);
 }
 
 static void chunkview_OnSelectionChanged(Document *pDocument, ChunkView *pChunkView)
@@ -95,10 +101,7 @@ static void chunkview_OnCursorChanged(Document *pDocument, gboolean bRolling, Ch
     {
         for (gint nPix = 0; nPix < 2; nPix++)
         {
-            if (lPix[nPix] > -1 && lPix[nPix] < pChunkView->nWidth)
-            {
-                gtk_widget_queue_draw_area(GTK_WIDGET(pChunkView), lPix[nPix], 0, 1, pChunkView->nHeight - m_nFontHeight);
-            }
+            chunkview_Invalidate(pChunkView, lPix[nPix], lPix[nPix] + 1);
         }
     }
 }
@@ -115,6 +118,13 @@ static void chunkview_OnDestroy(GtkWidget *pWidget)
     }
 
     pChunkView->pDocument = NULL;
+
+    if (pChunkView->nTickId)
+    {
+        gtk_widget_remove_tick_callback(pWidget, pChunkView->nTickId);
+        pChunkView->nTickId = 0;
+    }
+
     GTK_WIDGET_CLASS(chunkview_parent_class)->destroy(pWidget);
 
     if (pChunkView->pViewCache)
@@ -494,6 +504,7 @@ static void chunkview_OnSizeAllocate(GtkWidget *pWidget, GtkAllocation *pAllocat
     }
 
     viewcache_Update(pChunkView->pViewCache, pChunkView->pDocument->pChunk, pChunkView->pDocument->nViewStart, pChunkView->pDocument->nViewEnd, pAllocation->width, NULL, NULL);
+    chunkview_InvalidateAll(pChunkView);
 }
 
 static gint64 chunkview_CalcFrame(ChunkView *pChunkView, gfloat fPos, gfloat fMax)
@@ -609,7 +620,12 @@ static gint chunkview_OnButtonPress(GtkWidget *pWidget, GdkEventButton *pEventBu
         m_nDragStart = m_nDragEnd = pChunkView->pDocument->nSelEnd;
     }
 
-    if ((pEventButton->state & GDK_SHIFT_MASK) != 0 && pChunkView->pDocument->nSelEnd != pChunkView->pDocument->nSelStart)
+    if (pEventButton->button == 1 && (pEventButton->state & GDK_CONTROL_MASK) != 0)
+    {
+        m_bScrubbing = TRUE;
+        document_Scrub(pChunkView->pDocument, chunkview_CalcFrame(pChunkView, pEventButton->x, GFLOAT(pChunkView->nWidth)));
+    }
+    else if ((pEventButton->state & GDK_SHIFT_MASK) != 0 && pChunkView->pDocument->nSelEnd != pChunkView->pDocument->nSelStart)
     {
         m_bDragging = TRUE;
 
@@ -679,7 +695,12 @@ static gint chunkview_OnMotionNotify(GtkWidget *pWidget, GdkEventMotion *pEventM
         return FALSE;
     }
 
-    if (m_bDragging)
+    if (m_bScrubbing)
+    {
+        gdouble fX = CLAMP(pEventMotion->x, 0.0, GDOUBLE(pChunkView->nWidth));
+        document_ScrubTo(pChunkView->pDocument, chunkview_CalcFrame(pChunkView, fX, GFLOAT(pChunkView->nWidth)));
+    }
+    else if (m_bDragging)
     {
         if (pEventMotion->x < pChunkView->nWidth)
         {
@@ -817,6 +838,12 @@ static gint chunkview_OnButtonRelease(GtkWidget *pWidget, GdkEventButton *pEvent
         document_PlaySelection(pChunkView->pDocument);
     }
 
+    if (m_bScrubbing && pChunkView->pDocument != NULL)
+    {
+        document_Stop(pChunkView->pDocument);
+    }
+
+    m_bScrubbing = FALSE;
     m_bAutoScroll = FALSE;
     m_bDragging = FALSE;
 
@@ -840,6 +867,11 @@ static void chunkview_init(ChunkView *pChunkView)
 {
     pChunkView->pDocument = NULL;
     pChunkView->fScaleFactor = 1.0;
+    pChunkView->nTickId = 0;
+    pChunkView->nDirtyLeft = -1;
+    pChunkView->nDirtyRight = -1;
+    pChunkView->bDirtyAll = FALSE;
+    pChunkView->bCacheBusy = FALSE;
     pChunkView->pViewCache = viewcache_New();
     gtk_widget_set_events(GTK_WIDGET(pChunkView), GDK_BUTTON_MOTION_MASK | GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK | GDK_POINTER_MOTION_MASK | GDK_SCROLL_MASK);
 
@@ -899,53 +931,105 @@ void chunkview_SetDocument(ChunkView *pChunkView, Document *pDocument)
 
 static void chunkview_RedrawFrames(ChunkView *pChunkView, gint64 nStart, gint64 nEnd)
 {
-    guint nStartPix = chunkview_CalcX(pChunkView, nStart);
-    guint nEndPix = chunkview_CalcX(pChunkView, nEnd);
-
-    gtk_widget_queue_draw_area(GTK_WIDGET(pChunkView), nStartPix, 0, nEndPix - nStartPix, pChunkView->nHeight - m_nFontHeight);
+    chunkview_Invalidate(pChunkView, chunkview_CalcX(pChunkView, nStart), chunkview_CalcX(pChunkView, nEnd));
 }
 
-gboolean chunkview_UpdateCache(ChunkView *pChunkView)
+static gboolean chunkview_OnTick(GtkWidget *pWidget, GdkFrameClock *pFrameClock, gpointer pUserData)
 {
-    gint nNeedRedrawLeft;
-    gint nNeedRedrawRight;
-    gboolean bUpdate = viewcache_Update(pChunkView->pViewCache, pChunkView->pDocument->pChunk, pChunkView->pDocument->nViewStart, pChunkView->pDocument->nViewEnd, pChunkView->nWidth, &nNeedRedrawLeft, &nNeedRedrawRight);
+    ChunkView *pChunkView = OE_CHUNK_VIEW(pWidget);
+    gint64 nTraceStart = trace_Begin();
 
-    if (!bUpdate && pChunkView->nNeedRedrawLeft != -1)
+    if (pChunkView->bCacheBusy && pChunkView->pDocument != NULL)
     {
-        gtk_widget_queue_draw_area(GTK_WIDGET(pChunkView), pChunkView->nNeedRedrawLeft, 0, pChunkView->nNeedRedrawRight - pChunkView->nNeedRedrawLeft, pChunkView->nHeight - m_nFontHeight);
-        pChunkView->nNeedRedrawLeft = -1;
-    }
+        // Fill the cache for at most half a frame, so drawing still makes the next one
+        gint64 nInterval = 0;
+        gdk_frame_clock_get_refresh_info(pFrameClock, gdk_frame_clock_get_frame_time(pFrameClock), &nInterval, NULL);
 
-    if (bUpdate && nNeedRedrawLeft != nNeedRedrawRight)
-    {
-        if (pChunkView->nNeedRedrawLeft == -1)
+        if (nInterval <= 0)
         {
-            pChunkView->nNeedRedrawLeft = nNeedRedrawLeft;
-            pChunkView->nNeedRedrawRight = nNeedRedrawRight;
+            nInterval = CHUNKVIEW_FRAME_INTERVAL;
         }
-        else
+
+        gint64 nDeadline = g_get_monotonic_time() + nInterval / 2;
+
+        do
         {
-            if (nNeedRedrawLeft < pChunkView->nNeedRedrawLeft)
-            {
-                pChunkView->nNeedRedrawLeft = nNeedRedrawLeft;
-            }
+            gint nLeft = 0;
+            gint nRight = 0;
+            pChunkView->bCacheBusy = viewcache_Update(pChunkView->pViewCache, pChunkView->pDocument->pChunk, pChunkView->pDocument->nViewStart, pChunkView->pDocument->nViewEnd, pChunkView->nWidth, &nLeft, &nRight);
 
-            if (nNeedRedrawRight > pChunkView->nNeedRedrawRight)
+            if (pChunkView->bCacheBusy)
             {
-                pChunkView->nNeedRedrawRight = nNeedRedrawRight;
+                chunkview_Invalidate(pChunkView, nLeft, nRight);
             }
         }
+        while (pChunkView->bCacheBusy && g_get_monotonic_time() < nDeadline);
+    }
+    else
+    {
+        pChunkView->bCacheBusy = FALSE;
+    }
 
-        if (pChunkView->nNeedRedrawRight - pChunkView->nNeedRedrawLeft > 20 || (pChunkView->nLastRedrawTime != time(0)) || viewcache_Updated(pChunkView->pViewCache))
-        {
-            gtk_widget_queue_draw_area(GTK_WIDGET(pChunkView), pChunkView->nNeedRedrawLeft, 0, pChunkView->nNeedRedrawRight - pChunkView->nNeedRedrawLeft, pChunkView->nHeight - m_nFontHeight);
-            pChunkView->nLastRedrawTime = time(0);
-            pChunkView->nNeedRedrawLeft = -1;
-        }
+    if (pChunkView->bDirtyAll)
+    {
+        gtk_widget_queue_draw(pWidget);
     }
+    else if (pChunkView->nDirtyLeft != -1)
+    {
+        gtk_widget_queue_draw_area(pWidget, pChunkView->nDirtyLeft, 0, pChunkView->nDirtyRight - pChunkView->nDirtyLeft, pChunkView->nHeight - m_nFontHeight);
+    }
+
+    pChunkView->bDirtyAll = FALSE;
+    pChunkView->nDirtyLeft = -1;
+    trace_End("chunkview_OnTick", nTraceStart);
+
+    if (pChunkView->bCacheBusy)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    pChunkView->nTickId = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void chunkview_Schedule(ChunkView *pChunkView)
+{
+    if (!pChunkView->nTickId)
+    {
+        pChunkView->nTickId = gtk_widget_add_tick_callback(GTK_WIDGET(pChunkView), chunkview_OnTick, NULL, NULL);
+    }
+}
 
-    return bUpdate;
+static void chunkview_Invalidate(ChunkView *pChunkView, gint nLeft, gint nRight)
+{
+    nLeft = MAX(nLeft, 0);
+    nRight = MIN(nRight, (gint)pChunkView->nWidth);
+
+    if (nLeft >= nRight)
+    {
+        return;
+    }
+
+    if (pChunkView->nDirtyLeft == -1)
+    {
+        pChunkView->nDirtyLeft = nLeft;
+        pChunkView->nDirtyRight = nRight;
+    }
+    else
+    {
+        pChunkView->nDirtyLeft = MIN(pChunkView->nDirtyLeft, nLeft);
+        pChunkView->nDirtyRight = MAX(pChunkView->nDirtyRight, nRight);
+    }
+
+    chunkview_Schedule(pChunkView);
+}
+
+static void chunkview_InvalidateAll(ChunkView *pChunkView)
+{
+    pChunkView->bDirtyAll = TRUE;
+    pChunkView->bCacheBusy = pChunkView->pDocument != NULL;
+    chunkview_Schedule(pChunkView);
 }
 
 void chunkview_ForceRepaint(ChunkView *pChunkView)
@@ -34,16 +34,17 @@ struct _ChunkView
     guint nWidth;
     guint nHeight;
     ViewCache *pViewCache;
-    gint nLastRedrawTime;
-    gint nNeedRedrawLeft;
-    gint nNeedRedrawRight;
+    guint nTickId;
+    gint nDirtyLeft;
+    gint nDirtyRight;
+    gboolean bDirtyAll;
+    gboolean bCacheBusy;
     gfloat fScaleFactor;
     Document *pDocument;
 };
 
 ChunkView *chunkview_new();
 void chunkview_SetDocument(ChunkView *pChunkView, Document *pDocument);
-gboolean chunkview_UpdateCache(ChunkView *pChunkView);
 void chunkview_ForceRepaint(ChunkView *pChunkView);
 void chunkview_SetScale(ChunkView *pChunkView, gfloat fScale);
 
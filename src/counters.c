@@ -0,0 +1,115 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <stdio.h>
+#include <glib/gi18n.h>
+#include "counters.h"
+#include "chunk.h"
+#include "main.h"
+
+static volatile gssize m_lCounters[COUNTER_LAST];
+static gint64 m_nStartTime = 0;
+
+void counters_Init()
+{
+    m_nStartTime = g_get_monotonic_time();
+}
+
+void counters_Add(Counter nCounter, gssize nValue)
+{
+    g_atomic_pointer_add(&m_lCounters[nCounter], nValue);
+}
+
+void counters_Snapshot(CountersSnapshot *pSnapshot)
+{
+    pSnapshot->nTime = g_get_monotonic_time();
+
+    for (gint nCounter = 0; nCounter < COUNTER_LAST; nCounter++)
+    {
+        pSnapshot->lValues[nCounter] = (gssize)g_atomic_pointer_get(&m_lCounters[nCounter]);
+    }
+
+    pSnapshot->nChunks = chunk_AliveCount();
+    datasource_GetUsage(pSnapshot);
+}
+
+static gchar *counters_FormatRate(CountersSnapshot *pSnapshot, CountersSnapshot *pPrevious, Counter nCounter, gdouble fSeconds)
+{
+    gssize nValue = pSnapshot->lValues[nCounter] - (pPrevious ? pPrevious->lValues[nCounter] : 0);
+    gchar *sTotal = g_format_size(pSnapshot->lValues[nCounter]);
+    gchar *sRate = g_format_size((guint64)(GDOUBLE(nValue) / fSeconds));
+    // Translators: A transfer rate followed by the total, for example "2.1 MB/s, 1.4 GB total"
+    gchar *sText = g_strdup_printf(_("%s/s, %s total"), sRate, sTotal);
+    g_free(sTotal);
+    g_free(sRate);
+
+    return sText;
+}
+
+gchar *counters_Format(CountersSnapshot *pSnapshot, CountersSnapshot *pPrevious)
+{
+    gint64 nTimeStart = pPrevious ? pPrevious->nTime : m_nStartTime;
+    gdouble fSeconds = MAX(GDOUBLE(pSnapshot->nTime - nTimeStart) / G_USEC_PER_SEC, 0.001);
+    gdouble fPixels = GDOUBLE(pSnapshot->lValues[COUNTER_VIEWCACHE_PIXELS] - (pPrevious ? pPrevious->lValues[COUNTER_VIEWCACHE_PIXELS] : 0)) / fSeconds;
+    gchar *sRead = counters_FormatRate(pSnapshot, pPrevious, COUNTER_BYTES_READ, fSeconds);
+    gchar *sWritten = counters_FormatRate(pSnapshot, pPrevious, COUNTER_BYTES_WRITTEN, fSeconds);
+    gchar *sDecoded = counters_FormatRate(pSnapshot, pPrevious, COUNTER_BYTES_DECODED, fSeconds);
+    gchar *sBytesReal = g_format_size(pSnapshot->nBytesReal);
+    gchar *sBytesTemp = g_format_size(pSnapshot->nBytesTemp);
+    gchar *sBlockCache = g_format_size(pSnapshot->lValues[COUNTER_BLOCKCACHE_BYTES]);
+
+    GString *sText = g_string_new(NULL);
+    g_string_append_printf(sText, "%s: %u\n", _("Chunks"), pSnapshot->nChunks);
+    g_string_append_printf(sText, "%s: %u\n", _("Sources in memory"), pSnapshot->nSourcesReal);
+    g_string_append_printf(sText, "%s: %u\n", _("Sources in temporary files"), pSnapshot->nSourcesTemp);
+    g_string_append_printf(sText, "%s: %u\n", _("Sources read by GStreamer"), pSnapshot->nSourcesGst);
+    g_string_append_printf(sText, "%s: %u\n", _("Silent sources"), pSnapshot->nSourcesSilence);
+    g_string_append_printf(sText, "%s: %s\n", _("Memory used by sources"), sBytesReal);
+    g_string_append_printf(sText, "%s: %s\n", _("Temporary disk space"), sBytesTemp);
+    g_string_append_printf(sText, "%s: %"G_GSSIZE_FORMAT"\n", _("Open GStreamer pipelines"), pSnapshot->lValues[COUNTER_GST_PIPELINES]);
+    g_string_append_printf(sText, "%s: %"G_GSSIZE_FORMAT"\n", _("Open source handles"), pSnapshot->lValues[COUNTER_OPEN_HANDLES]);
+    g_string_append_printf(sText, "%s: %s\n", _("Read from disk"), sRead);
+    g_string_append_printf(sText, "%s: %s\n", _("Written to disk"), sWritten);
+    g_string_append_printf(sText, "%s: %s\n", _("Decoded by GStreamer"), sDecoded);
+    g_string_append_printf(sText, "%s: %.0f/s\n", _("View cache pixels"), fPixels);
+    g_string_append_printf(sText, "%s: %"G_GSSIZE_FORMAT"\n", _("Player slow reads"), pSnapshot->lValues[COUNTER_PLAYER_SLOW_READS]);
+    g_string_append_printf(sText, "%s: %"G_GSSIZE_FORMAT"\n", _("Recording overruns"), pSnapshot->lValues[COUNTER_RECORD_OVERRUNS]);
+    // Translators: Size held by the cache, then the number of cache hits and misses
+    g_string_append_printf(sText, "%s: %s, %"G_GSSIZE_FORMAT" / %"G_GSSIZE_FORMAT, _("Float block cache (hits / misses)"), sBlockCache, pSnapshot->lValues[COUNTER_BLOCKCACHE_HITS], pSnapshot->lValues[COUNTER_BLOCKCACHE_MISSES]);
+
+    g_free(sRead);
+    g_free(sWritten);
+    g_free(sDecoded);
+    g_free(sBytesReal);
+    g_free(sBytesTemp);
+    g_free(sBlockCache);
+
+    return g_string_free(sText, FALSE);
+}
+
+void counters_Dump()
+{
+    CountersSnapshot cSnapshot;
+    counters_Snapshot(&cSnapshot);
+    gchar *sText = counters_Format(&cSnapshot, NULL);
+    printf("%s\n", sText);
+    fflush(stdout);
+    g_free(sText);
+}
@@ -0,0 +1,63 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef COUNTERS_H_INCLUDED
+#define COUNTERS_H_INCLUDED
+
+#include <glib.h>
+
+typedef enum
+{
+    COUNTER_GST_PIPELINES,
+    COUNTER_OPEN_HANDLES,
+    COUNTER_BYTES_READ,
+    COUNTER_BYTES_WRITTEN,
+    COUNTER_BYTES_DECODED,
+    COUNTER_VIEWCACHE_PIXELS,
+    COUNTER_PLAYER_SLOW_READS,
+    COUNTER_RECORD_OVERRUNS,
+    COUNTER_BLOCKCACHE_HITS,
+    COUNTER_BLOCKCACHE_MISSES,
+    COUNTER_BLOCKCACHE_BYTES,
+    COUNTER_LAST
+
+} Counter;
+
+typedef struct
+{
+    gint64 nTime;
+    gssize lValues[COUNTER_LAST];
+    guint nChunks;
+    guint nSourcesReal;
+    guint nSourcesTemp;
+    guint nSourcesGst;
+    guint nSourcesSilence;
+    gint64 nBytesReal;
+    gint64 nBytesTemp;
+
+} CountersSnapshot;
+
+void counters_Init();
+void counters_Add(Counter nCounter, gssize nValue);
+void counters_Snapshot(CountersSnapshot *pSnapshot);
+gchar *counters_Format(CountersSnapshot *pSnapshot, CountersSnapshot *pPrevious);
+void counters_Dump();
+
+#endif
@@ -24,10 +24,28 @@
 #include "message.h"
 #include "datasource.h"
 #include "tempfile.h"
+#include "trace.h"
+#include "scratch.h"
+#include "blockcache.h"
 
 G_DEFINE_TYPE(DataSource, datasource, G_TYPE_OBJECT)
 
+#define DATASOURCE_POOL_SIZE 32
+
+typedef struct
+{
+    DataSource *pDataSource;
+    gboolean bPlayer;
+    guint nPins;
+    gpointer pHandle;
+    GMutex pMutex;
+
+} PoolEntry;
+
 static GList *m_lDataSources = NULL;
+static GQueue m_qPool = G_QUEUE_INIT;
+G_LOCK_DEFINE_STATIC(POOL);
+G_LOCK_DEFINE_STATIC(DATASOURCES);
 
 DataSource *datasource_new()
 {
@@ -38,18 +56,91 @@ DataSource *datasource_new()
 
 guint datasource_Count()
 {
-    return g_list_length(m_lDataSources);
+    G_LOCK(DATASOURCES);
+    guint nCount = g_list_length(m_lDataSources);
+    G_UNLOCK(DATASOURCES);
+
+    return nCount;
+}
+
+static guint datasource_GetStorageFrameSize(DataSource *pDataSource)
+{
+    if (pDataSource->bFloatStorage)
+    {
+        return pDataSource->pAudioInfo->channels * 4;
+    }
+
+    return pDataSource->pAudioInfo->bpf;
+}
+
+void datasource_GetUsage(CountersSnapshot *pSnapshot)
+{
+    pSnapshot->nSourcesReal = 0;
+    pSnapshot->nSourcesTemp = 0;
+    pSnapshot->nSourcesGst = 0;
+    pSnapshot->nSourcesSilence = 0;
+    pSnapshot->nBytesReal = 0;
+    pSnapshot->nBytesTemp = 0;
+    G_LOCK(DATASOURCES);
+
+    for (GList *l = m_lDataSources; l != NULL; l = l->next)
+    {
+        DataSource *pDataSource = (DataSource*)l->data;
+        gint64 nBytes = pDataSource->pAudioInfo ? pDataSource->nFrames * datasource_GetStorageFrameSize(pDataSource) : 0;
+
+        switch (pDataSource->nType)
+        {
+            case DATASOURCE_REAL:
+            {
+                pSnapshot->nSourcesReal++;
+                pSnapshot->nBytesReal += nBytes;
+
+                break;
+            }
+            case DATASOURCE_TEMPFILE:
+            {
+                pSnapshot->nSourcesTemp++;
+                pSnapshot->nBytesTemp += nBytes;
+
+                break;
+            }
+            case DATASOURCE_GSTTEMP:
+            {
+                pSnapshot->nSourcesGst++;
+
+                if (pDataSource->pData.pGstReader.sTempFilePath)
+                {
+                    pSnapshot->nBytesTemp += nBytes;
+                }
+
+                break;
+            }
+            case DATASOURCE_SILENCE:
+            {
+                pSnapshot->nSourcesSilence++;
+
+                break;
+            }
+        }
+    }
+
+    G_UNLOCK(DATASOURCES);
 }
 
 static void datasource_init(DataSource *pDataSource)
 {
+    G_LOCK(DATASOURCES);
     m_lDataSources = g_list_append(m_lDataSources, pDataSource);
+    G_UNLOCK(DATASOURCES);
     pDataSource->nType = DATASOURCE_SILENCE;
     pDataSource->pAudioInfo = NULL;
     pDataSource->nFrames = 0;
     pDataSource->nBytes = 0;
     pDataSource->nOpenCountData = 0;
     pDataSource->nOpenCountPlayer = 0;
+    pDataSource->bFloatStorage = FALSE;
+    pDataSource->lPoolLinkData = NULL;
+    pDataSource->lPoolLinkPlayer = NULL;
 }
 
 static void datasource_OnDispose(GObject *pObject)
@@ -60,13 +151,15 @@ static void datasource_OnDispose(GObject *pObject)
     g_assert(pDataSource->nOpenCountData == 0);
     g_assert(pDataSource->nOpenCountPlayer == 0);
 
+    blockcache_Forget(pDataSource);
+
     switch (pDataSource->nType)
     {
         case DATASOURCE_TEMPFILE:
         {
             if (pDataSource->pData.pVirtual.sFilePath)
             {
-                unlink(pDataSource->pData.pVirtual.sFilePath);
+                scratch_Unref(pDataSource->pData.pVirtual.sFilePath);
             }
         }
         case DATASOURCE_REAL:
@@ -94,7 +187,7 @@ static void datasource_OnDispose(GObject *pObject)
                 
             if (sFilePath)
             {
-                file_Unlink(sFilePath);
+                scratch_Unref(sFilePath);
             }
             
             if (pDataSource->pData.pGstReader.sTempFilePath)
@@ -108,7 +201,9 @@ static void datasource_OnDispose(GObject *pObject)
     gst_audio_info_free(pDataSource->pAudioInfo);
     pDataSource->pAudioInfo = NULL;
     pDataSource->nType = DATASOURCE_SILENCE;
+    G_LOCK(DATASOURCES);
     m_lDataSources = g_list_remove(m_lDataSources, pObject);
+    G_UNLOCK(DATASOURCES);
     G_OBJECT_CLASS(datasource_parent_class)->dispose(pObject);
 }
 
@@ -117,65 +212,193 @@ static void datasource_class_init(DataSourceClass *cls)
     G_OBJECT_CLASS(cls)->dispose = datasource_OnDispose;
 }
 
-gboolean datasource_Open(DataSource *pDataSource, gboolean bPlayer)
+static GList **datasource_GetPoolLink(DataSource *pDataSource, gboolean bPlayer)
 {
-    if ((bPlayer && pDataSource->nOpenCountPlayer == 0) || (!bPlayer && pDataSource->nOpenCountData == 0))
+    if (bPlayer && pDataSource->nType != DATASOURCE_TEMPFILE)
     {
-        switch (pDataSource->nType)
-        {
-            case DATASOURCE_TEMPFILE:
-            {
-                pDataSource->pData.pVirtual.pHandle = file_Open(pDataSource->pData.pVirtual.sFilePath, FILE_READ, TRUE);
+        return &pDataSource->lPoolLinkPlayer;
+    }
 
-                if (pDataSource->pData.pVirtual.pHandle == NULL)
-                {
-                    return TRUE;
-                }
+    return &pDataSource->lPoolLinkData;
+}
 
-                pDataSource->pData.pVirtual.nPos = 0;
+static gpointer datasource_OpenHandle(DataSource *pDataSource, gboolean bPlayer)
+{
+    gpointer pHandle = NULL;
 
-                break;
+    switch (pDataSource->nType)
+    {
+        case DATASOURCE_TEMPFILE:
+        {
+            pHandle = file_Open(pDataSource->pData.pVirtual.sFilePath, FILE_READ, !bPlayer);
+
+            break;
+        }
+        case DATASOURCE_GSTTEMP:
+        {
+            gchar *sFilePath;
+
+            if (pDataSource->pData.pGstReader.sTempFilePath)
+            {
+                sFilePath = pDataSource->pData.pGstReader.sTempFilePath;
             }
-            case DATASOURCE_GSTTEMP:
+            else
             {
-                gchar *sFilePath;
-                
-                if (pDataSource->pData.pGstReader.sTempFilePath)
-                {
-                    sFilePath = pDataSource->pData.pGstReader.sTempFilePath;
-                }
-                else
-                {
-                    sFilePath = pDataSource->pData.pGstReader.sFilePath;
-                }
-    
-                GstReader *pGstReader = gstreader_New(sFilePath);
+                sFilePath = pDataSource->pData.pGstReader.sFilePath;
+            }
 
-                if (pGstReader == NULL)
-                {
-                    gchar *sMessage = g_strdup_printf(_("Could not open %s"), sFilePath);
-                    message_Error(sMessage);
-                    g_free(sMessage);
+            pHandle = gstreader_New(sFilePath);
 
-                    return TRUE;
-                }
-                    
+            if (pHandle == NULL)
+            {
                 if (bPlayer)
                 {
-                    pDataSource->pData.pGstReader.pHandlePlayer = pGstReader;
-                    pDataSource->pData.pGstReader.nPosPlayer = 0;
+                    g_warning("Could not open %s", sFilePath);
                 }
                 else
                 {
-                    pDataSource->pData.pGstReader.pHandleData = pGstReader;
-                    pDataSource->pData.pGstReader.nPosData = 0;
+                    gchar *sMessage = g_strdup_printf(_("Could not open %s"), sFilePath);
+                    message_Error(sMessage);
+                    g_free(sMessage);
                 }
-
-                break;
             }
+
+            break;
+        }
+    }
+
+    if (pHandle)
+    {
+        counters_Add(COUNTER_OPEN_HANDLES, 1);
+    }
+
+    return pHandle;
+}
+
+static void datasource_CloseHandle(gint nType, gpointer pHandle)
+{
+    switch (nType)
+    {
+        case DATASOURCE_TEMPFILE:
+        {
+            file_Close((File*)pHandle, FALSE);
+
+            break;
+        }
+        case DATASOURCE_GSTTEMP:
+        {
+            gstreader_Free((GstReader*)pHandle);
+
+            break;
+        }
+    }
+
+    counters_Add(COUNTER_OPEN_HANDLES, -1);
+}
+
+static void datasource_PoolRemove(GList *lLink)
+{
+    PoolEntry *pEntry = (PoolEntry*)lLink->data;
+    g_queue_unlink(&m_qPool, lLink);
+    *datasource_GetPoolLink(pEntry->pDataSource, pEntry->bPlayer) = NULL;
+    datasource_CloseHandle(pEntry->pDataSource->nType, pEntry->pHandle);
+    g_mutex_clear(&pEntry->pMutex);
+    g_free(pEntry);
+    g_list_free_1(lLink);
+}
+
+static gboolean datasource_Acquire(DataSource *pDataSource, gboolean bPlayer, PoolEntry **pEntry)
+{
+    *pEntry = NULL;
+
+    if (pDataSource->nType != DATASOURCE_TEMPFILE && pDataSource->nType != DATASOURCE_GSTTEMP)
+    {
+        return FALSE;
+    }
+
+    GList **lPoolLink = datasource_GetPoolLink(pDataSource, bPlayer);
+
+    G_LOCK(POOL);
+
+    if (*lPoolLink != NULL)
+    {
+        *pEntry = (PoolEntry*)(*lPoolLink)->data;
+        (*pEntry)->nPins++;
+        g_queue_unlink(&m_qPool, *lPoolLink);
+        g_queue_push_head_link(&m_qPool, *lPoolLink);
+        G_UNLOCK(POOL);
+
+        return FALSE;
+    }
+
+    GList *lLink = m_qPool.tail;
+
+    while (lLink != NULL && g_queue_get_length(&m_qPool) >= DATASOURCE_POOL_SIZE)
+    {
+        GList *lPrev = lLink->prev;
+
+        if (((PoolEntry*)lLink->data)->nPins == 0)
+        {
+            datasource_PoolRemove(lLink);
         }
+
+        lLink = lPrev;
+    }
+
+    G_UNLOCK(POOL);
+
+    gint64 nTraceStart = trace_Begin();
+    gpointer pHandle = datasource_OpenHandle(pDataSource, bPlayer);
+    trace_End("datasource_Open", nTraceStart);
+
+    if (pHandle == NULL)
+    {
+        return TRUE;
+    }
+
+    G_LOCK(POOL);
+
+    // Another reader may have opened the same source while the lock was released
+    if (*lPoolLink != NULL)
+    {
+        *pEntry = (PoolEntry*)(*lPoolLink)->data;
+        (*pEntry)->nPins++;
+        G_UNLOCK(POOL);
+        datasource_CloseHandle(pDataSource->nType, pHandle);
+
+        return FALSE;
+    }
+
+    *pEntry = g_malloc(sizeof(PoolEntry));
+    (*pEntry)->pDataSource = pDataSource;
+    (*pEntry)->bPlayer = bPlayer && pDataSource->nType != DATASOURCE_TEMPFILE;
+    (*pEntry)->nPins = 1;
+    (*pEntry)->pHandle = pHandle;
+    g_mutex_init(&(*pEntry)->pMutex);
+    g_queue_push_head(&m_qPool, *pEntry);
+    *lPoolLink = m_qPool.head;
+
+    G_UNLOCK(POOL);
+
+    return FALSE;
+}
+
+static void datasource_Release(PoolEntry *pEntry)
+{
+    if (pEntry == NULL)
+    {
+        return;
     }
 
+    G_LOCK(POOL);
+    pEntry->nPins--;
+    G_UNLOCK(POOL);
+}
+
+gboolean datasource_Open(DataSource *pDataSource, gboolean bPlayer)
+{
+    G_LOCK(POOL);
+
     if (bPlayer)
     {
         pDataSource->nOpenCountPlayer++;
@@ -185,59 +408,46 @@ gboolean datasource_Open(DataSource *pDataSource, gboolean bPlayer)
         pDataSource->nOpenCountData++;
     }
 
+    G_UNLOCK(POOL);
+
     return FALSE;
 }
 
 void datasource_Close(DataSource *pDataSource, gboolean bPlayer)
 {
+    G_LOCK(POOL);
+
     if (bPlayer)
     {
         g_assert(pDataSource->nOpenCountPlayer != 0);
         pDataSource->nOpenCountPlayer--;
-
-        if (pDataSource->nOpenCountPlayer > 0)
-        {
-            return;
-        }
     }
     else
     {
         g_assert(pDataSource->nOpenCountData != 0);
         pDataSource->nOpenCountData--;
-
-        if (pDataSource->nOpenCountData > 0)
-        {
-            return;
-        }
     }
 
-    switch (pDataSource->nType)
+    // Temp files share one handle between all readers, GStreamer readers keep one per side
+    gboolean bUnused = bPlayer ? pDataSource->nOpenCountPlayer == 0 : pDataSource->nOpenCountData == 0;
+
+    if (pDataSource->nType == DATASOURCE_TEMPFILE)
     {
-        case DATASOURCE_TEMPFILE:
-        {
-            file_Close(pDataSource->pData.pVirtual.pHandle, FALSE);
-            
-            break;
-        }
-        case DATASOURCE_GSTTEMP:
-        {
-            if (bPlayer)
-            {
-                gstreader_Free(pDataSource->pData.pGstReader.pHandlePlayer);
-                pDataSource->pData.pGstReader.pHandlePlayer = NULL;
-            }
-            else
-            {
-                gstreader_Free(pDataSource->pData.pGstReader.pHandleData);
-                pDataSource->pData.pGstReader.pHandleData = NULL;
-            }
+        bUnused = pDataSource->nOpenCountPlayer == 0 && pDataSource->nOpenCountData == 0;
+    }
 
-            break;
-        }
+    GList *lPoolLink = *datasource_GetPoolLink(pDataSource, bPlayer);
+
+    if (bUnused && lPoolLink != NULL)
+    {
+        g_assert(((PoolEntry*)lPoolLink->data)->nPins == 0);
+        datasource_PoolRemove(lPoolLink);
     }
+
+    G_UNLOCK(POOL);
 }
 
-guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer)
+static guint datasource_readMain(DataSource *pDataSource, PoolEntry *pEntry, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer)
 {
     if (bPlayer)
     {
@@ -267,6 +477,8 @@ guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames
         nFrameSize = pDataSource->pAudioInfo->channels * 4;
     }
 
+    guint nStorageFrameSize = datasource_GetStorageFrameSize(pDataSource);
+
     switch (pDataSource->nType)
     {
         case DATASOURCE_SILENCE:
@@ -276,80 +488,70 @@ guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames
             return nFrames;
         }
         case DATASOURCE_REAL:
-        {           
-            if (bFloat && pDataSource->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
+        {
+            gchar *lData = pDataSource->pData.lReal + (nStartFrame * nStorageFrameSize);
+
+            if (pDataSource->bFloatStorage && !bFloat)
+            {
+                gstconverter_ConvertBuffer(lData, lBuffer, nFrames, pDataSource->pAudioInfo, TRUE);
+            }
+            else if (bFloat && !pDataSource->bFloatStorage && pDataSource->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
             {
                 gchar *lFloatBuffer = g_malloc(nFrames * nFrameSize);
-                gstconverter_ConvertBuffer(lFloatBuffer, pDataSource->pData.lReal + (nStartFrame * pDataSource->pAudioInfo->bpf), nFrames, pDataSource->pAudioInfo, FALSE);
+                gstconverter_ConvertBuffer(lFloatBuffer, lData, nFrames, pDataSource->pAudioInfo, FALSE);
                 memcpy(lBuffer, lFloatBuffer, nFrames * nFrameSize);
                 g_free(lFloatBuffer);
             }
             else
             {
-                memcpy(lBuffer, pDataSource->pData.lReal + (nStartFrame * nFrameSize), nFrames * nFrameSize);
+                memcpy(lBuffer, lData, nFrames * nFrameSize);
             }
         
             return nFrames;
         }
         case DATASOURCE_TEMPFILE:
         {
-            gint64 nStartByte = pDataSource->pData.pVirtual.nOffset + (nStartFrame * pDataSource->pAudioInfo->bpf);
-
-            if (nStartByte != pDataSource->pData.pVirtual.nPos && file_Seek(pDataSource->pData.pVirtual.pHandle, nStartByte, SEEK_SET))
-            {
-                return 0;
-            }
-
-            pDataSource->pData.pVirtual.nPos = nStartByte;
+            File *pHandle = (File*)pEntry->pHandle;
+            gint64 nStartByte = pDataSource->pData.pVirtual.nOffset + (nStartFrame * nStorageFrameSize);
 
-            if (bFloat && pDataSource->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
+            if (pDataSource->bFloatStorage != bFloat && pDataSource->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE)
             {
-                gchar *lBytes = g_malloc(nFrames * nFrameSize);
+                gchar *lBytes = g_malloc(nFrames * nStorageFrameSize);
                 
-                if (file_Read(lBytes, nFrames * pDataSource->pAudioInfo->bpf, pDataSource->pData.pVirtual.pHandle))
+                if (file_ReadAt(pHandle, nStartByte, lBytes, nFrames * nStorageFrameSize))
                 {
+                    g_free(lBytes);
+
                     return 0;
                 }
-                
-                gstconverter_ConvertBuffer(lBuffer, lBytes, nFrames, pDataSource->pAudioInfo, FALSE);
+
+                if (bFloat)
+                {
+                    gstconverter_ConvertBuffer(lBuffer, lBytes, nFrames, pDataSource->pAudioInfo, FALSE);
+                }
+                else
+                {
+                    gstconverter_ConvertBuffer(lBytes, lBuffer, nFrames, pDataSource->pAudioInfo, TRUE);
+                }
+
                 g_free(lBytes);
             }
             else
             {
-                if (file_Read(lBuffer, nFrames * pDataSource->pAudioInfo->bpf, pDataSource->pData.pVirtual.pHandle))
+                if (file_ReadAt(pHandle, nStartByte, lBuffer, nFrames * nStorageFrameSize))
                 {
                     return 0;
                 }
             }
             
-            pDataSource->pData.pVirtual.nPos += nFrames * pDataSource->pAudioInfo->bpf;
-            
             return nFrames;
         }
         case DATASOURCE_GSTTEMP:
         {
-            guint nFramesRead = 0;
-            
-            if (bPlayer)
-            {
-                pDataSource->pData.pGstReader.nPosPlayer = nStartFrame;
-                nFramesRead = gstreader_Read(pDataSource->pData.pGstReader.pHandlePlayer, lBuffer, nStartFrame, nFrames, bFloat);
-
-                if (nFramesRead > 0)
-                {
-                    pDataSource->pData.pGstReader.nPosPlayer += nFramesRead;
-                }    
-            }
-            else
-            {
-                pDataSource->pData.pGstReader.nPosData = nStartFrame;
-                nFramesRead = gstreader_Read(pDataSource->pData.pGstReader.pHandleData, lBuffer, nStartFrame, nFrames, bFloat);
-
-                if (nFramesRead > 0)
-                {
-                    pDataSource->pData.pGstReader.nPosData += nFramesRead;
-                }                
-            }
+            // A GStreamer reader seeks its pipeline, so only one thread may use it at a time
+            g_mutex_lock(&pEntry->pMutex);
+            guint nFramesRead = gstreader_Read((GstReader*)pEntry->pHandle, lBuffer, nStartFrame, nFrames, bFloat);
+            g_mutex_unlock(&pEntry->pMutex);
             
             if (nFramesRead < nFrames)
             {
@@ -382,6 +584,86 @@ guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames
     }
 }
 
+static guint datasource_readAcquired(DataSource *pDataSource, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer)
+{
+    guint nResult = 0;
+    PoolEntry *pEntry;
+
+    if (!datasource_Acquire(pDataSource, bPlayer, &pEntry))
+    {
+        nResult = datasource_readMain(pDataSource, pEntry, nStartFrame, nFrames, lBuffer, bFloat, bPlayer);
+        datasource_Release(pEntry);
+    }
+
+    return nResult;
+}
+
+static guint datasource_readCached(DataSource *pDataSource, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bPlayer)
+{
+    if (nFrames > pDataSource->nFrames - nStartFrame)
+    {
+        nFrames = (guint)(pDataSource->nFrames - nStartFrame);
+    }
+
+    guint nFrameSize = pDataSource->pAudioInfo->channels * 4;
+    guint nFramesRead = 0;
+    gchar *lBlock = NULL;
+
+    while (nFramesRead < nFrames)
+    {
+        gint64 nFrame = nStartFrame + nFramesRead;
+        gint64 nBlock = nFrame / BLOCKCACHE_FRAMES;
+        guint nOffset = (guint)(nFrame % BLOCKCACHE_FRAMES);
+        guint nCount = MIN(BLOCKCACHE_FRAMES - nOffset, nFrames - nFramesRead);
+        gchar *lOut = lBuffer + (gsize)nFramesRead * nFrameSize;
+
+        if (!blockcache_Read(pDataSource, nBlock, nOffset, nCount, lOut))
+        {
+            guint nBlockFrames = (guint)MIN(BLOCKCACHE_FRAMES, pDataSource->nFrames - nBlock * BLOCKCACHE_FRAMES);
+
+            if (lBlock == NULL)
+            {
+                lBlock = g_malloc(BLOCKCACHE_FRAMES * nFrameSize);
+            }
+
+            if (datasource_readAcquired(pDataSource, nBlock * BLOCKCACHE_FRAMES, nBlockFrames, lBlock, TRUE, bPlayer) != nBlockFrames)
+            {
+                nFramesRead = 0;
+
+                break;
+            }
+
+            blockcache_Insert(pDataSource, nBlock, lBlock, nBlockFrames);
+            memcpy(lOut, lBlock + (gsize)nOffset * nFrameSize, (gsize)nCount * nFrameSize);
+        }
+
+        nFramesRead += nCount;
+    }
+
+    g_free(lBlock);
+
+    return nFramesRead;
+}
+
+guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer)
+{
+    gint64 nTraceStart = trace_Begin();
+    guint nResult;
+
+    if (bFloat && pDataSource->nType != DATASOURCE_SILENCE && !pDataSource->bFloatStorage && pDataSource->pAudioInfo->finfo->format != GST_AUDIO_FORMAT_F32LE && blockcache_Enabled())
+    {
+        nResult = datasource_readCached(pDataSource, nStartFrame, nFrames, lBuffer, bPlayer);
+    }
+    else
+    {
+        nResult = datasource_readAcquired(pDataSource, nStartFrame, nFrames, lBuffer, bFloat, bPlayer);
+    }
+
+    trace_End("datasource_Read", nTraceStart);
+
+    return nResult;
+}
+
 /*DataSource *datasource_NewSilent(GstAudioInfo *pAudioInfo, gint64 nFrames)
 {
     DataSource *pDataSource = datasource_new();
@@ -24,6 +24,7 @@
 
 #include "file.h"
 #include "gstreamer.h"
+#include "counters.h"
 
 #define OE_TYPE_DATASOURCE datasource_get_type()
 G_DECLARE_FINAL_TYPE(DataSource, datasource, OE, DATASOURCE, GObject)
@@ -42,6 +43,9 @@ struct _DataSource
     gint64 nBytes;
     guint nOpenCountData;
     guint nOpenCountPlayer;
+    gboolean bFloatStorage;
+    GList *lPoolLinkData;
+    GList *lPoolLinkPlayer;
 
     union
     {
@@ -49,8 +53,6 @@ struct _DataSource
         {
             gchar *sFilePath;
             gint64 nOffset;
-            File *pHandle;
-            gint64 nPos;
 
         } pVirtual;
 
@@ -60,10 +62,6 @@ struct _DataSource
         {
             gchar *sFilePath;
             gchar *sTempFilePath;
-            GstReader *pHandleData;
-            GstReader *pHandlePlayer;
-            gint64 nPosData;
-            gint64 nPosPlayer;
 
         } pGstReader;
         
@@ -76,5 +74,6 @@ gboolean datasource_Open(DataSource *pDataSource, gboolean bPlayer);
 void datasource_Close(DataSource *pDataSource, gboolean bPlayer);
 guint datasource_Read(DataSource *pDataSource, gint64 nStartFrame, guint nFrames, gchar *lBuffer, gboolean bFloat, gboolean bPlayer);
 guint datasource_Count();
+void datasource_GetUsage(CountersSnapshot *pSnapshot);
 
 #endif
@@ -23,6 +23,9 @@
 #include "document.h"
 #include "player.h"
 #include "main.h"
+#include "mainwindow.h"
+#include "tempfile.h"
+#include "scratch.h"
 
 G_DEFINE_TYPE(Document, document, G_TYPE_OBJECT)
 
@@ -32,6 +35,24 @@ static void document_SetCursorMain(Document *pDocument, gint64 nCursorPos, gbool
 static guint m_lDocumentSignals[LAST_SIGNAL] = {0};
 static guint m_nUntitledCount = 0;
 
+#define DOCUMENT_CONSOLIDATE_PARTS 64
+#define DOCUMENT_CONSOLIDATE_SOURCES 16
+#define DOCUMENT_GROW_SECONDS 30
+
+typedef struct
+{
+    Document *pDocument;
+    Chunk *pChunk;
+    ChunkHandle *pChunkHandle;
+    TempFile *pTempFile;
+    gint64 nFramesPos;
+    gchar *lBuffer;
+
+} Consolidation;
+
+static Consolidation *m_pConsolidation = NULL;
+static Chunk *m_pConsolidationFailed = NULL;
+
 GList *g_lDocuments = NULL;
 Document *g_pPlayingDocument = NULL;
 
@@ -60,11 +81,30 @@ static void document_ClearHistory(struct HistoryEntry *pHistoryEntry)
     }
 }
 
+static void document_ConsolidateEnd(gboolean bAbort)
+{
+    if (bAbort)
+    {
+        tempfile_Abort(m_pConsolidation->pTempFile);
+    }
+
+    chunk_Close(m_pConsolidation->pChunkHandle, FALSE);
+    g_object_unref(m_pConsolidation->pChunk);
+    g_free(m_pConsolidation->lBuffer);
+    g_free(m_pConsolidation);
+    m_pConsolidation = NULL;
+}
+
 static void document_OnDispose(GObject *pObject)
 {
     g_info("document_destroy");
     Document *pDocument = OE_DOCUMENT(pObject);
 
+    if (m_pConsolidation != NULL && m_pConsolidation->pDocument == pDocument)
+    {
+        document_ConsolidateEnd(TRUE);
+    }
+
     if (pDocument->sFilePath != NULL)
     {
         g_free(pDocument->sFilePath);
@@ -113,6 +153,16 @@ static void document_init(Document *pDocument)
     pDocument->nCursorPos = 0;
 }
 
+static Progress *document_GetProgress(Document *pDocument)
+{
+    if (pDocument->pMainWindow == NULL)
+    {
+        return NULL;
+    }
+
+    return &pDocument->pMainWindow->cProgress;
+}
+
 static Document *document_new()
 {
     g_info("document_new");
@@ -121,7 +171,7 @@ static Document *document_new()
 
 Document *document_NewWithFile(gchar *sFilePath, struct _MainWindow *pMainWindow)
 {
-    Chunk *pChunk = chunk_Load(sFilePath, pMainWindow);
+    Chunk *pChunk = chunk_Load(sFilePath, pMainWindow ? &pMainWindow->cProgress : NULL);
 
     if (pChunk == NULL)
     {
@@ -215,7 +265,7 @@ Document *document_NewWithChunk(Chunk *pChunk, gchar *sSourceName, struct _MainW
 
 gboolean document_Save(Document *pDocument, gchar *sFilePath)
 {
-    gboolean bError = chunk_Save(pDocument->pChunk, sFilePath, pDocument->pMainWindow);
+    gboolean bError = chunk_Save(pDocument->pChunk, sFilePath, document_GetProgress(pDocument));
 
     if (!bError)
     {
@@ -228,7 +278,7 @@ gboolean document_Save(Document *pDocument, gchar *sFilePath)
     return bError;
 }
 
-static void document_OnCursorChanged(gint nPos, gboolean bIsRunning)
+static void document_OnCursorChanged(gint64 nPos, gboolean bIsRunning)
 {
     Document *pDocument = g_pPlayingDocument;
 
@@ -274,7 +324,7 @@ void document_Play(Document *pDocument, gint64 nStart, gint64 nEnd)
         g_info("document_ref, document:document_Play %p", pDocument);
         g_object_ref(pDocument);
 
-        if (player_Play(pDocument->pChunk, nStart, nEnd, document_OnCursorChanged))
+        if (player_Play(pDocument->pChunk, nStart, nEnd, document_OnCursorChanged, NULL))
         {
             g_pPlayingDocument = NULL;
             g_info("document_unref, document:document_Play %p", pDocument);
@@ -283,6 +333,56 @@ void document_Play(Document *pDocument, gint64 nStart, gint64 nEnd)
     }
 }
 
+void document_PlayPreview(Document *pDocument, PlayerPreview *pPreview)
+{
+    g_assert(pDocument != NULL);
+
+    player_Stop();
+
+    g_assert(g_pPlayingDocument == NULL);
+
+    g_pPlayingDocument = pDocument;
+    g_info("document_ref, document:document_PlayPreview %p", pDocument);
+    g_object_ref(pDocument);
+
+    if (player_Play(pDocument->pChunk, pPreview->nStart, pPreview->nStart + pPreview->nFrames, document_OnCursorChanged, pPreview))
+    {
+        g_pPlayingDocument = NULL;
+        g_info("document_unref, document:document_PlayPreview %p", pDocument);
+        g_object_unref(pDocument);
+    }
+}
+
+void document_Scrub(Document *pDocument, gint64 nPos)
+{
+    g_assert(pDocument != NULL);
+
+    player_Stop();
+
+    g_assert(g_pPlayingDocument == NULL);
+
+    g_pPlayingDocument = pDocument;
+    g_info("document_ref, document:document_Scrub %p", pDocument);
+    g_object_ref(pDocument);
+
+    if (player_Scrub(pDocument->pChunk, nPos, document_OnCursorChanged))
+    {
+        g_pPlayingDocument = NULL;
+        g_info("document_unref, document:document_Scrub %p", pDocument);
+        g_object_unref(pDocument);
+    }
+}
+
+void document_ScrubTo(Document *pDocument, gint64 nPos)
+{
+    g_assert(pDocument != NULL);
+
+    if (g_pPlayingDocument == pDocument && player_Playing())
+    {
+        player_ScrubTo(nPos);
+    }
+}
+
 void document_PlaySelection(Document *pDocument)
 {
     g_assert(pDocument != NULL);
@@ -440,7 +540,7 @@ gboolean document_ApplyChunkFunc(Document *pDocument, ChunkFunc pChunkFunc)
 {
     if ((pDocument->nSelStart == pDocument->nSelEnd) || (pDocument->nSelStart == 0 && pDocument->nSelEnd >= pDocument->pChunk->nFrames))
     {
-        Chunk *pChunk = pChunkFunc(pDocument->pChunk, pDocument->pMainWindow);
+        Chunk *pChunk = pChunkFunc(pDocument->pChunk, document_GetProgress(pDocument));
 
         if (pChunk)
         {
@@ -457,7 +557,7 @@ gboolean document_ApplyChunkFunc(Document *pDocument, ChunkFunc pChunkFunc)
     {
         Chunk *pChunkPart = chunk_GetPart(pDocument->pChunk, pDocument->nSelStart, pDocument->nSelEnd - pDocument->nSelStart);        
         gint64 nPartFrames = pChunkPart->nFrames;
-        Chunk *pChunkApplied = pChunkFunc(pChunkPart, pDocument->pMainWindow);
+        Chunk *pChunkApplied = pChunkFunc(pChunkPart, document_GetProgress(pDocument));
         g_object_unref(pChunkPart);
                 
         if (pChunkApplied)
@@ -712,3 +812,204 @@ void document_SetMainWindow(Document *pDocument, struct _MainWindow *pMainWindow
 {
     pDocument->pMainWindow = pMainWindow;
 }
+
+// Weak, so a freed chunk whose address gets reused is not mistaken for the one that failed
+
+static void document_SetConsolidationFailed(Chunk *pChunk)
+{
+    if (m_pConsolidationFailed != NULL)
+    {
+        g_object_remove_weak_pointer(G_OBJECT(m_pConsolidationFailed), (gpointer*)&m_pConsolidationFailed);
+    }
+
+    m_pConsolidationFailed = pChunk;
+    g_object_add_weak_pointer(G_OBJECT(m_pConsolidationFailed), (gpointer*)&m_pConsolidationFailed);
+}
+
+static gboolean document_NeedsConsolidation(Chunk *pChunk)
+{
+    if (pChunk == NULL || pChunk == m_pConsolidationFailed || pChunk->lParts == NULL || pChunk->lParts->next == NULL)
+    {
+        return FALSE;
+    }
+
+    if (g_list_length(pChunk->lParts) > DOCUMENT_CONSOLIDATE_PARTS)
+    {
+        return TRUE;
+    }
+
+    GHashTable *lSources = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    for (GList *l = pChunk->lParts; l != NULL; l = l->next)
+    {
+        DataPart *pDataPart = (DataPart *)l->data;
+        g_hash_table_add(lSources, pDataPart->pDataSource);
+    }
+
+    gboolean bNeeded = (g_hash_table_size(lSources) > DOCUMENT_CONSOLIDATE_SOURCES);
+    g_hash_table_destroy(lSources);
+
+    return bNeeded;
+}
+
+static void document_ReplaceChunk(Document *pDocument, Chunk *pChunkOld, Chunk *pChunkNew)
+{
+    struct HistoryEntry *pHistoryEntry = pDocument->pHistoryEntry;
+
+    while (pHistoryEntry != NULL && pHistoryEntry->pHistoryEntryPrev != NULL)
+    {
+        pHistoryEntry = pHistoryEntry->pHistoryEntryPrev;
+    }
+
+    for (; pHistoryEntry != NULL; pHistoryEntry = pHistoryEntry->pHistoryEntryNext)
+    {
+        if (pHistoryEntry->pChunk == pChunkOld)
+        {
+            g_object_ref(pChunkNew);
+            g_object_unref(pHistoryEntry->pChunk);
+            pHistoryEntry->pChunk = pChunkNew;
+        }
+    }
+
+    g_info("chunk_unref: %d, document:document_ReplaceChunk %p", chunk_AliveCount(), pDocument->pChunk);
+    g_object_unref(pDocument->pChunk);
+    pDocument->pChunk = pChunkNew;
+
+    if (g_pPlayingDocument == pDocument && player_Playing())
+    {
+        player_Switch(pChunkNew, 0, 0);
+    }
+
+    g_signal_emit(pDocument, m_lDocumentSignals[STATE_CHANGED_SIGNAL], 0);
+}
+
+void document_Grow(Document *pDocument, Chunk *pChunkOld, Chunk *pChunkNew)
+{
+    // Edited since the last take, leave the edit alone
+    if (pDocument->pChunk != pChunkOld)
+    {
+        g_info("chunk_unref: %d, document:document_Grow %p", chunk_AliveCount(), pChunkNew);
+        g_object_unref(pChunkNew);
+
+        return;
+    }
+
+    // Follow the end while it is in view: widen up to DOCUMENT_GROW_SECONDS, then scroll
+    if (pDocument->nViewEnd == pChunkOld->nFrames)
+    {
+        gint64 nViewFrames = MAX(pDocument->nViewEnd - pDocument->nViewStart, MIN(pChunkNew->nFrames, (gint64)pChunkNew->pAudioInfo->rate * DOCUMENT_GROW_SECONDS));
+        pDocument->nViewEnd = pChunkNew->nFrames;
+        pDocument->nViewStart = MAX(0, pDocument->nViewEnd - nViewFrames);
+    }
+
+    document_ReplaceChunk(pDocument, pChunkOld, pChunkNew);
+}
+
+gboolean document_Consolidate()
+{
+    if (m_pConsolidation == NULL)
+    {
+        Document *pDocument = NULL;
+
+        for (GList *l = g_lDocuments; l != NULL; l = l->next)
+        {
+            if (document_NeedsConsolidation(OE_DOCUMENT(l->data)->pChunk))
+            {
+                pDocument = OE_DOCUMENT(l->data);
+
+                break;
+            }
+        }
+
+        if (pDocument == NULL)
+        {
+            return FALSE;
+        }
+
+        Chunk *pChunk = pDocument->pChunk;
+
+        if (!scratch_HasRoom(pChunk->nBytes))
+        {
+            document_SetConsolidationFailed(pChunk);
+
+            return FALSE;
+        }
+
+        ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
+        // Always the native format, so a consolidated chunk holds exactly the samples of the parts it replaces
+        TempFile *pTempFile = pChunkHandle ? tempfile_Init(pChunk->pAudioInfo, pChunk->nBytes) : NULL;
+
+        if (pTempFile == NULL)
+        {
+            if (pChunkHandle != NULL)
+            {
+                chunk_Close(pChunkHandle, FALSE);
+            }
+
+            document_SetConsolidationFailed(pChunk);
+
+            return FALSE;
+        }
+
+        g_info("document_Consolidate: %s, %u parts", pDocument->sTitleName, g_list_length(pChunk->lParts));
+        m_pConsolidation = g_malloc(sizeof(Consolidation));
+        m_pConsolidation->pDocument = pDocument;
+        m_pConsolidation->pChunk = g_object_ref(pChunk);
+        m_pConsolidation->pChunkHandle = pChunkHandle;
+        m_pConsolidation->pTempFile = pTempFile;
+        m_pConsolidation->nFramesPos = 0;
+        m_pConsolidation->lBuffer = g_malloc(BUFFER_SIZE);
+
+        return TRUE;
+    }
+
+    Document *pDocument = m_pConsolidation->pDocument;
+    Chunk *pChunk = m_pConsolidation->pChunk;
+
+    if (pDocument->pChunk != pChunk)
+    {
+        document_ConsolidateEnd(TRUE);
+
+        return TRUE;
+    }
+
+    if (m_pConsolidation->nFramesPos < pChunk->nFrames)
+    {
+        TempFile *pTempFile = m_pConsolidation->pTempFile;
+        guint nFrameSize = pTempFile->pStorageInfo->bpf;
+        guint nFrames = MIN(BUFFER_SIZE / nFrameSize, pChunk->nFrames - m_pConsolidation->nFramesPos);
+        guint nFramesRead = chunk_Read(m_pConsolidation->pChunkHandle, m_pConsolidation->nFramesPos, nFrames, m_pConsolidation->lBuffer, pTempFile->bFloat, FALSE);
+
+        if (nFramesRead == 0 || tempfile_Write(pTempFile, m_pConsolidation->lBuffer, nFramesRead * nFrameSize))
+        {
+            document_SetConsolidationFailed(pChunk);
+            document_ConsolidateEnd(TRUE);
+
+            return TRUE;
+        }
+
+        m_pConsolidation->nFramesPos += nFramesRead;
+
+        return TRUE;
+    }
+
+    Chunk *pChunkNew = tempfile_Finished(m_pConsolidation->pTempFile);
+
+    if (pChunkNew == NULL || pChunkNew->nFrames != pChunk->nFrames)
+    {
+        if (pChunkNew != NULL)
+        {
+            g_object_unref(pChunkNew);
+        }
+
+        document_SetConsolidationFailed(pChunk);
+        document_ConsolidateEnd(FALSE);
+
+        return TRUE;
+    }
+
+    document_ConsolidateEnd(FALSE);
+    document_ReplaceChunk(pDocument, pChunk, pChunkNew);
+
+    return TRUE;
+}
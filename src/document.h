@@ -23,6 +23,7 @@
 #define DOCUMENT_H_INCLUDED
 
 #include "chunk.h"
+#include "player.h"
 
 #define OE_TYPE_DOCUMENT document_get_type()
 G_DECLARE_FINAL_TYPE(Document, document, OE, DOCUMENT, GObject)
@@ -65,15 +66,19 @@ struct HistoryEntry
 extern GList *g_lDocuments;
 extern Document *g_pPlayingDocument;
 
-typedef Chunk *(*ChunkFunc)(Chunk *pChunk, struct _MainWindow *pMainWindow);
+typedef Chunk *(*ChunkFunc)(Chunk *pChunk, Progress *pProgress);
 Document *document_NewWithFile(gchar *sFilePath, struct _MainWindow *pMainWindow);
 Document *document_NewWithChunk(Chunk *pChunk, gchar *sSourceName, struct _MainWindow *pMainWindow);
 void document_SetMainWindow(Document *pDocument, struct _MainWindow *pMainWindow);
 gboolean document_Save(Document *pDocument, gchar *sFilePath);
 void document_Play(Document *pDocument, gint64 nStart, gint64 nEnd);
 void document_PlaySelection(Document *pDocument);
+void document_PlayPreview(Document *pDocument, PlayerPreview *pPreview);
+void document_Scrub(Document *pDocument, gint64 nPos);
+void document_ScrubTo(Document *pDocument, gint64 nPos);
 void document_Stop(Document *pDocument);
 void document_Update(Document *pDocument, Chunk *pChunk, gint64 nMoveStart, gint64 nMoveDist);
+void document_Grow(Document *pDocument, Chunk *pChunkOld, Chunk *pChunkNew);
 gboolean document_ApplyChunkFunc(Document *pDocument, ChunkFunc pChunkFunc);
 void document_SetFollowMode(Document *pDocument, gboolean bFollowMode);
 void document_SetCursor(Document *pDocument, gint64 nCursorPos);
@@ -85,5 +90,6 @@ gboolean document_CanUndo(Document *pDocument);
 void document_Undo(Document *pDocument);
 gboolean document_CanRedo(Document *pDocument);
 void document_Redo(Document *pDocument);
+gboolean document_Consolidate();
 
 #endif
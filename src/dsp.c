@@ -0,0 +1,183 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <math.h>
+#include "dsp.h"
+
+// Offline rendering and the playback preview both go through these, so what is auditioned is what gets written
+
+void dsp_Fade(gfloat *lFrames, guint nFrames, guint nChannels, gfloat fStartFactor, gfloat fEndFactor, gint64 nFrameOffset, gint64 nTotalFrames)
+{
+    for (guint nFrame = 0; nFrame < nFrames; nFrame++)
+    {
+        gfloat fFactor = fStartFactor + ((fEndFactor - fStartFactor) * ((gfloat)(nFrameOffset + nFrame) / (gfloat)nTotalFrames));
+
+        for (guint nChannel = 0; nChannel < nChannels; nChannel++)
+        {
+            lFrames[nFrame * nChannels + nChannel] *= fFactor;
+        }
+    }
+}
+
+void dsp_Accumulate(gfloat *lOut, const gfloat *lIn, gfloat fGain, guint nSamples)
+{
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        lOut[nSample] += lIn[nSample] * fGain;
+    }
+}
+
+void dsp_Clip(gfloat *lSamples, guint nSamples)
+{
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        lSamples[nSample] = CLAMP(lSamples[nSample], -1.0f, 1.0f);
+    }
+}
+
+// Unity below the knee, then a tanh curve that meets it with the same slope and never quite reaches full scale
+
+void dsp_SoftLimit(gfloat *lSamples, guint nSamples)
+{
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        gfloat fLevel = fabsf(lSamples[nSample]);
+
+        if (fLevel > DSP_SOFT_KNEE)
+        {
+            fLevel = DSP_SOFT_KNEE + (1.0f - DSP_SOFT_KNEE) * tanhf((fLevel - DSP_SOFT_KNEE) / (1.0f - DSP_SOFT_KNEE));
+            lSamples[nSample] = copysignf(fLevel, lSamples[nSample]);
+        }
+    }
+}
+
+void dsp_Deinterleave(const gfloat *lFrames, guint nFrames, guint nChannels, guint nChannel, gfloat *lOut)
+{
+    for (guint nFrame = 0; nFrame < nFrames; nFrame++)
+    {
+        lOut[nFrame] = lFrames[nFrame * nChannels + nChannel];
+    }
+}
+
+// The reductions below keep DSP_LANES independent accumulators so the compiler can vectorise them without reassociating floats
+
+gfloat dsp_Peak(const gfloat *lSamples, guint nSamples)
+{
+    gfloat lPeak[DSP_LANES] = {0};
+    guint nSample = 0;
+
+    for (; nSample + DSP_LANES <= nSamples; nSample += DSP_LANES)
+    {
+        for (guint nLane = 0; nLane < DSP_LANES; nLane++)
+        {
+            gfloat fSample = fabsf(lSamples[nSample + nLane]);
+            lPeak[nLane] = (fSample > lPeak[nLane]) ? fSample : lPeak[nLane];
+        }
+    }
+
+    for (; nSample < nSamples; nSample++)
+    {
+        gfloat fSample = fabsf(lSamples[nSample]);
+        lPeak[0] = (fSample > lPeak[0]) ? fSample : lPeak[0];
+    }
+
+    gfloat fPeak = 0;
+
+    for (guint nLane = 0; nLane < DSP_LANES; nLane++)
+    {
+        fPeak = MAX(fPeak, lPeak[nLane]);
+    }
+
+    return fPeak;
+}
+
+void dsp_Sums(const gfloat *lSamples, guint nSamples, gdouble *fSum, gdouble *fSquares)
+{
+    gfloat lSum[DSP_LANES] = {0};
+    gfloat lSquares[DSP_LANES] = {0};
+    guint nSample = 0;
+
+    for (; nSample + DSP_LANES <= nSamples; nSample += DSP_LANES)
+    {
+        for (guint nLane = 0; nLane < DSP_LANES; nLane++)
+        {
+            gfloat fSample = lSamples[nSample + nLane];
+            lSum[nLane] += fSample;
+            lSquares[nLane] += fSample * fSample;
+        }
+    }
+
+    for (; nSample < nSamples; nSample++)
+    {
+        lSum[0] += lSamples[nSample];
+        lSquares[0] += lSamples[nSample] * lSamples[nSample];
+    }
+
+    for (guint nLane = 0; nLane < DSP_LANES; nLane++)
+    {
+        *fSum += lSum[nLane];
+        *fSquares += lSquares[nLane];
+    }
+}
+
+void dsp_Biquad(DspBiquad *pBiquad, const gfloat *lIn, gfloat *lOut, guint nSamples)
+{
+    gdouble fZ1 = pBiquad->fZ1;
+    gdouble fZ2 = pBiquad->fZ2;
+
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        gdouble fIn = lIn[nSample];
+        gdouble fOut = pBiquad->fB0 * fIn + fZ1;
+        fZ1 = pBiquad->fB1 * fIn - pBiquad->fA1 * fOut + fZ2;
+        fZ2 = pBiquad->fB2 * fIn - pBiquad->fA2 * fOut;
+        lOut[nSample] = (gfloat)fOut;
+    }
+
+    pBiquad->fZ1 = fZ1;
+    pBiquad->fZ2 = fZ2;
+}
+
+// lSamples must be preceded by nTaps - 1 samples of history, lTaps holds nTaps coefficients per phase
+
+gfloat dsp_InterpolatedPeak(const gfloat *lSamples, guint nSamples, const gfloat *lTaps, guint nTaps, guint nPhases)
+{
+    gfloat fPeak = 0;
+
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        const gfloat *lHistory = lSamples + nSample - (nTaps - 1);
+
+        for (guint nPhase = 0; nPhase < nPhases; nPhase++)
+        {
+            const gfloat *lPhase = lTaps + nPhase * nTaps;
+            gfloat fOut = 0;
+
+            for (guint nTap = 0; nTap < nTaps; nTap++)
+            {
+                fOut += lPhase[nTap] * lHistory[nTap];
+            }
+
+            fPeak = MAX(fPeak, fabsf(fOut));
+        }
+    }
+
+    return fPeak;
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef DSP_H_INCLUDED
+#define DSP_H_INCLUDED
+
+#include <glib.h>
+
+#define DSP_LANES 8
+#define DSP_SOFT_KNEE 0.9f
+
+typedef struct
+{
+    gdouble fB0;
+    gdouble fB1;
+    gdouble fB2;
+    gdouble fA1;
+    gdouble fA2;
+    gdouble fZ1;
+    gdouble fZ2;
+
+} DspBiquad;
+
+void dsp_Fade(gfloat *lFrames, guint nFrames, guint nChannels, gfloat fStartFactor, gfloat fEndFactor, gint64 nFrameOffset, gint64 nTotalFrames);
+void dsp_Accumulate(gfloat *lOut, const gfloat *lIn, gfloat fGain, guint nSamples);
+void dsp_Clip(gfloat *lSamples, guint nSamples);
+void dsp_SoftLimit(gfloat *lSamples, guint nSamples);
+void dsp_Deinterleave(const gfloat *lFrames, guint nFrames, guint nChannels, guint nChannel, gfloat *lOut);
+gfloat dsp_Peak(const gfloat *lSamples, guint nSamples);
+void dsp_Sums(const gfloat *lSamples, guint nSamples, gdouble *fSum, gdouble *fSquares);
+void dsp_Biquad(DspBiquad *pBiquad, const gfloat *lIn, gfloat *lOut, guint nSamples);
+gfloat dsp_InterpolatedPeak(const gfloat *lSamples, guint nSamples, const gfloat *lTaps, guint nTaps, guint nPhases);
+
+#endif
@@ -0,0 +1,1206 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <glib/gi18n.h>
+#include <string.h>
+#include "export.h"
+#include "file.h"
+#include "message.h"
+#include "main.h"
+#include "trace.h"
+
+#define FLAC_BLOCK_SIZE 4096
+#define FLAC_SEGMENT_BLOCKS 32
+#define FLAC_MAX_ORDER 4
+#define FLAC_MAX_PARTITION_ORDER 8
+#define FLAC_STREAMINFO_SIZE 34
+#define EXPORT_BLOCK_FRAMES 65536
+#define EXPORT_IO_BUDGET (64 * 1024 * 1024)
+
+typedef struct
+{
+    const gchar *sExtension;
+    const gchar *sEncoder;
+
+} ExportFormat;
+
+static const ExportFormat EXPORT_FORMATS[] =
+{
+    {".wav", "wavenc"},
+    {".flac", "audioconvert ! flacenc"},
+    {".ogg", "audioconvert ! vorbisenc ! oggmux"},
+    {".oga", "audioconvert ! vorbisenc ! oggmux"},
+    {".opus", "audioconvert ! audioresample ! opusenc ! oggmux"},
+    {".mp3", "audioconvert ! lamemp3enc"}
+};
+
+typedef struct
+{
+    guint8 *lData;
+    gsize nSize;
+    gsize nAlloc;
+    guint64 nAccumulator;
+    guint nBits;
+
+} BitWriter;
+
+typedef struct
+{
+    guint nType;
+    guint nOrder;
+    guint nPartitionOrder;
+    guint lParameters[1 << FLAC_MAX_PARTITION_ORDER];
+    guint64 nBits;
+    gint32 *lResidual;
+
+} Subframe;
+
+typedef struct
+{
+    guint nChannels;
+    guint nBits;
+    guint nRate;
+    gboolean bCancel;
+    GMutex pMutex;
+    GCond pCond;
+
+} FlacStream;
+
+typedef struct
+{
+    FlacStream *pStream;
+    gint32 *lSamples;
+    guint nFrames;
+    guint64 nFrameNumber;
+    BitWriter cOutput;
+    guint nMinFrameSize;
+    guint nMaxFrameSize;
+    gboolean bDone;
+
+} FlacJob;
+
+typedef struct
+{
+    guint nFrames;
+    gboolean bLast;
+    gchar *lBytes;
+
+} ExportBlock;
+
+typedef struct
+{
+    GMutex pMutex;
+    GCond pCond;
+    gsize nBudget;
+    gboolean bCancel;
+    gint64 nFramesWritten;
+    guint nDone;
+
+} ExportShared;
+
+typedef struct
+{
+    ExportShared *pShared;
+    ExportRegion *pRegion;
+    GstAudioInfo *pAudioInfo;
+    GAsyncQueue *pQueue;
+    gint64 nFramesRead;
+    gboolean bComplete;
+    gchar *sError;
+
+} ExportJob;
+
+static guint8 m_lCrc8[256];
+static guint16 m_lCrc16[256];
+
+static void export_InitCrc()
+{
+    static gsize nInit = 0;
+
+    if (g_once_init_enter(&nInit))
+    {
+        for (guint nByte = 0; nByte < 256; nByte++)
+        {
+            guint nCrc8 = nByte;
+            guint nCrc16 = nByte << 8;
+
+            for (guint nBit = 0; nBit < 8; nBit++)
+            {
+                nCrc8 = (nCrc8 & 0x80) ? (nCrc8 << 1) ^ 0x07 : nCrc8 << 1;
+                nCrc16 = (nCrc16 & 0x8000) ? (nCrc16 << 1) ^ 0x8005 : nCrc16 << 1;
+            }
+
+            m_lCrc8[nByte] = nCrc8 & 0xFF;
+            m_lCrc16[nByte] = nCrc16 & 0xFFFF;
+        }
+
+        g_once_init_leave(&nInit, 1);
+    }
+}
+
+static guint8 export_Crc8(const guint8 *lData, gsize nSize)
+{
+    guint8 nCrc = 0;
+
+    for (gsize nByte = 0; nByte < nSize; nByte++)
+    {
+        nCrc = m_lCrc8[nCrc ^ lData[nByte]];
+    }
+
+    return nCrc;
+}
+
+static guint16 export_Crc16(const guint8 *lData, gsize nSize)
+{
+    guint16 nCrc = 0;
+
+    for (gsize nByte = 0; nByte < nSize; nByte++)
+    {
+        nCrc = ((nCrc << 8) ^ m_lCrc16[(nCrc >> 8) ^ lData[nByte]]) & 0xFFFF;
+    }
+
+    return nCrc;
+}
+
+static void bitwriter_Put(BitWriter *pWriter, guint32 nValue, guint nBits)
+{
+    if (nBits == 0)
+    {
+        return;
+    }
+
+    if (pWriter->nSize + 8 > pWriter->nAlloc)
+    {
+        pWriter->nAlloc = MAX(pWriter->nAlloc * 2, 65536);
+        pWriter->lData = g_realloc(pWriter->lData, pWriter->nAlloc);
+    }
+
+    guint64 nMask = (nBits == 32) ? 0xFFFFFFFF : ((1u << nBits) - 1);
+    pWriter->nAccumulator = (pWriter->nAccumulator << nBits) | (nValue & nMask);
+    pWriter->nBits += nBits;
+
+    while (pWriter->nBits >= 8)
+    {
+        pWriter->nBits -= 8;
+        pWriter->lData[pWriter->nSize++] = (pWriter->nAccumulator >> pWriter->nBits) & 0xFF;
+    }
+}
+
+static void bitwriter_PutUnary(BitWriter *pWriter, guint32 nZeros)
+{
+    while (nZeros >= 32)
+    {
+        bitwriter_Put(pWriter, 0, 32);
+        nZeros -= 32;
+    }
+
+    bitwriter_Put(pWriter, 1, nZeros + 1);
+}
+
+static void bitwriter_Align(BitWriter *pWriter)
+{
+    if (pWriter->nBits)
+    {
+        bitwriter_Put(pWriter, 0, 8 - pWriter->nBits);
+    }
+}
+
+static void bitwriter_PutUtf8(BitWriter *pWriter, guint64 nValue)
+{
+    if (nValue < 0x80)
+    {
+        bitwriter_Put(pWriter, nValue, 8);
+
+        return;
+    }
+
+    guint nBytes = nValue < 0x800 ? 2 : nValue < 0x10000 ? 3 : nValue < 0x200000 ? 4 : nValue < 0x4000000 ? 5 : nValue < 0x80000000 ? 6 : 7;
+    bitwriter_Put(pWriter, ((0xFF00 >> nBytes) & 0xFF) | (nValue >> (6 * (nBytes - 1))), 8);
+
+    for (gint nByte = nBytes - 2; nByte >= 0; nByte--)
+    {
+        bitwriter_Put(pWriter, 0x80 | ((nValue >> (6 * nByte)) & 0x3F), 8);
+    }
+}
+
+static inline guint32 export_Fold(gint32 nResidual)
+{
+    return ((guint32)nResidual << 1) ^ (guint32)(nResidual >> 31);
+}
+
+static void export_GetResidual(const gint32 *lSamples, guint nFrames, guint nOrder, gint32 *lResidual)
+{
+    for (guint nFrame = nOrder; nFrame < nFrames; nFrame++)
+    {
+        const gint32 *x = lSamples + nFrame;
+
+        switch (nOrder)
+        {
+            case 0:
+                lResidual[nFrame] = x[0];
+                break;
+            case 1:
+                lResidual[nFrame] = x[0] - x[-1];
+                break;
+            case 2:
+                lResidual[nFrame] = x[0] - 2 * x[-1] + x[-2];
+                break;
+            case 3:
+                lResidual[nFrame] = x[0] - 3 * x[-1] + 3 * x[-2] - x[-3];
+                break;
+            default:
+                lResidual[nFrame] = x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4];
+                break;
+        }
+    }
+}
+
+static guint export_GetRiceParameter(const gint32 *lResidual, guint nCount, guint64 *nBits)
+{
+    guint64 nSum = 0;
+
+    for (guint nIndex = 0; nIndex < nCount; nIndex++)
+    {
+        nSum += export_Fold(lResidual[nIndex]);
+    }
+
+    guint nParameter = 0;
+
+    while (nParameter < 30 && ((guint64)nCount << (nParameter + 1)) < nSum)
+    {
+        nParameter++;
+    }
+
+    *nBits = (guint64)nCount * (nParameter + 1) + (nSum >> nParameter);
+
+    return nParameter;
+}
+
+static guint64 export_PlanResidual(Subframe *pSubframe, guint nFrames)
+{
+    guint64 nBest = G_MAXUINT64;
+    guint lParameters[1 << FLAC_MAX_PARTITION_ORDER];
+
+    for (guint nPartitionOrder = 0; nPartitionOrder <= FLAC_MAX_PARTITION_ORDER; nPartitionOrder++)
+    {
+        guint nPartitions = 1 << nPartitionOrder;
+        guint nPartitionSize = nFrames >> nPartitionOrder;
+
+        if (nFrames % nPartitions || nPartitionSize <= pSubframe->nOrder)
+        {
+            break;
+        }
+
+        guint64 nTotal = 6;
+        gboolean bRice2 = FALSE;
+
+        for (guint nPartition = 0; nPartition < nPartitions; nPartition++)
+        {
+            guint nStart = nPartition ? nPartition * nPartitionSize : pSubframe->nOrder;
+            guint64 nBits;
+            lParameters[nPartition] = export_GetRiceParameter(pSubframe->lResidual + nStart, (nPartition + 1) * nPartitionSize - nStart, &nBits);
+            bRice2 |= lParameters[nPartition] > 14;
+            nTotal += nBits;
+        }
+
+        nTotal += (guint64)nPartitions * (bRice2 ? 5 : 4);
+
+        if (nTotal < nBest)
+        {
+            nBest = nTotal;
+            pSubframe->nPartitionOrder = nPartitionOrder;
+            memcpy(pSubframe->lParameters, lParameters, nPartitions * sizeof(guint));
+        }
+    }
+
+    return nBest;
+}
+
+static void export_PlanSubframe(const gint32 *lSamples, guint nFrames, guint nBits, Subframe *pSubframe)
+{
+    gboolean bConstant = TRUE;
+
+    for (guint nFrame = 1; nFrame < nFrames && bConstant; nFrame++)
+    {
+        bConstant = lSamples[nFrame] == lSamples[0];
+    }
+
+    if (bConstant)
+    {
+        pSubframe->nType = 0;
+        pSubframe->nBits = 8 + nBits;
+
+        return;
+    }
+
+    pSubframe->nType = 1;
+    pSubframe->nBits = 8 + (guint64)nFrames * nBits;
+
+    guint nOrderBest = 0;
+    guint64 nSumBest = G_MAXUINT64;
+
+    for (guint nOrder = 0; nOrder <= FLAC_MAX_ORDER && nOrder < nFrames; nOrder++)
+    {
+        export_GetResidual(lSamples, nFrames, nOrder, pSubframe->lResidual);
+        guint64 nSum = 0;
+
+        for (guint nFrame = nOrder; nFrame < nFrames; nFrame++)
+        {
+            nSum += export_Fold(pSubframe->lResidual[nFrame]);
+        }
+
+        if (nSum < nSumBest)
+        {
+            nSumBest = nSum;
+            nOrderBest = nOrder;
+        }
+    }
+
+    Subframe cFixed = {.nOrder = nOrderBest, .lResidual = pSubframe->lResidual};
+    export_GetResidual(lSamples, nFrames, nOrderBest, cFixed.lResidual);
+    guint64 nResidualBits = export_PlanResidual(&cFixed, nFrames);
+
+    if (nResidualBits != G_MAXUINT64 && 8 + nOrderBest * nBits + nResidualBits < pSubframe->nBits)
+    {
+        pSubframe->nType = 8;
+        pSubframe->nOrder = nOrderBest;
+        pSubframe->nPartitionOrder = cFixed.nPartitionOrder;
+        memcpy(pSubframe->lParameters, cFixed.lParameters, sizeof(cFixed.lParameters));
+        pSubframe->nBits = 8 + nOrderBest * nBits + nResidualBits;
+    }
+}
+
+static void export_WriteSubframe(BitWriter *pWriter, const gint32 *lSamples, guint nFrames, guint nBits, Subframe *pSubframe)
+{
+    bitwriter_Put(pWriter, (pSubframe->nType == 8) ? 8 + pSubframe->nOrder : pSubframe->nType, 7);
+    bitwriter_Put(pWriter, 0, 1);
+
+    if (pSubframe->nType == 0)
+    {
+        bitwriter_Put(pWriter, lSamples[0], nBits);
+
+        return;
+    }
+
+    if (pSubframe->nType == 1)
+    {
+        for (guint nFrame = 0; nFrame < nFrames; nFrame++)
+        {
+            bitwriter_Put(pWriter, lSamples[nFrame], nBits);
+        }
+
+        return;
+    }
+
+    for (guint nFrame = 0; nFrame < pSubframe->nOrder; nFrame++)
+    {
+        bitwriter_Put(pWriter, lSamples[nFrame], nBits);
+    }
+
+    guint nPartitions = 1 << pSubframe->nPartitionOrder;
+    guint nPartitionSize = nFrames >> pSubframe->nPartitionOrder;
+    gboolean bRice2 = FALSE;
+
+    for (guint nPartition = 0; nPartition < nPartitions; nPartition++)
+    {
+        bRice2 |= pSubframe->lParameters[nPartition] > 14;
+    }
+
+    bitwriter_Put(pWriter, bRice2 ? 1 : 0, 2);
+    bitwriter_Put(pWriter, pSubframe->nPartitionOrder, 4);
+    guint nFrame = pSubframe->nOrder;
+
+    for (guint nPartition = 0; nPartition < nPartitions; nPartition++)
+    {
+        guint nParameter = pSubframe->lParameters[nPartition];
+        bitwriter_Put(pWriter, nParameter, bRice2 ? 5 : 4);
+
+        for (; nFrame < (nPartition + 1) * nPartitionSize; nFrame++)
+        {
+            guint32 nValue = export_Fold(pSubframe->lResidual[nFrame]);
+            bitwriter_PutUnary(pWriter, nValue >> nParameter);
+            bitwriter_Put(pWriter, nValue, nParameter);
+        }
+    }
+}
+
+static guint export_GetRateCode(guint nRate)
+{
+    static const guint lRates[] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+
+    for (guint nCode = 1; nCode < G_N_ELEMENTS(lRates); nCode++)
+    {
+        if (lRates[nCode] == nRate)
+        {
+            return nCode;
+        }
+    }
+
+    return 0;
+}
+
+static void export_EncodeFrame(FlacJob *pJob, const gint32 *lSamples, guint nFrames, guint64 nFrameNumber, gint32 *lChannels, Subframe *lSubframes)
+{
+    FlacStream *pStream = pJob->pStream;
+    BitWriter *pWriter = &pJob->cOutput;
+    gsize nStart = pWriter->nSize;
+    guint nChannels = pStream->nChannels;
+    gint32 *lChannel[8];
+
+    for (guint nChannel = 0; nChannel < nChannels; nChannel++)
+    {
+        lChannel[nChannel] = lChannels + nChannel * FLAC_BLOCK_SIZE;
+
+        for (guint nFrame = 0; nFrame < nFrames; nFrame++)
+        {
+            lChannel[nChannel][nFrame] = lSamples[nFrame * nChannels + nChannel];
+        }
+    }
+
+    guint nAssignment = nChannels - 1;
+    Subframe *lChosen[8];
+    gint32 *lChosenSamples[8];
+    guint lChosenBits[8];
+
+    for (guint nChannel = 0; nChannel < nChannels; nChannel++)
+    {
+        export_PlanSubframe(lChannel[nChannel], nFrames, pStream->nBits, &lSubframes[nChannel]);
+        lChosen[nChannel] = &lSubframes[nChannel];
+        lChosenSamples[nChannel] = lChannel[nChannel];
+        lChosenBits[nChannel] = pStream->nBits;
+    }
+
+    if (nChannels == 2)
+    {
+        gint32 *lMid = lChannels + 2 * FLAC_BLOCK_SIZE;
+        gint32 *lSide = lChannels + 3 * FLAC_BLOCK_SIZE;
+
+        for (guint nFrame = 0; nFrame < nFrames; nFrame++)
+        {
+            lMid[nFrame] = (lChannel[0][nFrame] + lChannel[1][nFrame]) >> 1;
+            lSide[nFrame] = lChannel[0][nFrame] - lChannel[1][nFrame];
+        }
+
+        export_PlanSubframe(lMid, nFrames, pStream->nBits, &lSubframes[2]);
+        export_PlanSubframe(lSide, nFrames, pStream->nBits + 1, &lSubframes[3]);
+
+        guint64 nLeft = lSubframes[0].nBits;
+        guint64 nRight = lSubframes[1].nBits;
+        guint64 nMid = lSubframes[2].nBits;
+        guint64 nSideBits = lSubframes[3].nBits;
+        guint64 nBest = nLeft + nRight;
+
+        if (nLeft + nSideBits < nBest)
+        {
+            nBest = nLeft + nSideBits;
+            nAssignment = 8;
+        }
+
+        if (nSideBits + nRight < nBest)
+        {
+            nBest = nSideBits + nRight;
+            nAssignment = 9;
+        }
+
+        if (nMid + nSideBits < nBest)
+        {
+            nAssignment = 10;
+        }
+
+        if (nAssignment == 8)
+        {
+            lChosen[1] = &lSubframes[3];
+            lChosenSamples[1] = lSide;
+            lChosenBits[1] = pStream->nBits + 1;
+        }
+        else if (nAssignment == 9)
+        {
+            lChosen[0] = &lSubframes[3];
+            lChosenSamples[0] = lSide;
+            lChosenBits[0] = pStream->nBits + 1;
+        }
+        else if (nAssignment == 10)
+        {
+            lChosen[0] = &lSubframes[2];
+            lChosenSamples[0] = lMid;
+            lChosen[1] = &lSubframes[3];
+            lChosenSamples[1] = lSide;
+            lChosenBits[1] = pStream->nBits + 1;
+        }
+    }
+
+    bitwriter_Put(pWriter, 0xFFF8, 16);
+    bitwriter_Put(pWriter, (nFrames == FLAC_BLOCK_SIZE) ? 12 : 7, 4);
+    bitwriter_Put(pWriter, export_GetRateCode(pStream->nRate), 4);
+    bitwriter_Put(pWriter, nAssignment, 4);
+    bitwriter_Put(pWriter, (pStream->nBits == 8) ? 1 : (pStream->nBits == 16) ? 4 : 6, 3);
+    bitwriter_Put(pWriter, 0, 1);
+    bitwriter_PutUtf8(pWriter, nFrameNumber);
+
+    if (nFrames != FLAC_BLOCK_SIZE)
+    {
+        bitwriter_Put(pWriter, nFrames - 1, 16);
+    }
+
+    bitwriter_Put(pWriter, export_Crc8(pWriter->lData + nStart, pWriter->nSize - nStart), 8);
+
+    for (guint nChannel = 0; nChannel < nChannels; nChannel++)
+    {
+        export_WriteSubframe(pWriter, lChosenSamples[nChannel], nFrames, lChosenBits[nChannel], lChosen[nChannel]);
+    }
+
+    bitwriter_Align(pWriter);
+    bitwriter_Put(pWriter, export_Crc16(pWriter->lData + nStart, pWriter->nSize - nStart), 16);
+
+    guint nSize = pWriter->nSize - nStart;
+    pJob->nMinFrameSize = MIN(pJob->nMinFrameSize, nSize);
+    pJob->nMaxFrameSize = MAX(pJob->nMaxFrameSize, nSize);
+}
+
+static void export_OnEncode(gpointer pData, gpointer pUserData)
+{
+    FlacJob *pJob = pData;
+    FlacStream *pStream = pUserData;
+    gint64 nTraceStart = trace_Begin();
+
+    if (!g_atomic_int_get(&pStream->bCancel))
+    {
+        guint nSubframes = MAX(pStream->nChannels, 4);
+        gint32 *lChannels = g_malloc(sizeof(gint32) * FLAC_BLOCK_SIZE * nSubframes);
+        Subframe *lSubframes = g_malloc(sizeof(Subframe) * nSubframes);
+
+        for (guint nSubframe = 0; nSubframe < nSubframes; nSubframe++)
+        {
+            lSubframes[nSubframe].lResidual = g_malloc(sizeof(gint32) * FLAC_BLOCK_SIZE);
+        }
+
+        for (guint nFrame = 0; nFrame < pJob->nFrames; nFrame += FLAC_BLOCK_SIZE)
+        {
+            guint nFrames = MIN(FLAC_BLOCK_SIZE, pJob->nFrames - nFrame);
+            export_EncodeFrame(pJob, pJob->lSamples + nFrame * pStream->nChannels, nFrames, pJob->nFrameNumber + nFrame / FLAC_BLOCK_SIZE, lChannels, lSubframes);
+        }
+
+        for (guint nSubframe = 0; nSubframe < nSubframes; nSubframe++)
+        {
+            g_free(lSubframes[nSubframe].lResidual);
+        }
+
+        g_free(lSubframes);
+        g_free(lChannels);
+    }
+
+    trace_End("export_OnEncode", nTraceStart);
+    g_mutex_lock(&pStream->pMutex);
+    pJob->bDone = TRUE;
+    g_cond_broadcast(&pStream->pCond);
+    g_mutex_unlock(&pStream->pMutex);
+}
+
+static void export_FreeJob(FlacJob *pJob)
+{
+    g_free(pJob->lSamples);
+    g_free(pJob->cOutput.lData);
+    g_free(pJob);
+}
+
+static void export_WaitJob(FlacJob *pJob)
+{
+    g_mutex_lock(&pJob->pStream->pMutex);
+
+    while (!pJob->bDone)
+    {
+        g_cond_wait(&pJob->pStream->pCond, &pJob->pStream->pMutex);
+    }
+
+    g_mutex_unlock(&pJob->pStream->pMutex);
+}
+
+static guint export_GetFlacBits(GstAudioInfo *pAudioInfo)
+{
+    switch (GST_AUDIO_INFO_FORMAT(pAudioInfo))
+    {
+        case GST_AUDIO_FORMAT_U8:
+        case GST_AUDIO_FORMAT_S8:
+            return 8;
+        case GST_AUDIO_FORMAT_S16LE:
+            return 16;
+        default:
+            return 24;
+    }
+}
+
+static void export_GetSamples(gchar *lBytes, guint nSamples, GstAudioInfo *pAudioInfo, gint32 *lSamples, guint8 *lMd5)
+{
+    guint nBits = export_GetFlacBits(pAudioInfo);
+
+    for (guint nSample = 0; nSample < nSamples; nSample++)
+    {
+        gint32 nValue;
+
+        switch (GST_AUDIO_INFO_FORMAT(pAudioInfo))
+        {
+            case GST_AUDIO_FORMAT_U8:
+                nValue = (gint32)((guint8*)lBytes)[nSample] - 128;
+                break;
+            case GST_AUDIO_FORMAT_S8:
+                nValue = ((gint8*)lBytes)[nSample];
+                break;
+            case GST_AUDIO_FORMAT_S16LE:
+            {
+                gint16 nSample16;
+                memcpy(&nSample16, lBytes + nSample * 2, 2);
+                nValue = GINT16_FROM_LE(nSample16);
+                break;
+            }
+            default:
+            {
+                guint8 *lSample = (guint8*)lBytes + nSample * 3;
+                nValue = lSample[0] | (lSample[1] << 8) | ((gint8)lSample[2] * 65536);
+                break;
+            }
+        }
+
+        lSamples[nSample] = nValue;
+
+        for (guint nByte = 0; nByte < nBits / 8; nByte++)
+        {
+            *lMd5++ = (nValue >> (nByte * 8)) & 0xFF;
+        }
+    }
+}
+
+static void export_GetStreamInfo(FlacStream *pStream, guint64 nFrames, guint nMinFrameSize, guint nMaxFrameSize, guint8 *lMd5, guint8 *lStreamInfo)
+{
+    // The minimum excludes the last block, so a stream shorter than one block still declares the nominal size, as libFLAC does
+    BitWriter cWriter = {0};
+    bitwriter_Put(&cWriter, FLAC_BLOCK_SIZE, 16);
+    bitwriter_Put(&cWriter, FLAC_BLOCK_SIZE, 16);
+    bitwriter_Put(&cWriter, nMinFrameSize, 24);
+    bitwriter_Put(&cWriter, nMaxFrameSize, 24);
+    bitwriter_Put(&cWriter, pStream->nRate, 20);
+    bitwriter_Put(&cWriter, pStream->nChannels - 1, 3);
+    bitwriter_Put(&cWriter, pStream->nBits - 1, 5);
+    bitwriter_Put(&cWriter, nFrames >> 32, 4);
+    bitwriter_Put(&cWriter, nFrames & 0xFFFFFFFF, 32);
+    memcpy(lStreamInfo, cWriter.lData, 18);
+    memcpy(lStreamInfo + 18, lMd5, 16);
+    g_free(cWriter.lData);
+}
+
+const gchar* export_GetEncoder(gchar *sFilePath)
+{
+    gchar *sFilePathLower = g_utf8_strdown(sFilePath, -1);
+    const gchar *sEncoder = NULL;
+
+    for (guint nFormat = 0; nFormat < G_N_ELEMENTS(EXPORT_FORMATS); nFormat++)
+    {
+        if (g_str_has_suffix(sFilePathLower, EXPORT_FORMATS[nFormat].sExtension))
+        {
+            sEncoder = EXPORT_FORMATS[nFormat].sEncoder;
+
+            break;
+        }
+    }
+
+    g_free(sFilePathLower);
+
+    return sEncoder;
+}
+
+gboolean export_IsNativeFlac(gchar *sFilePath, GstAudioInfo *pAudioInfo)
+{
+    gchar *sFilePathLower = g_utf8_strdown(sFilePath, -1);
+    gboolean bFlac = g_str_has_suffix(sFilePathLower, ".flac");
+    g_free(sFilePathLower);
+
+    if (!bFlac || pAudioInfo->channels > 8 || pAudioInfo->rate >= (1 << 20))
+    {
+        return FALSE;
+    }
+
+    switch (GST_AUDIO_INFO_FORMAT(pAudioInfo))
+    {
+        case GST_AUDIO_FORMAT_U8:
+        case GST_AUDIO_FORMAT_S8:
+        case GST_AUDIO_FORMAT_S16LE:
+        case GST_AUDIO_FORMAT_S24LE:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+gboolean export_Flac(Chunk *pChunk, gint64 nStartFrame, gint64 nFrames, gchar *sFilePath, Progress *pProgress, gboolean *bFatal)
+{
+    export_InitCrc();
+
+    File *pFile = file_Open(sFilePath, FILE_WRITE, TRUE);
+
+    if (!pFile)
+    {
+        return TRUE;
+    }
+
+    FlacStream cStream = {.nChannels = pChunk->pAudioInfo->channels, .nBits = export_GetFlacBits(pChunk->pAudioInfo), .nRate = pChunk->pAudioInfo->rate};
+    g_mutex_init(&cStream.pMutex);
+    g_cond_init(&cStream.pCond);
+
+    guint8 lHeader[8 + FLAC_STREAMINFO_SIZE] = {'f', 'L', 'a', 'C', 0x80, 0, 0, FLAC_STREAMINFO_SIZE};
+    gboolean bError = file_Write((gchar*)lHeader, sizeof(lHeader), pFile);
+    *bFatal = bError;
+
+    g_object_ref(pChunk);
+    ChunkHandle *pChunkHandle = bError ? NULL : chunk_Open(pChunk, FALSE);
+    bError |= (pChunkHandle == NULL);
+
+    guint nThreads = MAX(1, g_get_num_processors());
+    GThreadPool *pPool = g_thread_pool_new(export_OnEncode, &cStream, nThreads, FALSE, NULL);
+    GChecksum *pChecksum = g_checksum_new(G_CHECKSUM_MD5);
+    GQueue qJobs = G_QUEUE_INIT;
+    guint nSegmentFrames = FLAC_BLOCK_SIZE * FLAC_SEGMENT_BLOCKS;
+    gchar *lBytes = g_malloc(nSegmentFrames * pChunk->pAudioInfo->bpf);
+    guint8 *lMd5 = g_malloc(nSegmentFrames * cStream.nChannels * (cStream.nBits / 8));
+    guint nMinFrameSize = G_MAXUINT;
+    guint nMaxFrameSize = 0;
+    gint64 nFramesRead = 0;
+    gint64 nFramesWritten = 0;
+    guint64 nFrameNumber = 0;
+
+    while (!bError && (nFramesRead < nFrames || qJobs.length))
+    {
+        if (nFramesRead < nFrames)
+        {
+            guint nSegment = MIN(nSegmentFrames, nFrames - nFramesRead);
+
+            for (guint nFrame = 0; nFrame < nSegment && !bError;)
+            {
+                guint nRead = chunk_Read(pChunkHandle, nStartFrame + nFramesRead + nFrame, MIN(nSegment - nFrame, BUFFER_SIZE / pChunk->pAudioInfo->bpf), lBytes + nFrame * pChunk->pAudioInfo->bpf, FALSE, FALSE);
+                bError = (nRead == 0);
+                nFrame += nRead;
+            }
+
+            if (bError)
+            {
+                *bFatal = TRUE;
+
+                break;
+            }
+
+            FlacJob *pJob = g_malloc0(sizeof(FlacJob));
+            pJob->pStream = &cStream;
+            pJob->nFrames = nSegment;
+            pJob->nFrameNumber = nFrameNumber;
+            pJob->nMinFrameSize = G_MAXUINT;
+            pJob->lSamples = g_malloc(sizeof(gint32) * nSegment * cStream.nChannels);
+            export_GetSamples(lBytes, nSegment * cStream.nChannels, pChunk->pAudioInfo, pJob->lSamples, lMd5);
+            g_checksum_update(pChecksum, lMd5, nSegment * cStream.nChannels * (cStream.nBits / 8));
+            g_queue_push_tail(&qJobs, pJob);
+            g_thread_pool_push(pPool, pJob, NULL);
+            nFramesRead += nSegment;
+            nFrameNumber += FLAC_SEGMENT_BLOCKS;
+        }
+
+        // Keep at most two segments per thread in flight and write them back in order
+        while (qJobs.length >= nThreads * 2 || (qJobs.length && nFramesRead == nFrames))
+        {
+            FlacJob *pJob = g_queue_pop_head(&qJobs);
+            export_WaitJob(pJob);
+
+            if (file_Write((gchar*)pJob->cOutput.lData, pJob->cOutput.nSize, pFile))
+            {
+                export_FreeJob(pJob);
+                *bFatal = TRUE;
+                bError = TRUE;
+
+                break;
+            }
+
+            nMinFrameSize = MIN(nMinFrameSize, pJob->nMinFrameSize);
+            nMaxFrameSize = MAX(nMaxFrameSize, pJob->nMaxFrameSize);
+            nFramesWritten += pJob->nFrames;
+            export_FreeJob(pJob);
+        }
+
+        if (!bError && progress_Update(pProgress, GFLOAT(nFramesWritten) / GFLOAT(MAX(nFrames, 1))))
+        {
+            bError = TRUE;
+        }
+    }
+
+    g_atomic_int_set(&cStream.bCancel, TRUE);
+    g_thread_pool_free(pPool, FALSE, TRUE);
+    FlacJob *pJob;
+
+    while ((pJob = g_queue_pop_head(&qJobs)))
+    {
+        export_FreeJob(pJob);
+    }
+
+    if (!bError)
+    {
+        gsize nDigest = 16;
+        guint8 lDigest[16];
+        g_checksum_get_digest(pChecksum, lDigest, &nDigest);
+        export_GetStreamInfo(&cStream, nFrames, (nMinFrameSize == G_MAXUINT) ? 0 : nMinFrameSize, nMaxFrameSize, lDigest, lHeader + 8);
+        bError = file_Seek(pFile, 8, SEEK_SET) || file_Write((gchar*)lHeader + 8, FLAC_STREAMINFO_SIZE, pFile);
+        *bFatal = bError;
+    }
+
+    if (bError && *bFatal)
+    {
+        gchar *sMessage = g_strdup_printf(_("Failed to write to '%s'!"), sFilePath);
+        message_Error(sMessage);
+        g_free(sMessage);
+    }
+
+    g_checksum_free(pChecksum);
+    g_free(lMd5);
+    g_free(lBytes);
+
+    if (pChunkHandle)
+    {
+        chunk_Close(pChunkHandle, FALSE);
+    }
+
+    g_object_unref(pChunk);
+    file_Close(pFile, bError && !*bFatal);
+    g_cond_clear(&cStream.pCond);
+    g_mutex_clear(&cStream.pMutex);
+
+    return bError;
+}
+
+static void export_OnRegion(gpointer pData, gpointer pUserData)
+{
+    ExportJob *pJob = pData;
+    ExportShared *pShared = pUserData;
+    gint64 nTraceStart = trace_Begin();
+    const gchar *sEncoder = export_GetEncoder(pJob->pRegion->sFilePath);
+    GstWriter *pGstWriter = gstwriter_New(pJob->pRegion->sFilePath, pJob->pAudioInfo, sEncoder);
+    gboolean bError = FALSE;
+    gboolean bLast = FALSE;
+
+    // The blocks still have to be drained so the reader's budget keeps moving
+    if (!pGstWriter)
+    {
+        pJob->sError = g_strdup_printf(_("The encoder '%s' for '%s' is not installed!"), sEncoder, pJob->pRegion->sFilePath);
+        bError = TRUE;
+    }
+
+    while (!bLast)
+    {
+        ExportBlock *pBlock = g_async_queue_pop(pJob->pQueue);
+        bLast = pBlock->bLast;
+
+        if (!bError && pBlock->nFrames && !g_atomic_int_get(&pShared->bCancel))
+        {
+            if (gstwriter_Write(pGstWriter, pBlock->nFrames, pBlock->lBytes, bLast) != pBlock->nFrames)
+            {
+                pJob->sError = g_strdup_printf(_("Failed to write to '%s'!"), pJob->pRegion->sFilePath);
+                bError = TRUE;
+            }
+            else if (bLast)
+            {
+                pJob->bComplete = TRUE;
+            }
+        }
+
+        g_mutex_lock(&pShared->pMutex);
+        pShared->nBudget += pBlock->nFrames * pJob->pAudioInfo->bpf;
+        pShared->nFramesWritten += pBlock->nFrames;
+        g_cond_broadcast(&pShared->pCond);
+        g_mutex_unlock(&pShared->pMutex);
+        g_free(pBlock->lBytes);
+        g_free(pBlock);
+    }
+
+    if (pGstWriter)
+    {
+        gstwriter_Free(pGstWriter);
+    }
+
+    trace_End("export_OnRegion", nTraceStart);
+    g_mutex_lock(&pShared->pMutex);
+    pShared->nDone++;
+    g_cond_broadcast(&pShared->pCond);
+    g_mutex_unlock(&pShared->pMutex);
+}
+
+static void export_PushBlock(ExportJob *pJob, guint nFrames, gchar *lBytes)
+{
+    ExportBlock *pBlock = g_malloc(sizeof(ExportBlock));
+    pBlock->nFrames = nFrames;
+    pBlock->lBytes = lBytes;
+    pJob->nFramesRead += nFrames;
+    pBlock->bLast = (pJob->nFramesRead == pJob->pRegion->nFrames) || !lBytes;
+    g_async_queue_push(pJob->pQueue, pBlock);
+}
+
+static gboolean export_WaitBudget(ExportShared *pShared, gsize nBytes, gint64 nTotalFrames, Progress *pProgress)
+{
+    g_mutex_lock(&pShared->pMutex);
+
+    while (pShared->nBudget < nBytes)
+    {
+        gint64 nEndTime = g_get_monotonic_time() + 50 * G_TIME_SPAN_MILLISECOND;
+
+        if (!g_cond_wait_until(&pShared->pCond, &pShared->pMutex, nEndTime))
+        {
+            gint64 nFramesWritten = pShared->nFramesWritten;
+            g_mutex_unlock(&pShared->pMutex);
+
+            if (progress_Update(pProgress, GFLOAT(nFramesWritten) / GFLOAT(nTotalFrames)))
+            {
+                return TRUE;
+            }
+
+            g_mutex_lock(&pShared->pMutex);
+        }
+    }
+
+    pShared->nBudget -= nBytes;
+    g_mutex_unlock(&pShared->pMutex);
+
+    return FALSE;
+}
+
+gboolean export_Regions(Chunk *pChunk, ExportRegion *lRegions, guint nRegions, Progress *pProgress)
+{
+    gint64 nTotalFrames = 0;
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        ExportRegion *pRegion = &lRegions[nRegion];
+        gchar *sMessage = NULL;
+
+        if (!export_GetEncoder(pRegion->sFilePath))
+        {
+            sMessage = g_strdup_printf(_("Unsupported file type: '%s'"), pRegion->sFilePath);
+        }
+        else if (pRegion->nFrames <= 0 || pRegion->nStartFrame < 0 || pRegion->nStartFrame + pRegion->nFrames > pChunk->nFrames)
+        {
+            sMessage = g_strdup_printf(_("Invalid range for '%s'"), pRegion->sFilePath);
+        }
+
+        if (sMessage)
+        {
+            message_Error(sMessage);
+            g_free(sMessage);
+
+            return TRUE;
+        }
+
+        nTotalFrames += pRegion->nFrames;
+    }
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        if (g_file_test(lRegions[nRegion].sFilePath, G_FILE_TEST_EXISTS) && file_Unlink(lRegions[nRegion].sFilePath))
+        {
+            return TRUE;
+        }
+    }
+
+    progress_Begin(pProgress, _("Saving"));
+
+    if (nRegions == 1 && export_IsNativeFlac(lRegions[0].sFilePath, pChunk->pAudioInfo))
+    {
+        gboolean bFatal = FALSE;
+        gboolean bError = export_Flac(pChunk, lRegions[0].nStartFrame, lRegions[0].nFrames, lRegions[0].sFilePath, pProgress, &bFatal);
+        progress_End(pProgress);
+
+        return bError;
+    }
+
+    g_object_ref(pChunk);
+    ChunkHandle *pChunkHandle = chunk_Open(pChunk, FALSE);
+
+    if (pChunkHandle == NULL)
+    {
+        g_object_unref(pChunk);
+        progress_End(pProgress);
+
+        return TRUE;
+    }
+
+    // Reading stays on this thread, encoding and writing run on the pool, and the blocks in flight share one byte budget
+    ExportShared cShared = {.nBudget = EXPORT_IO_BUDGET};
+    g_mutex_init(&cShared.pMutex);
+    g_cond_init(&cShared.pCond);
+    guint nThreads = MIN(nRegions, MAX(1, g_get_num_processors()));
+    GThreadPool *pPool = g_thread_pool_new(export_OnRegion, &cShared, nThreads, FALSE, NULL);
+    ExportJob *lJobs = g_new0(ExportJob, nRegions);
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        lJobs[nRegion].pShared = &cShared;
+        lJobs[nRegion].pRegion = &lRegions[nRegion];
+        lJobs[nRegion].pAudioInfo = pChunk->pAudioInfo;
+        lJobs[nRegion].pQueue = g_async_queue_new();
+        g_thread_pool_push(pPool, &lJobs[nRegion], NULL);
+    }
+
+    guint *lActive = g_new(guint, nThreads);
+    guint nActive = 0;
+    guint nNext = 0;
+    gboolean bError = FALSE;
+    gboolean bReported = FALSE;
+
+    for (; nActive < nThreads; nActive++)
+    {
+        lActive[nActive] = nNext++;
+    }
+
+    while (nActive && !bError)
+    {
+        for (guint nSlot = 0; nSlot < nActive && !bError;)
+        {
+            ExportJob *pJob = &lJobs[lActive[nSlot]];
+            guint nFrames = MIN(EXPORT_BLOCK_FRAMES, pJob->pRegion->nFrames - pJob->nFramesRead);
+            gsize nBytes = nFrames * pChunk->pAudioInfo->bpf;
+
+            if (export_WaitBudget(&cShared, nBytes, nTotalFrames, pProgress))
+            {
+                bError = TRUE;
+
+                break;
+            }
+
+            gchar *lBytes = g_malloc(nBytes);
+
+            for (guint nFrame = 0; nFrame < nFrames && !bError;)
+            {
+                guint nRead = chunk_Read(pChunkHandle, pJob->pRegion->nStartFrame + pJob->nFramesRead + nFrame, MIN(nFrames - nFrame, BUFFER_SIZE / pChunk->pAudioInfo->bpf), lBytes + nFrame * pChunk->pAudioInfo->bpf, FALSE, FALSE);
+                bError = (nRead == 0);
+                nFrame += nRead;
+            }
+
+            if (bError)
+            {
+                g_free(lBytes);
+                g_mutex_lock(&cShared.pMutex);
+                cShared.nBudget += nBytes;
+                g_mutex_unlock(&cShared.pMutex);
+
+                break;
+            }
+
+            export_PushBlock(pJob, nFrames, lBytes);
+
+            if (pJob->nFramesRead < pJob->pRegion->nFrames)
+            {
+                nSlot++;
+            }
+            else if (nNext < nRegions)
+            {
+                lActive[nSlot++] = nNext++;
+            }
+            else
+            {
+                lActive[nSlot] = lActive[--nActive];
+            }
+        }
+
+        g_mutex_lock(&cShared.pMutex);
+        gint64 nFramesWritten = cShared.nFramesWritten;
+        g_mutex_unlock(&cShared.pMutex);
+
+        if (!bError && progress_Update(pProgress, GFLOAT(nFramesWritten) / GFLOAT(nTotalFrames)))
+        {
+            bError = TRUE;
+        }
+    }
+
+    chunk_Close(pChunkHandle, FALSE);
+    g_object_unref(pChunk);
+
+    if (bError)
+    {
+        g_atomic_int_set(&cShared.bCancel, TRUE);
+
+        for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+        {
+            if (lJobs[nRegion].nFramesRead < lJobs[nRegion].pRegion->nFrames)
+            {
+                export_PushBlock(&lJobs[nRegion], 0, NULL);
+            }
+        }
+    }
+
+    g_mutex_lock(&cShared.pMutex);
+
+    while (cShared.nDone < nRegions)
+    {
+        gint64 nEndTime = g_get_monotonic_time() + 50 * G_TIME_SPAN_MILLISECOND;
+
+        if (!g_cond_wait_until(&cShared.pCond, &cShared.pMutex, nEndTime))
+        {
+            gint64 nFramesWritten = cShared.nFramesWritten;
+            g_mutex_unlock(&cShared.pMutex);
+
+            if (!bError && progress_Update(pProgress, GFLOAT(nFramesWritten) / GFLOAT(nTotalFrames)))
+            {
+                g_atomic_int_set(&cShared.bCancel, TRUE);
+                bError = TRUE;
+            }
+
+            g_mutex_lock(&cShared.pMutex);
+        }
+    }
+
+    g_mutex_unlock(&cShared.pMutex);
+    g_thread_pool_free(pPool, FALSE, TRUE);
+
+    for (guint nRegion = 0; nRegion < nRegions; nRegion++)
+    {
+        ExportJob *pJob = &lJobs[nRegion];
+
+        if (pJob->sError)
+        {
+            if (!bReported)
+            {
+                message_Error(pJob->sError);
+                bReported = TRUE;
+            }
+
+            g_free(pJob->sError);
+        }
+
+        if (!pJob->bComplete)
+        {
+            bError = TRUE;
+
+            if (g_file_test(pJob->pRegion->sFilePath, G_FILE_TEST_EXISTS))
+            {
+                file_Unlink(pJob->pRegion->sFilePath);
+            }
+        }
+
+        g_async_queue_unref(pJob->pQueue);
+    }
+
+    g_free(lActive);
+    g_free(lJobs);
+    g_cond_clear(&cShared.pCond);
+    g_mutex_clear(&cShared.pMutex);
+    progress_End(pProgress);
+
+    return bError;
+}
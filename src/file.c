@@ -28,6 +28,8 @@
 #include "message.h"
 #include "file.h"
 #include "gstreamer.h"
+#include "trace.h"
+#include "counters.h"
 
 File *file_Open(gchar *sFilePath, gint nMode, gboolean bReportError)
 {
@@ -119,7 +121,9 @@ gboolean file_Read(gchar *lBytes, gint64 nBytes, File *pFile)
 
     while (nBytes > 0)
     {
+        gint64 nTraceStart = trace_Begin();
         gint64 nRead = read(pFile->nFile, lBytes + nPos, nBytes);
+        trace_End("file_Read", nTraceStart);
 
         if (nRead == 0)
         {
@@ -144,6 +148,7 @@ gboolean file_Read(gchar *lBytes, gint64 nBytes, File *pFile)
 
         nPos += nRead;
         nBytes -= nRead;
+        counters_Add(COUNTER_BYTES_READ, nRead);
     }
 
     if (nPos < nBytes)
@@ -162,6 +167,53 @@ gboolean file_Read(gchar *lBytes, gint64 nBytes, File *pFile)
     return FALSE;
 }
 
+gboolean file_ReadAt(File *pFile, gint64 nByte, gchar *lBytes, gint64 nBytes)
+{
+    gint64 nPos = 0;
+    gchar *sMessage;
+
+    while (nPos < nBytes)
+    {
+        gint64 nTraceStart = trace_Begin();
+        gint64 nRead = pread(pFile->nFile, lBytes + nPos, nBytes - nPos, nByte + nPos);
+        trace_End("file_ReadAt", nTraceStart);
+
+        if (nRead == 0)
+        {
+            break;
+        }
+
+        if (nRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            sMessage = g_strdup_printf(_("Could not read from %s: %s"), pFile->sFilePath, strerror(errno));
+            message_Error(sMessage);
+            g_free(sMessage);
+
+            return TRUE;
+        }
+
+        nPos += nRead;
+        counters_Add(COUNTER_BYTES_READ, nRead);
+    }
+
+    if (nPos < nBytes)
+    {
+        // Translators: %s will be the name of the file
+        sMessage = g_strdup_printf(_("Unexpected end of file reading %s"), pFile->sFilePath);
+        message_Error(sMessage);
+        g_free(sMessage);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 gboolean file_Write(gchar *lBytes, gint64 nBytes, File *pFile)
 {
     gint64 nPos = 0;
@@ -196,6 +248,7 @@ gboolean file_Write(gchar *lBytes, gint64 nBytes, File *pFile)
 
         nPos += nWritten;
         nBytes -= nWritten;
+        counters_Add(COUNTER_BYTES_WRITTEN, nWritten);
     }
 
     return FALSE;
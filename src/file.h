@@ -40,6 +40,7 @@ File *file_Open(gchar *sFilePath, gint nMode, gboolean bReportErrors);
 gboolean file_Close(File *pFile, gboolean bUnlink);
 gboolean file_Seek(File *pFile, gint64 nByte, gint nWhence);
 gboolean file_Read(gchar *lBytes, gint64 nBytes, File *pFile);
+gboolean file_ReadAt(File *pFile, gint64 nByte, gchar *lBytes, gint64 nBytes);
 gboolean file_Write(gchar *lBytes, gint64 nBytes, File *pFile);
 gint64 file_Tell(File *pFile);
 gboolean file_Copy(gchar *sFrom, gchar *sTo);
@@ -22,7 +22,18 @@
 #include <gst/app/gstappsink.h>
 #include <gst/pbutils/pbutils.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 #include "gstreamer.h"
+#include "trace.h"
+#include "counters.h"
+#include "scratch.h"
+
+#define GSTPLAYER_SCRUB_BUFFER_TIME 20000
+#define GSTPLAYER_SCRUB_LATENCY_TIME 5000
+#define GSTRECORDER_BUFFER_TIME 200000
+#define GSTRECORDER_LATENCY_TIME 5000
+#define GSTCONVERTER_PREROLL_TIME 10000000
+#define GSTCONVERTER_EXPANSION 12
 
 typedef struct
 {
@@ -51,7 +62,7 @@ typedef struct
 } Property;
 
 static GstBase* gstbase_New();
-static void gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gchar *sFilePath, GstAudioInfo *pAudioInfo);
+static gboolean gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gchar *sFilePath, GstAudioInfo *pAudioInfo);
 static gboolean gstbase_OnError(GstBus *pBus, GstMessage *pMessage, gpointer pUserData);
 static void gstbase_Pause(GstBase *pGstBase);
 static void gstbase_Play(GstBase *pGstBase);
@@ -59,7 +70,10 @@ static void gstbase_AddSignal(GstBase *pGstBase, gchar *sName, gchar *sSignal, G
 static void gstbase_Free(GstBase *pGstBase);
 static void gstreader_OnPadAdded(GstElement *pDecoder, GstPad *pPad, gpointer pUserData);
 static void gstplayer_OnNeedData(GstElement *pElement, guint nBytes, gpointer pUserData);
-static gboolean gstplayer_OnSeekData(GstElement *pElement, guint nOffset, gpointer pUserData);
+static gboolean gstplayer_OnSeekData(GstElement *pElement, guint64 nOffset, gpointer pUserData);
+static void gstplayer_OnElementAdded(GstBin *pBin, GstBin *pSubBin, GstElement *pElement, gpointer pUserData);
+static GstFlowReturn gstrecorder_OnNewSample(GstAppSink *pAppSink, gpointer pUserData);
+static void gstrecorder_OnElementAdded(GstBin *pBin, GstBin *pSubBin, GstElement *pElement, gpointer pUserData);
 
 static gchar* string_Replace(gchar *sHaystack, gchar *sNeedle, gchar *sReplace, gboolean bFree)
 {
@@ -87,8 +101,10 @@ GstBase* gstbase_New()
     return pGstBase;
 }
 
-static void gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gchar *sFilePath, GstAudioInfo *pAudioInfo)
+static gboolean gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gchar *sFilePath, GstAudioInfo *pAudioInfo)
 {   
+    gint64 nTraceStart = trace_Begin();
+
     if (pGstBase->pPipeline == NULL)
     {        
         gchar *sCommandNew = NULL;
@@ -123,12 +139,27 @@ static void gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gc
             sCommandNew = sCommand;
         }
 
-        pGstBase->pPipeline = GST_PIPELINE_CAST(gst_parse_launch(sCommandNew, NULL));
-        
+        GError *pError = NULL;
+        GstElement *pPipeline = gst_parse_launch(sCommandNew, &pError);
+
         if (sFilePath != NULL || pAudioInfo != NULL)
         {
             g_free(sCommandNew);
         }
+
+        // A missing plugin leaves either nothing or a pipeline with a hole in it
+        if (pError != NULL || pPipeline == NULL)
+        {
+            g_warning("Could not create the pipeline: %s", pError ? pError->message : "");
+            g_clear_error(&pError);
+            g_clear_object(&pPipeline);
+            trace_End("gstbase_Init", nTraceStart);
+
+            return TRUE;
+        }
+
+        pGstBase->pPipeline = GST_PIPELINE_CAST(pPipeline);
+        counters_Add(COUNTER_GST_PIPELINES, 1);
         
         GstBus *pBus = gst_pipeline_get_bus(pGstBase->pPipeline);
 
@@ -166,6 +197,10 @@ static void gstbase_Init(GstBase *pGstBase, gchar *sCommand, gboolean bBlock, gc
     {
         gst_element_get_state(GST_ELEMENT_CAST(pGstBase->pPipeline), NULL, NULL, GST_CLOCK_TIME_NONE);
     }
+
+    trace_End("gstbase_Init", nTraceStart);
+
+    return FALSE;
 }
 
 static GstAudioFormat gstbase_GetAudioFormat(GstAudioFormat nAudioFormat)
@@ -217,7 +252,7 @@ static GstAudioFormat gstbase_GetAudioFormat(GstAudioFormat nAudioFormat)
     }
 }
 
-guint gstbase_GetPosition(GstBase *pGstBase)
+gint64 gstbase_GetPosition(GstBase *pGstBase)
 {
     gint64 nPosition = 0;
 
@@ -233,7 +268,7 @@ guint gstbase_GetPosition(GstBase *pGstBase)
         nPosition = GST_CLOCK_TIME_TO_FRAMES(nPosition, pGstBase->pAudioInfo->rate);
     }
     
-    return (guint)nPosition;
+    return nPosition;
 }
 
 static void gstbase_Pause(GstBase *pGstBase)
@@ -277,6 +312,7 @@ void gstbase_Close(GstBase *pGstBase)
         pGstBase->lSignals = NULL;
         gst_object_unref(GST_OBJECT(pGstBase->pPipeline));
         pGstBase->pPipeline = NULL;
+        counters_Add(COUNTER_GST_PIPELINES, -1);
     }
 }
 
@@ -310,7 +346,7 @@ static void gstbase_Play(GstBase *pGstBase)
     gst_element_set_state(GST_ELEMENT_CAST(pGstBase->pPipeline), GST_STATE_PLAYING);
 }
 
-void gstbase_Seek(GstBase *pGstBase, guint nFrame)
+void gstbase_Seek(GstBase *pGstBase, gint64 nFrame)
 {    
     if (pGstBase->pPipeline)
     {    
@@ -351,10 +387,13 @@ GstReader* gstreader_New(gchar * sPath)
     pGstReader->fDuration = 0.0;
     pGstReader->nFrames = 0;
     gstbase_AddSignal(pGstReader->pGstBase, "decode", "pad-added", G_CALLBACK(gstreader_OnPadAdded), pGstReader);
-    gstbase_Init(pGstReader->pGstBase, "filesrc location=\"\tFILE\t\" ! decodebin name=decode ! audioconvert ! audio/x-raw ! fakesink", TRUE, pGstReader->sFilePath, NULL);
-    gstbase_Play(pGstReader->pGstBase);
-    gstbase_Wait(pGstReader->pGstBase);
-    gstbase_Close(pGstReader->pGstBase);
+
+    if (!gstbase_Init(pGstReader->pGstBase, "filesrc location=\"\tFILE\t\" ! decodebin name=decode ! audioconvert ! audio/x-raw ! fakesink", TRUE, pGstReader->sFilePath, NULL))
+    {
+        gstbase_Play(pGstReader->pGstBase);
+        gstbase_Wait(pGstReader->pGstBase);
+        gstbase_Close(pGstReader->pGstBase);
+    }
 
     return pGstReader;
 }
@@ -387,10 +426,11 @@ static void gstreader_OnPadAdded(GstElement *pDecoder, GstPad *pPad, gpointer pD
     gst_object_unref(pBus);
 }
 
-guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, guint nStartFrame, guint nFramesToRead, gboolean bFloat)
+guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, gint64 nStartFrame, guint nFramesToRead, gboolean bFloat)
 {   
+    gint64 nTraceStart = trace_Begin();
     guint nSampleWidth = bFloat ? 4 : (pGstReader->pGstBase->pAudioInfo->finfo->width / 8);
-    guint64 nBytesToRead = nFramesToRead * pGstReader->pGstBase->pAudioInfo->channels * nSampleWidth;
+    guint64 nBytesToRead = (guint64)nFramesToRead * pGstReader->pGstBase->pAudioInfo->channels * nSampleWidth;
     guint64 nBytesRead = 0;
 
     if (pGstReader->pGstBase->pPipeline == NULL)
@@ -411,7 +451,9 @@ guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, guint nStartFrame, g
         g_free(sCommand); 
     }
 
+    gint64 nTraceSeek = trace_Begin();
     gstbase_Seek(pGstReader->pGstBase, nStartFrame);
+    trace_End("gstbase_Seek", nTraceSeek);
     gstbase_Play(pGstReader->pGstBase);
     GstAppSink *pAppSink = GST_APP_SINK_CAST(gst_bin_get_by_name(GST_BIN_CAST(pGstReader->pGstBase->pPipeline), "sink"));
 
@@ -458,6 +500,9 @@ guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, guint nStartFrame, g
         g_warning("EOS: Padded with %"G_GUINT64_FORMAT" frames",  (nBytesToRead - nBytesRead) / (pGstReader->pGstBase->pAudioInfo->channels * nSampleWidth));
     }
 
+    counters_Add(COUNTER_BYTES_DECODED, nBytesRead);
+    trace_End("gstreader_Read", nTraceStart);
+
     return nFramesToRead;
 }
 
@@ -469,13 +514,24 @@ void gstreader_Free(GstReader *pGstReader)
     pGstReader = NULL;
 }
 
-GstWriter* gstwriter_New(gchar *sFilePath, GstAudioInfo *pAudioInfo)
+GstWriter* gstwriter_New(gchar *sFilePath, GstAudioInfo *pAudioInfo, const gchar *sEncoder)
 { 
     GstWriter *pGstWriter = g_malloc(sizeof(GstWriter));
     pGstWriter->pGstBase = gstbase_New();
     pGstWriter->pGstBase->pAudioInfo = pAudioInfo;
     pGstWriter->sFilePath = sFilePath;
-    gstbase_Init(pGstWriter->pGstBase, "appsrc name=src block=TRUE caps=\"\tCAPS\t\" ! wavenc ! filesink location=\"\tFILE\t\"", FALSE, sFilePath, pAudioInfo); 
+    pGstWriter->bWav = g_str_equal(sEncoder, "wavenc");
+    gchar *sCommand = g_strdup_printf("appsrc name=src block=TRUE caps=\"\tCAPS\t\" ! %s ! filesink location=\"\tFILE\t\"", sEncoder);
+    gboolean bError = gstbase_Init(pGstWriter->pGstBase, sCommand, FALSE, sFilePath, pAudioInfo);
+    g_free(sCommand);
+
+    if (bError)
+    {
+        gstwriter_Free(pGstWriter);
+
+        return NULL;
+    }
+
     gstbase_Play(pGstWriter->pGstBase);
 
     return pGstWriter;
@@ -554,7 +610,7 @@ guint gstwriter_Write(GstWriter *pGstWriter, guint nFrames, gchar *lBytes, gbool
         gint n50Result = memcmp(pGstWriter->pGstBase->pAudioInfo->position, lPositions50, sizeof(pGstWriter->pGstBase->pAudioInfo->position));
         gint n71Result = memcmp(pGstWriter->pGstBase->pAudioInfo->position, lPositions71, sizeof(pGstWriter->pGstBase->pAudioInfo->position));
         
-        if (nQuadResult == 0 || n50Result == 0 || n71Result == 0)
+        if (pGstWriter->bWav && (nQuadResult == 0 || n50Result == 0 || n71Result == 0))
         {
             gchar pBuffer[2] = {0x01, 0x00};
             GFile *pFile = g_file_new_for_path(pGstWriter->sFilePath);
@@ -588,6 +644,7 @@ GstPlayer* gstplayer_New(GstAudioInfo *pAudioInfo, OnGetFrames pOnGetFrames)
     pGstPlayer->pGstBase = gstbase_New();
     pGstPlayer->pGstBase->pAudioInfo = pAudioInfo;
     pGstPlayer->pOnGetFrames = pOnGetFrames;
+    pGstPlayer->nBufferFrames = BUFFER_SIZE / pAudioInfo->bpf;
     gstbase_AddSignal(pGstPlayer->pGstBase, "src", "need-data", G_CALLBACK(gstplayer_OnNeedData), pGstPlayer);
     gstbase_AddSignal(pGstPlayer->pGstBase, "src", "seek-data", G_CALLBACK(gstplayer_OnSeekData), pGstPlayer);
     gstbase_Init(pGstPlayer->pGstBase, "appsrc stream-type=GST_APP_STREAM_TYPE_RANDOM_ACCESS format=GST_FORMAT_TIME name=src caps=\"\tCAPS\t\" ! autoaudiosink", FALSE, NULL, pAudioInfo);   
@@ -595,12 +652,41 @@ GstPlayer* gstplayer_New(GstAudioInfo *pAudioInfo, OnGetFrames pOnGetFrames)
     
     return pGstPlayer;
 }
+
+GstPlayer* gstplayer_NewScrub(GstAudioInfo *pAudioInfo, guint nBufferFrames, OnGetFrames pOnGetFrames)
+{
+    GstPlayer *pGstPlayer = g_malloc(sizeof(GstPlayer));
+    pGstPlayer->pGstBase = gstbase_New();
+    pGstPlayer->pGstBase->pAudioInfo = pAudioInfo;
+    pGstPlayer->pOnGetFrames = pOnGetFrames;
+    pGstPlayer->nBufferFrames = MIN(nBufferFrames, BUFFER_SIZE / pAudioInfo->bpf);
+    gstbase_AddSignal(pGstPlayer->pGstBase, "src", "need-data", G_CALLBACK(gstplayer_OnNeedData), pGstPlayer);
+
+    // Only queue two buffers ahead, anything more is heard as lag behind the pointer
+    gchar *sCommand = g_strdup_printf("appsrc stream-type=GST_APP_STREAM_TYPE_STREAM format=GST_FORMAT_TIME max-bytes=%u name=src caps=\"\tCAPS\t\" ! audioconvert ! autoaudiosink", pGstPlayer->nBufferFrames * pAudioInfo->bpf * 2);
+    gstbase_Init(pGstPlayer->pGstBase, sCommand, FALSE, NULL, pAudioInfo);
+    g_free(sCommand);
+    g_signal_connect(pGstPlayer->pGstBase->pPipeline, "deep-element-added", G_CALLBACK(gstplayer_OnElementAdded), NULL);
+    gstbase_Play(pGstPlayer->pGstBase);
+
+    return pGstPlayer;
+}
+
+static void gstplayer_OnElementAdded(GstBin *pBin, GstBin *pSubBin, GstElement *pElement, gpointer pUserData)
+{
+    GObjectClass *pClass = G_OBJECT_GET_CLASS(pElement);
+
+    if (g_object_class_find_property(pClass, "buffer-time") != NULL && g_object_class_find_property(pClass, "latency-time") != NULL)
+    {
+        g_object_set(pElement, "buffer-time", (gint64)GSTPLAYER_SCRUB_BUFFER_TIME, "latency-time", (gint64)GSTPLAYER_SCRUB_LATENCY_TIME, NULL);
+    }
+}
     
 static void gstplayer_OnNeedData(GstElement *pElement, guint nBytes, gpointer pUserData)
 {       
     GstPlayer *pGstPlayer = (GstPlayer*)pUserData;
     guint nFramesRead = 0;
-    pGstPlayer->pOnGetFrames(pGstPlayer->lBuffer, BUFFER_SIZE / pGstPlayer->pGstBase->pAudioInfo->bpf, &nFramesRead);
+    pGstPlayer->pOnGetFrames(pGstPlayer->lBuffer, pGstPlayer->nBufferFrames, &nFramesRead);
    
     if (nFramesRead == 0)
     {
@@ -620,7 +706,7 @@ static void gstplayer_OnNeedData(GstElement *pElement, guint nBytes, gpointer pU
     }
 }
 
-static gboolean gstplayer_OnSeekData(GstElement *pElement, guint nOffset, gpointer pData)
+static gboolean gstplayer_OnSeekData(GstElement *pElement, guint64 nOffset, gpointer pData)
 {
     return TRUE;
 }
@@ -634,59 +720,251 @@ void gstplayer_Free(GstPlayer *pGstPlayer)
     pGstPlayer = NULL;
 }
 
+GstRecorder* gstrecorder_New(const gchar *sSource, GstAudioInfo *pAudioInfo, OnPutFrames pOnPutFrames)
+{
+    GError *pError = NULL;
+    GstElement *pSource = gst_parse_bin_from_description(sSource, TRUE, &pError);
+
+    if (pSource == NULL)
+    {
+        g_warning("Bad recording source %s: %s", sSource, pError ? pError->message : "");
+        g_clear_error(&pError);
+
+        return NULL;
+    }
+
+    g_clear_error(&pError);
+    gst_object_unref(pSource);
+    GstRecorder *pGstRecorder = g_malloc(sizeof(GstRecorder));
+    pGstRecorder->pGstBase = gstbase_New();
+    pGstRecorder->pGstBase->pAudioInfo = pAudioInfo;
+    pGstRecorder->pOnPutFrames = pOnPutFrames;
+    gstbase_AddSignal(pGstRecorder->pGstBase, "sink", "new-sample", G_CALLBACK(gstrecorder_OnNewSample), pGstRecorder);
+    gchar *sCommand = g_strdup_printf("%s ! audioconvert ! audioresample ! appsink name=sink caps=\"\tCAPS\t\" emit-signals=TRUE sync=FALSE", sSource);
+    gstbase_Init(pGstRecorder->pGstBase, sCommand, FALSE, NULL, pAudioInfo);
+    g_free(sCommand);
+
+    // Sources are created while the pipeline starts, so set the ones already there and catch the rest as they come
+    GstIterator *pIterator = gst_bin_iterate_recurse(GST_BIN_CAST(pGstRecorder->pGstBase->pPipeline));
+    GValue cValue = G_VALUE_INIT;
+
+    while (gst_iterator_next(pIterator, &cValue) == GST_ITERATOR_OK)
+    {
+        gstrecorder_OnElementAdded(NULL, NULL, GST_ELEMENT_CAST(g_value_get_object(&cValue)), NULL);
+        g_value_reset(&cValue);
+    }
+
+    g_value_unset(&cValue);
+    gst_iterator_free(pIterator);
+    g_signal_connect(pGstRecorder->pGstBase->pPipeline, "deep-element-added", G_CALLBACK(gstrecorder_OnElementAdded), NULL);
+    gstbase_Play(pGstRecorder->pGstBase);
+
+    return pGstRecorder;
+}
+
+static void gstrecorder_OnElementAdded(GstBin *pBin, GstBin *pSubBin, GstElement *pElement, gpointer pUserData)
+{
+    GObjectClass *pClass = G_OBJECT_GET_CLASS(pElement);
+
+    // Short periods hand the audio over quickly, the long buffer rides out a busy disk or scheduler
+    if (g_object_class_find_property(pClass, "buffer-time") != NULL && g_object_class_find_property(pClass, "latency-time") != NULL)
+    {
+        g_object_set(pElement, "buffer-time", (gint64)GSTRECORDER_BUFFER_TIME, "latency-time", (gint64)GSTRECORDER_LATENCY_TIME, NULL);
+    }
+}
+
+static GstFlowReturn gstrecorder_OnNewSample(GstAppSink *pAppSink, gpointer pUserData)
+{
+    GstRecorder *pGstRecorder = (GstRecorder*)pUserData;
+    GstSample *pSample = gst_app_sink_pull_sample(pAppSink);
+
+    if (pSample == NULL)
+    {
+        return GST_FLOW_EOS;
+    }
+
+    GstBuffer *pBuffer = gst_sample_get_buffer(pSample);
+    GstMapInfo pMapInfo;
+
+    if (gst_buffer_map(pBuffer, &pMapInfo, GST_MAP_READ))
+    {
+        pGstRecorder->pOnPutFrames((gchar*)pMapInfo.data, pMapInfo.size, GST_BUFFER_IS_DISCONT(pBuffer));
+        gst_buffer_unmap(pBuffer, &pMapInfo);
+    }
+
+    gst_sample_unref(pSample);
+
+    return GST_FLOW_OK;
+}
+
+void gstrecorder_Free(GstRecorder *pGstRecorder)
+{
+    pGstRecorder->pGstBase->pAudioInfo = NULL;
+    gstbase_Free(pGstRecorder->pGstBase);
+    pGstRecorder->pGstBase = NULL;
+    g_free(pGstRecorder);
+    pGstRecorder = NULL;
+}
+
 static void gstconverter_OnPadAdded(GstElement *pDecoder, GstPad *pPad, gpointer pData)
 {
     GstConverter *pGstConverter = (GstConverter*)pData;
+
+    if (pGstConverter->pGstBase->pAudioInfo != NULL)
+    {
+        return;
+    }
+
     GstCaps *pCaps = gst_pad_get_current_caps(pPad);
-    pGstConverter->pGstBase->pAudioInfo = gst_audio_info_new();
-    gst_audio_info_from_caps(pGstConverter->pGstBase->pAudioInfo, pCaps);
-    pGstConverter->pGstBase->pAudioInfo->layout = GST_AUDIO_LAYOUT_INTERLEAVED;   
-    GstAudioFormat nAudioFormat = gstbase_GetAudioFormat(pGstConverter->pGstBase->pAudioInfo->finfo->format);
+    GstAudioInfo *pAudioInfo = gst_audio_info_new();
+
+    if (!gst_audio_info_from_caps(pAudioInfo, pCaps))
+    {
+        gst_audio_info_free(pAudioInfo);
+        gst_caps_unref(pCaps);
+
+        return;
+    }
+
+    gst_caps_unref(pCaps);
+    pAudioInfo->layout = GST_AUDIO_LAYOUT_INTERLEAVED;
+    GstAudioFormat nAudioFormat = gstbase_GetAudioFormat(pAudioInfo->finfo->format);
 
-    if (nAudioFormat != pGstConverter->pGstBase->pAudioInfo->finfo->format)
+    if (nAudioFormat != pAudioInfo->finfo->format)
     {
         GstAudioInfo *pAudioInfoNew = gst_audio_info_new();
-        gst_audio_info_set_format(pAudioInfoNew, nAudioFormat, pGstConverter->pGstBase->pAudioInfo->rate, pGstConverter->pGstBase->pAudioInfo->channels, pGstConverter->pGstBase->pAudioInfo->position);
-        gst_audio_info_free(pGstConverter->pGstBase->pAudioInfo);
-        pGstConverter->pGstBase->pAudioInfo = pAudioInfoNew;
+        gst_audio_info_set_format(pAudioInfoNew, nAudioFormat, pAudioInfo->rate, pAudioInfo->channels, pAudioInfo->position);
+        gst_audio_info_free(pAudioInfo);
+        pAudioInfo = pAudioInfoNew;
     }
 
+    pGstConverter->pGstBase->pAudioInfo = pAudioInfo;
     gint64 nDuration = 0;
-    gst_element_query_duration(GST_ELEMENT_CAST(pGstConverter->pGstBase->pPipeline), GST_FORMAT_TIME, &nDuration);
-    pGstConverter->nFrames = GST_CLOCK_TIME_TO_FRAMES(nDuration, pGstConverter->pGstBase->pAudioInfo->rate);
-    pGstConverter->sFormat = pGstConverter->pGstBase->pAudioInfo->finfo->name;
-    gst_caps_unref(pCaps);   
-    GstBus *pBus = gst_pipeline_get_bus(pGstConverter->pGstBase->pPipeline);
-    GstMessage *pGstMessage = gst_message_new_eos(GST_OBJECT_CAST(pDecoder));
-    gst_bus_post(pBus, pGstMessage);   
-    gst_object_unref(pBus);
+
+    // The pipeline is still prerolling, so ask the stream itself first
+    if (!gst_pad_query_duration(pPad, GST_FORMAT_TIME, &nDuration) || nDuration <= 0)
+    {
+        nDuration = 0;
+        gst_element_query_duration(GST_ELEMENT_CAST(pGstConverter->pGstBase->pPipeline), GST_FORMAT_TIME, &nDuration);
+    }
+
+    pGstConverter->nFrames = GST_CLOCK_TIME_TO_FRAMES(MAX(nDuration, 0), pAudioInfo->rate);
+    pGstConverter->sFormat = pAudioInfo->finfo->name;
+
+    // The rest of the pipeline is built once the caps are known, so the temporary file can be placed by its final size
+    gint64 nBytes = (gint64)pGstConverter->nFrames * pAudioInfo->bpf;
+    GStatBuf cStat;
+
+    // Without a duration, assume the decoded audio is a fixed multiple of the compressed file, about right for lossy sources
+    if (nBytes == 0 && g_stat(pGstConverter->sFileIn, &cStat) == 0)
+    {
+        nBytes = (gint64)cStat.st_size * GSTCONVERTER_EXPANSION;
+    }
+
+    if (!scratch_HasRoom(nBytes))
+    {
+        g_atomic_int_set(&pGstConverter->bNoRoom, TRUE);
+
+        return;
+    }
+
+    gchar *sFileOut = scratch_GetFileName(nBytes);
+    gchar *sFileOutEscaped = string_Replace(sFileOut, "\"", "\\\"", FALSE);
+    gchar *sCommand = g_strdup_printf("audioconvert ! audio/x-raw, format=%s, layout=interleaved ! wavenc ! filesink location=\"%s\"", pGstConverter->sFormat, sFileOutEscaped);
+    g_free(sFileOutEscaped);
+    GError *pError = NULL;
+    GstElement *pBin = gst_parse_bin_from_description(sCommand, TRUE, &pError);
+    g_free(sCommand);
+
+    if (pBin == NULL)
+    {
+        g_warning("Could not build the conversion pipeline: %s", pError ? pError->message : "");
+        g_clear_error(&pError);
+        scratch_Unref(sFileOut);
+        g_free(sFileOut);
+
+        return;
+    }
+
+    g_clear_error(&pError);
+    gst_bin_add(GST_BIN_CAST(pGstConverter->pGstBase->pPipeline), pBin);
+    gst_element_sync_state_with_parent(pBin);
+    GstPad *pSinkPad = gst_element_get_static_pad(pBin, "sink");
+    gst_pad_link(pPad, pSinkPad);
+    gst_object_unref(pSinkPad);
+    g_atomic_pointer_set(&pGstConverter->sFileOut, sFileOut);
 }
 
 GstConverter* gstconverter_New(gchar *sFileIn, OnConvert pOnConvert, gpointer pUserData)
 {
+    gint64 nTraceStart = trace_Begin();
     GstConverter *pGstConverter = g_malloc(sizeof(GstConverter));
     pGstConverter->pGstBase = gstbase_New();
     pGstConverter->sFileIn = sFileIn;
+    pGstConverter->sFileOut = NULL;
     pGstConverter->pOnConvert = pOnConvert;
     pGstConverter->pUserData = pUserData;
     pGstConverter->nFrames = 0;
     pGstConverter->sFormat = NULL;
+    pGstConverter->bNoRoom = FALSE;
     gstbase_AddSignal(pGstConverter->pGstBase, "decode", "pad-added", G_CALLBACK(gstconverter_OnPadAdded), pGstConverter);
-    gstbase_Init(pGstConverter->pGstBase, "filesrc location=\"\tFILE\t\" ! decodebin name=decode ! audioconvert ! audio/x-raw ! fakesink", TRUE, sFileIn, NULL);
-    gstbase_Play(pGstConverter->pGstBase);
-    gstbase_Wait(pGstConverter->pGstBase);
-    gstbase_Close(pGstConverter->pGstBase);
+    if (gstbase_Init(pGstConverter->pGstBase, "filesrc location=\"\tFILE\t\" ! decodebin name=decode", FALSE, sFileIn, NULL))
+    {
+        gstconverter_Free(pGstConverter);
+        trace_End("gstconverter_New", nTraceStart);
+
+        return NULL;
+    }
+
+    GstBus *pBus = gst_pipeline_get_bus(pGstConverter->pGstBase->pPipeline);
+    gint64 nDeadline = g_get_monotonic_time() + GSTCONVERTER_PREROLL_TIME;
+
+    // A pipeline that prerolls without an audio pad, or never prerolls at all, must not keep us waiting
+    while (g_atomic_pointer_get(&pGstConverter->sFileOut) == NULL && !g_atomic_int_get(&pGstConverter->bNoRoom) && g_get_monotonic_time() < nDeadline)
+    {
+        GstMessage *pMessage = gst_bus_timed_pop_filtered(pBus, 10 * GST_MSECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_ASYNC_DONE);
+
+        if (pMessage != NULL)
+        {
+            gst_message_unref(pMessage);
+
+            break;
+        }
+    }
+
+    gst_object_unref(pBus);
+
+    if (g_atomic_pointer_get(&pGstConverter->sFileOut) == NULL)
+    {
+        if (!g_atomic_int_get(&pGstConverter->bNoRoom))
+        {
+            gstconverter_Free(pGstConverter);
+            trace_End("gstconverter_New", nTraceStart);
+
+            return NULL;
+        }
+    }
+    else
+    {
+        gint64 nRemaining = MAX(nDeadline - g_get_monotonic_time(), 0);
+        gst_element_get_state(GST_ELEMENT_CAST(pGstConverter->pGstBase->pPipeline), NULL, NULL, nRemaining * GST_USECOND);
+
+        if (pGstConverter->nFrames == 0)
+        {
+            gint64 nDuration = 0;
+            gst_element_query_duration(GST_ELEMENT_CAST(pGstConverter->pGstBase->pPipeline), GST_FORMAT_TIME, &nDuration);
+            pGstConverter->nFrames = GST_CLOCK_TIME_TO_FRAMES(nDuration, pGstConverter->pGstBase->pAudioInfo->rate);
+        }
+    }
+
+    trace_End("gstconverter_New", nTraceStart);
     
     return pGstConverter;
 }
 
-gboolean gstconverter_ConvertFile(GstConverter *pGstConverter, gchar *sFileOut)
+gboolean gstconverter_ConvertFile(GstConverter *pGstConverter)
 {
-    gchar *sFileIn = string_Replace(pGstConverter->sFileIn, "\"", "\\\"", FALSE);
-    gchar *sCommand = g_strdup_printf("filesrc location=\"%s\" ! decodebin ! audioconvert ! audio/x-raw, format=%s, layout=interleaved ! wavenc ! filesink location=\"\tFILE\t\"", sFileIn, pGstConverter->sFormat);
-    g_free(sFileIn);
-    gstbase_Init(pGstConverter->pGstBase, sCommand, TRUE, sFileOut, NULL);
-    g_free(sCommand); 
+    gint64 nTraceStart = trace_Begin();
     gstbase_Play(pGstConverter->pGstBase);
     GstBus *pBus = gst_pipeline_get_bus(pGstConverter->pGstBase->pPipeline);
     
@@ -702,17 +980,18 @@ gboolean gstconverter_ConvertFile(GstConverter *pGstConverter, gchar *sFileOut)
         }
         else
         {
-            guint nFrames = gstbase_GetPosition(pGstConverter->pGstBase);
-            
-            if (nFrames >= pGstConverter->nFrames)
+            gfloat fProgress = 0.0;
+
+            if (pGstConverter->nFrames > 0)
             {
-                break;
+                fProgress = MIN(1.0, (gfloat)gstbase_GetPosition(pGstConverter->pGstBase) / (gfloat)pGstConverter->nFrames);
             }
-            
-            if (pGstConverter->pOnConvert((gfloat)nFrames / (gfloat)pGstConverter->nFrames, pGstConverter->pUserData))
+
+            if (pGstConverter->pOnConvert(fProgress, pGstConverter->pUserData))
             {
                 gstbase_Pause(pGstConverter->pGstBase);
                 gst_object_unref(pBus);
+                trace_End("gstconverter_ConvertFile", nTraceStart);
                 
                 return TRUE;
             }
@@ -720,6 +999,8 @@ gboolean gstconverter_ConvertFile(GstConverter *pGstConverter, gchar *sFileOut)
     }
 
     gst_object_unref(pBus);
+    gstbase_Close(pGstConverter->pGstBase);
+    trace_End("gstconverter_ConvertFile", nTraceStart);
     
     return FALSE;
 }
@@ -728,12 +1009,20 @@ void gstconverter_Free(GstConverter *pGstConverter)
 {
     gstbase_Free(pGstConverter->pGstBase);
     pGstConverter->pGstBase = NULL;
+
+    if (pGstConverter->sFileOut != NULL)
+    {
+        scratch_Unref(pGstConverter->sFileOut);
+        g_free(pGstConverter->sFileOut);
+    }
+
     g_free(pGstConverter);
     pGstConverter = NULL;
 }
 
 void gstconverter_ConvertBuffer(gchar *lFloat, gchar *lByte, guint nFrames, GstAudioInfo *pAudioInfo, gboolean bFromFloat)
 { 
+    gint64 nTraceStart = trace_Begin();
     GstBase *pGstBase = gstbase_New();
     GstAudioInfo *pAudioInfoIn;
     GstAudioInfo *pAudioInfoOut;
@@ -815,4 +1104,5 @@ void gstconverter_ConvertBuffer(gchar *lFloat, gchar *lByte, guint nFrames, GstA
 
     gstbase_Free(pGstBase);
     pGstBase = NULL;
+    trace_End("gstconverter_ConvertBuffer", nTraceStart);
 }
@@ -39,8 +39,8 @@ typedef struct
   
 } GstBase;
 
-void gstbase_Seek(GstBase *pGstBase, guint nFrame);
-guint gstbase_GetPosition(GstBase *pGstBase);
+void gstbase_Seek(GstBase *pGstBase, gint64 nFrame);
+gint64 gstbase_GetPosition(GstBase *pGstBase);
 void gstbase_Close(GstBase *pGstBase);
 
 typedef struct
@@ -48,22 +48,23 @@ typedef struct
     GstBase *pGstBase;
     gchar *sFilePath;
     gfloat fDuration;
-    guint nFrames;
+    gint64 nFrames;
     
 } GstReader;
 
 GstReader* gstreader_New(gchar * sPath);
-guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, guint nStartFrame, guint nFramesToRead, gboolean bFloat);
+guint gstreader_Read(GstReader* pGstReader, gchar *lBuffer, gint64 nStartFrame, guint nFramesToRead, gboolean bFloat);
 void gstreader_Free(GstReader *pGstGstReader);
 
 typedef struct
 {
     GstBase *pGstBase;
     gchar *sFilePath;
+    gboolean bWav;
     
 } GstWriter;
 
-GstWriter* gstwriter_New(gchar *sFilePath, GstAudioInfo *pAudioInfo);
+GstWriter* gstwriter_New(gchar *sFilePath, GstAudioInfo *pAudioInfo, const gchar *sEncoder);
 guint gstwriter_Write(GstWriter *pGstWriter, guint nFrames, gchar *lBytes, gboolean bLast);
 void gstwriter_Free(GstWriter *pGstGstWriter);
 
@@ -73,21 +74,37 @@ typedef struct
 {
     GstBase *pGstBase;
     OnGetFrames pOnGetFrames;
+    guint nBufferFrames;
     gchar lBuffer[BUFFER_SIZE];
     
 } GstPlayer;
 
 GstPlayer* gstplayer_New(GstAudioInfo *pAudioInfo, OnGetFrames pOnGetFrames);
+GstPlayer* gstplayer_NewScrub(GstAudioInfo *pAudioInfo, guint nBufferFrames, OnGetFrames pOnGetFrames);
 void gstplayer_Free(GstPlayer *pGstPlayer);
 
+typedef void (*OnPutFrames)(gchar *lBuffer, guint nBytes, gboolean bDiscont);
+
+typedef struct
+{
+    GstBase *pGstBase;
+    OnPutFrames pOnPutFrames;
+    
+} GstRecorder;
+
+GstRecorder* gstrecorder_New(const gchar *sSource, GstAudioInfo *pAudioInfo, OnPutFrames pOnPutFrames);
+void gstrecorder_Free(GstRecorder *pGstRecorder);
+
 typedef gboolean (*OnConvert)(gfloat fProgress, gpointer pUserData);
 
 typedef struct
 {
     GstBase *pGstBase;
-    guint nFrames;
+    gint64 nFrames;
     gchar *sFileIn;
+    gchar *sFileOut;
     const gchar *sFormat;
+    gint bNoRoom;
     OnConvert pOnConvert;
     gpointer pUserData;
     
@@ -95,7 +112,7 @@ typedef struct
 
 GstConverter* gstconverter_New(gchar *sFileIn, OnConvert pOnConvert, gpointer pUserData);
 void gstconverter_ConvertBuffer(gchar *lFloat, gchar *lByte, guint nFrames, GstAudioInfo *pAudioInfo, gboolean bFromFloat);
-gboolean gstconverter_ConvertFile(GstConverter *pGstConverter, gchar *sFileOut);
+gboolean gstconverter_ConvertFile(GstConverter *pGstConverter);
 void gstconverter_Free(GstConverter *pGstConverter);
 
 #endif
@@ -21,13 +21,22 @@
 
 #include <glib/gi18n.h>
 #include <locale.h>
+#include <string.h>
 #include "mainwindow.h"
 #include "player.h"
 #include "main.h"
-#include <sys/stat.h>
+#include "batch.h"
+#include "bench.h"
+#include "trace.h"
+#include "counters.h"
+#include "scratch.h"
+#include "blockcache.h"
+#include "tempfile.h"
 
 gboolean g_bQuitFlag;
 gboolean g_bIdleWork;
+gboolean g_bBatch = FALSE;
+GThread *g_pMainThread = NULL;
 GSettings *g_pGSettings;
 GdkRGBA g_lColours[LAST_COLOR];
 
@@ -83,7 +92,7 @@ void mainLoop()
         return;
     }
 
-    if (mainwindow_UpdateCaches())
+    if (document_Consolidate())
     {
         return;
     }
@@ -91,6 +100,26 @@ void mainLoop()
     gtk_main_iteration();
 }
 
+// Look the schema up rather than assume it, so batch runs from a build tree still work
+GSettings *getSettings(const gchar *sKey)
+{
+    GSettingsSchemaSource *pSchemaSource = g_settings_schema_source_get_default();
+    GSettingsSchema *pSchema = pSchemaSource ? g_settings_schema_source_lookup(pSchemaSource, "in.tari.odio-edit", TRUE) : NULL;
+    GSettings *pSettings = NULL;
+
+    if (pSchema != NULL)
+    {
+        if (g_settings_schema_has_key(pSchema, sKey))
+        {
+            pSettings = g_settings_new("in.tari.odio-edit");
+        }
+
+        g_settings_schema_unref(pSchema);
+    }
+
+    return pSettings;
+}
+
     static void onColorSchemeChanged (GSettings *pSettings, const gchar *sKey, gpointer pData)
     {
         gchar *sColorScheme = g_settings_get_string (pSettings, sKey);
@@ -106,21 +135,100 @@ void mainLoop()
     
 gint main(gint argc, gchar **argv)
 {
+    g_pMainThread = g_thread_self();
     setlocale(LC_ALL, "");
     setlocale(LC_NUMERIC, "POSIX");
     gtk_disable_setlocale();
     bindtextdomain("odio-edit", LOCALEDIR);
     textdomain("odio-edit");
     bind_textdomain_codeset("odio-edit", "UTF-8");
+    trace_Init();
+    counters_Init();
+    gboolean bCounters = FALSE;
+
+    for (gint nArg = 1; nArg < argc; nArg++)
+    {
+        if (g_str_equal(argv[nArg], "--counters"))
+        {
+            bCounters = TRUE;
+            memmove(&argv[nArg], &argv[nArg + 1], (argc - nArg) * sizeof(gchar*));
+            argc--;
+
+            break;
+        }
+    }
+
+    gboolean bBatch = argc > 2 && g_str_equal(argv[1], "--batch");
+    gboolean bBench = argc > 1 && g_str_equal(argv[1], "--bench");
+
+    if (bBatch || bBench)
+    {
+        g_bBatch = TRUE;
+        gst_init(&argc, &argv);
+
+        if (scratch_Init())
+        {
+            scratch_Free();
+
+            return 1;
+        }
+
+        blockcache_Init();
+        tempfile_LoadSettings();
+        gint nResult;
+
+        if (bBatch)
+        {
+            nResult = batch_Run(argv[2], argv + 3, argc - 3);
+        }
+        else
+        {
+            nResult = bench_Run(argc > 2 ? argv[2] : "quick", argc > 3 ? argv[3] : NULL);
+        }
+
+        trace_Finish();
+
+        if (bCounters)
+        {
+            counters_Dump();
+        }
+
+        g_info("chunk_AliveCount: %d", chunk_AliveCount());
+        g_info("datasource_Count: %d", datasource_Count());
+        g_info("scratch_Count: %d", scratch_Count());
+
+        g_assert (chunk_AliveCount() == 0 && datasource_Count() == 0);
+
+        blockcache_Free();
+        scratch_Free();
+
+        return nResult;
+    }
+
     gtk_init(&argc, &argv);
     gst_init(&argc, &argv);
     GSettings *pGnomeSettings = g_settings_new ("org.gnome.desktop.interface");
     g_signal_connect (pGnomeSettings, "changed::color-scheme", G_CALLBACK (onColorSchemeChanged), NULL);
     onColorSchemeChanged (pGnomeSettings, "color-scheme", NULL);
-    mkdir("/tmp/odio-edit", 0755);
+
+    if (scratch_Init())
+    {
+        scratch_Free();
+        g_clear_object (&pGnomeSettings);
+
+        return 1;
+    }
+
+    blockcache_Init();
+    tempfile_LoadSettings();
     g_log_set_handler(G_LOG_DOMAIN, G_LOG_LEVEL_MASK, g_log_default_handler, NULL);
-    g_pFileFilterWav = gtk_file_filter_new();
-    gtk_file_filter_add_pattern(g_pFileFilterWav, "*.[Ww][Aa][Vv]");
+    g_pFileFilterSave = gtk_file_filter_new();
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Ww][Aa][Vv]");
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Ff][Ll][Aa][Cc]");
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Oo][Gg][Gg]");
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Oo][Gg][Aa]");
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Oo][Pp][Uu][Ss]");
+    gtk_file_filter_add_pattern(g_pFileFilterSave, "*.[Mm][Pp]3");
     g_pFileFilter = gtk_file_filter_new();
 
     for (gint nPattern = 0; nPattern < g_strv_length(PATTERNS); nPattern++)
@@ -161,6 +269,12 @@ gint main(gint argc, gchar **argv)
     }
 
     player_Stop ();
+    trace_Finish();
+
+    if (bCounters)
+    {
+        counters_Dump();
+    }
 
     if (g_pPlayingDocument != NULL)
     {
@@ -178,9 +292,13 @@ gint main(gint argc, gchar **argv)
 
     g_info("chunk_AliveCount: %d", chunk_AliveCount());
     g_info("datasource_Count: %d", datasource_Count());
+    g_info("scratch_Count: %d", scratch_Count());
     
     g_assert (chunk_AliveCount() == 0 && datasource_Count() == 0);
 
+    blockcache_Free();
+    scratch_Free();
+
     return 0;
 }
 
@@ -33,10 +33,13 @@ enum Colours {TEXT, SCALE, BACKGROUND, WAVE1, WAVE2, CURSOR, STRIPE, SELECTION,
 
 extern gboolean g_bQuitFlag;
 extern gboolean g_bIdleWork;
+extern gboolean g_bBatch;
+extern GThread *g_pMainThread;
 extern GdkRGBA g_lColours[LAST_COLOR];
 extern GSettings *g_pGSettings;
 
 gboolean checkExtension(GtkFileFilter *pFileFilter, gchar *sFilePath);
 gchar *getTime(guint32 nSampleRate, gint64 nFrames, gchar *sTime, gboolean bFull);
+GSettings *getSettings(const gchar *sKey);
 void mainLoop();
 #endif
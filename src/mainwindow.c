@@ -25,10 +25,16 @@
 #include "message.h"
 #include "main.h"
 #include "player.h"
+#include "counters.h"
+#include "export.h"
+#include "record.h"
+
+#define MAINWINDOW_RESPONSE_DUMP 1
 
 G_DEFINE_TYPE(MainWindow, mainwindow, GTK_TYPE_WINDOW)
 
 static MainWindow *mainwindow_SetDocument(MainWindow *pMainWindow, Document *pDocument, gchar *sFilePath);
+static MainWindow *mainwindow_SetChunk(MainWindow *pMainWindow, Chunk *pChunk);
 static void mainwindow_OnViewChanged(Document *pDocument, MainWindow *pMainWindow);
 static void mainwindow_OnSelectionChanged(Document *pDocument, MainWindow *pMainWindow);
 static void mainwindow_OnCursorChanged(Document *pDocument, gboolean bRolling, MainWindow *pMainWindow);
@@ -41,14 +47,23 @@ static void mainwindow_OnPlaySelection(GtkMenuItem *pMenuItem, MainWindow *pMain
 static void mainwindow_OnStop(GtkMenuItem *pMenuItem, MainWindow *pMainWindow);
 static void mainwindow_OnClose(GtkMenuItem *pMenuItem, gpointer pUserData);
 static void mainwindow_AddRecentFile(gchar *sFilePath);
+static void mainwindow_ApplyPreview(MainWindow *pMainWindow, PlayerPreview *pPreview);
 static GList *m_lstRecentFilenames = NULL;
 static Chunk *m_pClipboard = NULL;
 static gboolean m_bZooming = FALSE;
+static GtkWidget *m_pCountersDialog = NULL;
+static GtkLabel *m_pCountersLabel = NULL;
+static guint m_nCountersSource = 0;
+static CountersSnapshot m_cCountersSnapshot;
+static MainWindow *m_pRecordWindow = NULL;
+static Document *m_pRecordDocument = NULL;
+static Chunk *m_pRecordChunk = NULL;
+static gfloat m_fGainFactor = 1.0;
 guint m_nStatusBarsWorking = 0;
 GList *g_lMainWindows = NULL;
 MainWindow *g_pFocusedWindow = NULL;
 GtkFileFilter *g_pFileFilter = NULL;
-GtkFileFilter *g_pFileFilterWav = NULL;
+GtkFileFilter *g_pFileFilterSave = NULL;
 
 struct GetFileName
 {
@@ -67,10 +82,10 @@ static void mainwindow_OnGetFileName(GtkDialog *pDialog, gint nResponse, gpointe
 
         if (strFilename != NULL)
         {
-            if (!g_str_has_suffix(strFilename, ".wav"))
+            if (!export_GetEncoder(strFilename))
             {
                 g_free(strFilename);
-                message_Warning(_("The file extension should be \".wav\""));
+                message_Warning(_("The file extension should be \".wav\", \".flac\", \".ogg\", \".oga\", \".opus\" or \".mp3\""));
 
                 return;
             }
@@ -96,8 +111,8 @@ static gchar *mainwindow_GetFileName(gchar *sCurrentName, gchar *sTitle, gboolea
     }
     else
     {
-        g_object_ref_sink(g_pFileFilterWav);
-        gtk_file_chooser_set_filter(pFileChooser, g_pFileFilterWav);
+        g_object_ref_sink(g_pFileFilterSave);
+        gtk_file_chooser_set_filter(pFileChooser, g_pFileFilterSave);
         gtk_file_chooser_set_do_overwrite_confirmation(pFileChooser, TRUE);
     }
 
@@ -116,7 +131,7 @@ static gchar *mainwindow_GetFileName(gchar *sCurrentName, gchar *sTitle, gboolea
 
             if (sBaseName)
             {
-                if (!checkExtension(g_pFileFilterWav, sBaseName))
+                if (!checkExtension(g_pFileFilterSave, sBaseName))
                 {
                     if (checkExtension(g_pFileFilter, sBaseName))
                     {
@@ -248,6 +263,21 @@ gboolean mainwindow_Progress(MainWindow *pMainWindow, gfloat fProgress)
     return pMainWindow->bStatusBarBreak;
 }
 
+static void mainwindow_OnProgressBegin(gchar *sDescription, gpointer pUserData)
+{
+    mainwindow_BeginProgress(OE_MAINWINDOW(pUserData), sDescription);
+}
+
+static gboolean mainwindow_OnProgress(gfloat fProgress, gpointer pUserData)
+{
+    return mainwindow_Progress(OE_MAINWINDOW(pUserData), fProgress);
+}
+
+static void mainwindow_OnProgressEnd(gpointer pUserData)
+{
+    mainwindow_EndProgress(OE_MAINWINDOW(pUserData));
+}
+
 static void mainwindow_OnWidgetDestroy(GtkWidget *pWidget, GList **pList)
 {
     *pList = g_list_remove(*pList, pWidget);
@@ -453,14 +483,32 @@ void mainwindow_SetStatusBarInfo(MainWindow *pMainWindow, gint64 nCursorPos, gbo
     }
 }
 
+static void mainwindow_ClearAnalysis(MainWindow *pMainWindow)
+{
+    if (pMainWindow->pAnalysisChunk)
+    {
+        g_info("chunk_unref: %d, mainwindow:mainwindow_ClearAnalysis %p", chunk_AliveCount(), pMainWindow->pAnalysisChunk);
+        g_object_unref(pMainWindow->pAnalysisChunk);
+        pMainWindow->pAnalysisChunk = NULL;
+        gtk_widget_set_visible(GTK_WIDGET(pMainWindow->pLabelAnalysis), FALSE);
+    }
+}
+
 static void mainwindow_UpdateDesc(MainWindow *pMainWindow)
 {
     if (pMainWindow->pDocument != NULL)
     {
+        // The figures only stay up while they still describe what is on screen
+        if (pMainWindow->pAnalysisChunk != pMainWindow->pDocument->pChunk || pMainWindow->nAnalysisSelStart != pMainWindow->pDocument->nSelStart || pMainWindow->nAnalysisSelEnd != pMainWindow->pDocument->nSelEnd)
+        {
+            mainwindow_ClearAnalysis(pMainWindow);
+        }
+
         mainwindow_SetStatusBarInfo(pMainWindow, pMainWindow->pDocument->nCursorPos, (g_pPlayingDocument == pMainWindow->pDocument), pMainWindow->pDocument->nViewStart, pMainWindow->pDocument->nViewEnd,pMainWindow->pDocument->nSelStart, pMainWindow->pDocument->nSelEnd, pMainWindow->pDocument->pChunk->pAudioInfo->rate, pMainWindow->pDocument->pChunk->nFrames);
     }
     else
     {
+        mainwindow_ClearAnalysis(pMainWindow);
         mainwindow_ResetStatusBar(pMainWindow);
     }
 }
@@ -552,7 +600,7 @@ static gboolean mainwindow_Save(MainWindow *pMainWindow, gchar *sFilePath)
     {
         bGetSaveFileName = TRUE;
     }
-    else if (!checkExtension(g_pFileFilterWav, sFilePath))
+    else if (!checkExtension(g_pFileFilterSave, sFilePath))
     {
         g_free(sFilePath);
         bGetSaveFileName = TRUE;
@@ -631,6 +679,7 @@ static void mainwindow_OnDestroy(GtkWidget *pWidget)
     g_info("mainwindow_OnDestroy");
     MainWindow *pMainWindow = OE_MAINWINDOW(pWidget);
     g_lMainWindows = g_list_remove(g_lMainWindows, pWidget);
+    mainwindow_ClearAnalysis(pMainWindow);
 
     if (pMainWindow->pDocument != NULL)
     {
@@ -642,6 +691,8 @@ static void mainwindow_OnDestroy(GtkWidget *pWidget)
 
     if (g_list_length(g_lMainWindows) == 0)
     {
+        record_Stop();
+
         if (m_pClipboard)
         {
             g_info("chunk_unref: %d, mainwindow:mainwindow_OnDestroy %p", chunk_AliveCount(), m_pClipboard);
@@ -660,6 +711,12 @@ static gint mainwindow_OnDeleteEvent(GtkWidget *pWidget, GdkEventAny *pEventAny)
     MainWindow *pMainWindow = OE_MAINWINDOW(pWidget);
     GtkWidgetClass *pWidgetClass = GTK_WIDGET_CLASS(mainwindow_parent_class);
 
+    // Finish the take first, so the save question covers all of it
+    if (m_pRecordDocument != NULL && m_pRecordDocument == pMainWindow->pDocument)
+    {
+        record_Stop();
+    }
+
     if (mainwindow_ChangeCheck(pMainWindow))
     {
         return TRUE;
@@ -700,6 +757,60 @@ static void mainwindow_Play(MainWindow *pMainWindow, gint64 nStart, gint64 nEnd)
     mainwindow_UpdateDesc(pMainWindow);
 }
 
+static gboolean mainwindow_OnCountersTimeout(gpointer pUserData)
+{
+    CountersSnapshot cSnapshot;
+    counters_Snapshot(&cSnapshot);
+    gchar *sText = counters_Format(&cSnapshot, &m_cCountersSnapshot);
+    gtk_label_set_text(m_pCountersLabel, sText);
+    g_free(sText);
+    m_cCountersSnapshot = cSnapshot;
+
+    return TRUE;
+}
+
+static void mainwindow_OnCountersResponse(GtkDialog *pDialog, gint nResponse, gpointer pUserData)
+{
+    if (nResponse == MAINWINDOW_RESPONSE_DUMP)
+    {
+        counters_Dump();
+    }
+    else
+    {
+        gtk_widget_destroy(GTK_WIDGET(pDialog));
+    }
+}
+
+static void mainwindow_OnCountersDestroy(GtkWidget *pWidget, gpointer pUserData)
+{
+    g_source_remove(m_nCountersSource);
+    m_nCountersSource = 0;
+    m_pCountersDialog = NULL;
+    m_pCountersLabel = NULL;
+}
+
+static void mainwindow_ToggleCounters(MainWindow *pMainWindow)
+{
+    if (m_pCountersDialog != NULL)
+    {
+        gtk_widget_destroy(m_pCountersDialog);
+
+        return;
+    }
+
+    m_pCountersDialog = gtk_dialog_new_with_buttons(_("Performance counters"), GTK_WINDOW(pMainWindow), GTK_DIALOG_DESTROY_WITH_PARENT, _("Dump to stdout"), MAINWINDOW_RESPONSE_DUMP, _("Close"), GTK_RESPONSE_CLOSE, NULL);
+    m_pCountersLabel = GTK_LABEL(gtk_widget_new(GTK_TYPE_LABEL, "margin", 10, "xalign", 0.0, "selectable", TRUE, NULL));
+    gtk_container_add(GTK_CONTAINER(gtk_dialog_get_content_area(GTK_DIALOG(m_pCountersDialog))), GTK_WIDGET(m_pCountersLabel));
+    g_signal_connect(m_pCountersDialog, "response", G_CALLBACK(mainwindow_OnCountersResponse), NULL);
+    g_signal_connect(m_pCountersDialog, "destroy", G_CALLBACK(mainwindow_OnCountersDestroy), NULL);
+    counters_Snapshot(&m_cCountersSnapshot);
+    gchar *sText = counters_Format(&m_cCountersSnapshot, NULL);
+    gtk_label_set_text(m_pCountersLabel, sText);
+    g_free(sText);
+    m_nCountersSource = g_timeout_add(1000, mainwindow_OnCountersTimeout, NULL);
+    gtk_widget_show_all(m_pCountersDialog);
+}
+
 static gint mainwindow_OnKeyPress(GtkWidget *pWidget, GdkEventKey *pEventKey)
 {
     MainWindow *pMainWindow = OE_MAINWINDOW(pWidget);
@@ -714,11 +825,40 @@ static gint mainwindow_OnKeyPress(GtkWidget *pWidget, GdkEventKey *pEventKey)
         return TRUE;
     }
 
+    if (pEventKey->keyval == GDK_KEY_F12)
+    {
+        mainwindow_ToggleCounters(pMainWindow);
+
+        return TRUE;
+    }
+
     if (pMainWindow->pDocument == NULL)
     {
         return GTK_WIDGET_CLASS(mainwindow_parent_class)->key_press_event(pWidget, pEventKey);
     }
 
+    PlayerPreview cPreview;
+
+    // While auditioning, Up and Down change the level in 1 dB steps and Enter renders what is heard
+    if (g_pPlayingDocument == pMainWindow->pDocument && player_GetPreview(&cPreview))
+    {
+        if (pEventKey->keyval == GDK_KEY_Up || pEventKey->keyval == GDK_KEY_Down)
+        {
+            gfloat fFactor = powf(10.0, ((pEventKey->keyval == GDK_KEY_Up) ? 1.0 : -1.0) / 20.0);
+            cPreview.fStartFactor *= fFactor;
+            cPreview.fEndFactor *= fFactor;
+            player_SetPreview(&cPreview);
+
+            return TRUE;
+        }
+        else if (pEventKey->keyval == GDK_KEY_Return || pEventKey->keyval == GDK_KEY_KP_Enter)
+        {
+            mainwindow_ApplyPreview(pMainWindow, &cPreview);
+
+            return TRUE;
+        }
+    }
+
     switch (pEventKey->keyval)
     {
         case GDK_KEY_KP_Add:
@@ -891,14 +1031,13 @@ static void mainwindow_OnSaveSelection(GtkMenuItem *pMenuItem, MainWindow *pMain
         return;
     }
 
-    Chunk *pChunk = chunk_GetPart(pMainWindow->pDocument->pChunk, pMainWindow->pDocument->nSelStart, pMainWindow->pDocument->nSelEnd - pMainWindow->pDocument->nSelStart);
+    ExportRegion cRegion = {pMainWindow->pDocument->nSelStart, pMainWindow->pDocument->nSelEnd - pMainWindow->pDocument->nSelStart, sFileName};
 
-    if (!chunk_Save(pChunk, sFileName, pMainWindow))
+    if (!export_Regions(pMainWindow->pDocument->pChunk, &cRegion, 1, &pMainWindow->cProgress))
     {
         g_settings_set_string(g_pGSettings, "last-saved", sFileName);
     }
 
-    g_object_unref(pChunk);
     g_free(sFileName);
 }
 
@@ -1048,7 +1187,7 @@ static void mainwindow_OnMixPaste(GtkMenuItem *pMenuItem, MainWindow *pMainWindo
 
     Chunk *pChunkPart = chunk_GetPart(pMainWindow->pDocument->pChunk, pMainWindow->pDocument->nCursorPos, m_pClipboard->nFrames);
     gint64 nPartFrames = pChunkPart->nFrames;
-    Chunk *pChunkMixed = chunk_Mix(pChunkPart, m_pClipboard, pMainWindow);
+    Chunk *pChunkMixed = chunk_Mix(pChunkPart, m_pClipboard, &pMainWindow->cProgress);
     g_object_unref(pChunkPart);
 
     if (!pChunkMixed)
@@ -1088,49 +1227,85 @@ static void mainwindow_OnZoomOut(GtkMenuItem *pMenuItem, gpointer pUserData)
 
 static void mainwindow_OnStop(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
 {
+    record_Stop();
     document_Stop(pMainWindow->pDocument);
 }
 
-gboolean mainwindow_UpdateCaches()
+static void mainwindow_OnRecorded(Chunk *pChunk, gboolean bFinished, gpointer pUserData)
 {
-    static guint nLast = 0;
-    MainWindow *pMainWindow;
-    guint nMainWindows = g_list_length(g_lMainWindows);
+    if (pChunk != NULL && g_lMainWindows == NULL)
+    {
+        g_info("chunk_unref: %d, mainwindow:mainwindow_OnRecorded %p", chunk_AliveCount(), pChunk);
+        g_object_unref(pChunk);
+        pChunk = NULL;
+    }
 
-    if (nMainWindows == 0)
+    if (pChunk != NULL && m_pRecordDocument != NULL)
     {
-        return FALSE;
+        g_object_ref(pChunk);
+        document_Grow(m_pRecordDocument, m_pRecordChunk, pChunk);
+        g_object_unref(m_pRecordChunk);
+        m_pRecordChunk = pChunk;
     }
+    else if (pChunk != NULL && (m_pRecordChunk == NULL || bFinished))
+    {
+        // The first take opens a document, so does the finished one if that document was closed meanwhile
+        MainWindow *pMainWindow = m_pRecordWindow ? m_pRecordWindow : OE_MAINWINDOW(g_lMainWindows->data);
+
+        if (m_pRecordChunk != NULL)
+        {
+            g_object_unref(m_pRecordChunk);
+        }
 
-    if (nLast >= nMainWindows)
+        m_pRecordChunk = g_object_ref(pChunk);
+        pMainWindow = mainwindow_SetChunk(pMainWindow, pChunk);
+        m_pRecordDocument = pMainWindow->pDocument;
+        g_object_add_weak_pointer(G_OBJECT(m_pRecordDocument), (gpointer*)&m_pRecordDocument);
+    }
+    else if (pChunk != NULL)
     {
-        nLast = 0;
+        g_info("chunk_unref: %d, mainwindow:mainwindow_OnRecorded %p", chunk_AliveCount(), pChunk);
+        g_object_unref(pChunk);
     }
 
-    guint nCurrent = nLast + 1;
+    if (!bFinished)
+    {
+        return;
+    }
 
-    while (1)
+    if (m_pRecordDocument != NULL)
     {
-        if (nCurrent >= nMainWindows)
-        {
-            nCurrent = 0;
-        }
+        g_object_remove_weak_pointer(G_OBJECT(m_pRecordDocument), (gpointer*)&m_pRecordDocument);
+        m_pRecordDocument = NULL;
+    }
 
-        pMainWindow = OE_MAINWINDOW(g_list_nth_data(g_lMainWindows, nCurrent));
+    if (m_pRecordWindow != NULL)
+    {
+        g_object_remove_weak_pointer(G_OBJECT(m_pRecordWindow), (gpointer*)&m_pRecordWindow);
+        m_pRecordWindow = NULL;
+    }
 
-        if (chunkview_UpdateCache(pMainWindow->pChunkView))
-        {
-            nLast = nCurrent;
+    if (m_pRecordChunk != NULL)
+    {
+        g_info("chunk_unref: %d, mainwindow:mainwindow_OnRecorded %p", chunk_AliveCount(), m_pRecordChunk);
+        g_object_unref(m_pRecordChunk);
+        m_pRecordChunk = NULL;
+    }
+}
 
-            return TRUE;
-        }
+static void mainwindow_OnRecord(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    if (record_Recording())
+    {
+        record_Stop();
 
-        if (nCurrent == nLast)
-        {
-            return FALSE;
-        }
+        return;
+    }
 
-        nCurrent++;
+    if (!record_Start(mainwindow_OnRecorded, NULL))
+    {
+        m_pRecordWindow = pMainWindow;
+        g_object_add_weak_pointer(G_OBJECT(m_pRecordWindow), (gpointer*)&m_pRecordWindow);
     }
 }
 
@@ -1144,19 +1319,132 @@ static void mainwindow_OnPlayAll(GtkMenuItem *pMenuItem, MainWindow *pMainWindow
     mainwindow_Play(pMainWindow, 0, pMainWindow->pDocument->pChunk->nFrames);
 }
 
+static void mainwindow_OnLoop(GtkCheckMenuItem *pCheckMenuItem, MainWindow *pMainWindow)
+{
+    player_SetLoop(gtk_check_menu_item_get_active(pCheckMenuItem));
+}
+
 static void mainwindow_OnPlay(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
 {
     mainwindow_Play(pMainWindow, pMainWindow->pDocument->nCursorPos, pMainWindow->pDocument->pChunk->nFrames);
 }
 
-static Chunk *mainwindow_FadeIn(Chunk *pChunk, MainWindow *pMainWindow)
+static Chunk *mainwindow_FadeIn(Chunk *pChunk, Progress *pProgress)
 {
-    return chunk_Fade(pChunk, 0.0, 1.0, pMainWindow);
+    return chunk_Fade(pChunk, 0.0, 1.0, pProgress);
 }
 
-static Chunk *mainwindow_FadeOut(Chunk *pChunk, MainWindow *pMainWindow)
+static Chunk *mainwindow_FadeOut(Chunk *pChunk, Progress *pProgress)
 {
-    return chunk_Fade(pChunk, 1.0, 0.0, pMainWindow);
+    return chunk_Fade(pChunk, 1.0, 0.0, pProgress);
+}
+
+static void mainwindow_Preview(MainWindow *pMainWindow, gfloat fStartFactor, gfloat fEndFactor, Chunk *pMixChunk)
+{
+    Document *pDocument = pMainWindow->pDocument;
+    PlayerPreview cPreview;
+
+    if (pMixChunk != NULL)
+    {
+        cPreview.nStart = pDocument->nCursorPos;
+        cPreview.nFrames = MIN(pMixChunk->nFrames, pDocument->pChunk->nFrames - pDocument->nCursorPos);
+    }
+    else if (pDocument->nSelStart != pDocument->nSelEnd)
+    {
+        cPreview.nStart = pDocument->nSelStart;
+        cPreview.nFrames = pDocument->nSelEnd - pDocument->nSelStart;
+    }
+    else
+    {
+        cPreview.nStart = 0;
+        cPreview.nFrames = pDocument->pChunk->nFrames;
+    }
+
+    if (cPreview.nFrames <= 0)
+    {
+        return;
+    }
+
+    cPreview.fStartFactor = fStartFactor;
+    cPreview.fEndFactor = fEndFactor;
+    cPreview.pMixChunk = pMixChunk;
+    document_PlayPreview(pDocument, &cPreview);
+}
+
+static void mainwindow_OnPreviewFadeIn(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    mainwindow_Preview(pMainWindow, 0.0, 1.0, NULL);
+}
+
+static void mainwindow_OnPreviewFadeOut(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    mainwindow_Preview(pMainWindow, 1.0, 0.0, NULL);
+}
+
+static void mainwindow_OnPreviewGain(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    mainwindow_Preview(pMainWindow, 1.0, 1.0, NULL);
+}
+
+static void mainwindow_OnPreviewMixPaste(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    if (pMainWindow->pDocument == NULL || m_pClipboard == NULL)
+    {
+        return;
+    }
+
+    if (gst_audio_info_is_equal(pMainWindow->pDocument->pChunk->pAudioInfo, m_pClipboard->pAudioInfo) == FALSE)
+    {
+        message_Warning(_("You cannot mix different sound formats"));
+
+        return;
+    }
+
+    mainwindow_Preview(pMainWindow, 1.0, 1.0, m_pClipboard);
+}
+
+static void mainwindow_ApplyPreview(MainWindow *pMainWindow, PlayerPreview *pPreview)
+{
+    Document *pDocument = pMainWindow->pDocument;
+
+    if (pPreview->pMixChunk != NULL)
+    {
+        g_object_ref(pPreview->pMixChunk);
+    }
+
+    document_Stop(pDocument);
+    Chunk *pChunkPart = chunk_GetPart(pDocument->pChunk, pPreview->nStart, pPreview->nFrames);
+
+    if (pPreview->fStartFactor != 1.0 || pPreview->fEndFactor != 1.0)
+    {
+        Chunk *pChunkFaded = chunk_Fade(pChunkPart, pPreview->fStartFactor, pPreview->fEndFactor, &pMainWindow->cProgress);
+        g_object_unref(pChunkPart);
+        pChunkPart = pChunkFaded;
+    }
+
+    if (pChunkPart != NULL && pPreview->pMixChunk != NULL)
+    {
+        Chunk *pChunkMixed = chunk_Mix(pChunkPart, pPreview->pMixChunk, &pMainWindow->cProgress);
+        g_object_unref(pChunkPart);
+        pChunkPart = pChunkMixed;
+    }
+
+    if (pPreview->pMixChunk != NULL)
+    {
+        g_object_unref(pPreview->pMixChunk);
+    }
+
+    if (pChunkPart == NULL)
+    {
+        return;
+    }
+
+    gint64 nAppliedFrames = pChunkPart->nFrames;
+    Chunk *pChunk = chunk_ReplacePart(pDocument->pChunk, pPreview->nStart, pPreview->nFrames, pChunkPart);
+    g_object_unref(pChunkPart);
+
+    document_Update(pDocument, pChunk, 0, 0);
+    document_SetSelection(pDocument, pPreview->nStart, pPreview->nStart + nAppliedFrames);
 }
 
 static void mainwindow_OnAboutResponse(GtkDialog *pDialog, gint nResponse, gpointer pUserData)
@@ -1210,6 +1498,205 @@ static void mainwindow_OnFadeOut(GtkMenuItem *pMenuItem, MainWindow *pMainWindow
     document_ApplyChunkFunc(pMainWindow->pDocument, mainwindow_FadeOut);
 }
 
+static void mainwindow_SetAnalysis(MainWindow *pMainWindow, Chunk *pChunk, Analysis *pAnalysis)
+{
+    gchar sText[256];
+    g_snprintf(sText, sizeof(sText), "<span font-weight=\"bold\">%s:</span> %.1f LUFS, %.1f dBTP", _("Loudness"), pAnalysis->fIntegrated, pAnalysis->fTruePeak);
+    gtk_label_set_markup(pMainWindow->pLabelAnalysis, sText);
+    g_snprintf(sText, sizeof(sText), _("Integrated: %.1f LUFS\nShort-term max: %.1f LUFS\nTrue peak: %.1f dBTP\nSample peak: %.1f dBFS\nRMS: %.1f dBFS\nDC offset: %.3f%%"), pAnalysis->fIntegrated, pAnalysis->fShortTermMax, pAnalysis->fTruePeak, pAnalysis->fSamplePeak, pAnalysis->fRms, pAnalysis->fDcOffset);
+    gtk_widget_set_tooltip_text(GTK_WIDGET(pMainWindow->pLabelAnalysis), sText);
+    mainwindow_ClearAnalysis(pMainWindow);
+    pMainWindow->pAnalysisChunk = g_object_ref(pChunk);
+    pMainWindow->nAnalysisSelStart = pMainWindow->pDocument->nSelStart;
+    pMainWindow->nAnalysisSelEnd = pMainWindow->pDocument->nSelEnd;
+    pMainWindow->cAnalysis = *pAnalysis;
+    gtk_widget_set_visible(GTK_WIDGET(pMainWindow->pLabelAnalysis), TRUE);
+}
+
+static gboolean mainwindow_Analyse(MainWindow *pMainWindow, Analysis *pAnalysis)
+{
+    Document *pDocument = pMainWindow->pDocument;
+
+    // What the status bar shows still describes the selection, so there is nothing to read again
+    if (pMainWindow->pAnalysisChunk == pDocument->pChunk && pMainWindow->nAnalysisSelStart == pDocument->nSelStart && pMainWindow->nAnalysisSelEnd == pDocument->nSelEnd)
+    {
+        *pAnalysis = pMainWindow->cAnalysis;
+
+        return FALSE;
+    }
+
+    gint64 nStartFrame = 0;
+    gint64 nFrames = pDocument->pChunk->nFrames;
+
+    if (pDocument->nSelStart != pDocument->nSelEnd)
+    {
+        nStartFrame = pDocument->nSelStart;
+        nFrames = pDocument->nSelEnd - pDocument->nSelStart;
+    }
+
+    // The window may be closed from the progress bar while the analysis runs
+    Chunk *pChunk = g_object_ref(pDocument->pChunk);
+    g_object_ref(pMainWindow);
+    gboolean bError = analysis_Run(pChunk, nStartFrame, nFrames, pAnalysis, &pMainWindow->cProgress) || pMainWindow->pDocument != pDocument || pDocument->pChunk != pChunk;
+
+    if (!bError)
+    {
+        mainwindow_SetAnalysis(pMainWindow, pChunk, pAnalysis);
+    }
+
+    g_object_unref(pMainWindow);
+    g_object_unref(pChunk);
+
+    return bError;
+}
+
+static void mainwindow_OnAnalyse(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    Analysis cAnalysis;
+    mainwindow_Analyse(pMainWindow, &cAnalysis);
+}
+
+static Chunk *mainwindow_Gain(Chunk *pChunk, Progress *pProgress)
+{
+    return chunk_Gain(pChunk, m_fGainFactor, pProgress);
+}
+
+static void mainwindow_Normalize(MainWindow *pMainWindow, AnalysisTarget nTarget, gchar *sKey)
+{
+    Analysis cAnalysis;
+
+    if (mainwindow_Analyse(pMainWindow, &cAnalysis))
+    {
+        return;
+    }
+
+    gboolean bLimited;
+    gdouble fCeiling = g_settings_get_double(g_pGSettings, "normalize-ceiling");
+
+    if (analysis_GetGain(&cAnalysis, nTarget, g_settings_get_double(g_pGSettings, sKey), fCeiling, &m_fGainFactor, &bLimited))
+    {
+        message_Warning(_("The audio is silent and cannot be normalised"));
+
+        return;
+    }
+
+    if (fabsf(m_fGainFactor - 1.0) > MAINWINDOW_GAIN_EPSILON)
+    {
+        document_ApplyChunkFunc(pMainWindow->pDocument, mainwindow_Gain);
+    }
+
+    if (bLimited)
+    {
+        // Translators: %.1f are a loudness in LUFS and a peak level in dBTP
+        gchar *sMessage = g_strdup_printf(_("The gain was limited to keep the peak at %.1f dBTP, the audio is now %.1f LUFS"), fCeiling, cAnalysis.fIntegrated + 20.0 * log10(m_fGainFactor));
+        message_Warning(sMessage);
+        g_free(sMessage);
+    }
+}
+
+static void mainwindow_OnNormalizePeak(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    mainwindow_Normalize(pMainWindow, ANALYSIS_TARGET_PEAK, "normalize-peak");
+}
+
+static void mainwindow_OnNormalizeLoudness(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    mainwindow_Normalize(pMainWindow, ANALYSIS_TARGET_LOUDNESS, "normalize-loudness");
+}
+
+static void mainwindow_OnNormalizeAll(GtkMenuItem *pMenuItem, MainWindow *pMainWindow)
+{
+    GList *lDocuments = NULL;
+
+    for (GList *l = g_lMainWindows; l != NULL; l = l->next)
+    {
+        Document *pDocument = OE_MAINWINDOW(l->data)->pDocument;
+
+        if (pDocument != NULL && pDocument != m_pRecordDocument)
+        {
+            lDocuments = g_list_append(lDocuments, g_object_ref(pDocument));
+        }
+    }
+
+    guint nDocuments = g_list_length(lDocuments);
+    AnalysisRegion *lRegions = g_new0(AnalysisRegion, nDocuments);
+    Analysis **lAnalyses = g_new(Analysis*, nDocuments);
+    guint nRegions = 0;
+    guint nDocument = 0;
+
+    // Whole files already measured keep their figures, the rest are analysed together in one pass
+    for (GList *l = lDocuments; l != NULL; l = l->next, nDocument++)
+    {
+        Document *pDocument = l->data;
+        MainWindow *pWindow = pDocument->pMainWindow;
+
+        if (pWindow->pAnalysisChunk == pDocument->pChunk && (pWindow->nAnalysisSelStart == pWindow->nAnalysisSelEnd || (pWindow->nAnalysisSelStart == 0 && pWindow->nAnalysisSelEnd >= pDocument->pChunk->nFrames)))
+        {
+            lAnalyses[nDocument] = &pWindow->cAnalysis;
+        }
+        else
+        {
+            lRegions[nRegions].pChunk = pDocument->pChunk;
+            lRegions[nRegions].nFrames = pDocument->pChunk->nFrames;
+            lAnalyses[nDocument] = &lRegions[nRegions].cAnalysis;
+            nRegions++;
+        }
+    }
+
+    g_object_ref(pMainWindow);
+    gboolean bError = nRegions && analysis_Regions(lRegions, nRegions, &pMainWindow->cProgress);
+    gboolean bSilent = FALSE;
+    gboolean bLimitedAny = FALSE;
+    nDocument = 0;
+
+    for (GList *l = lDocuments; l != NULL && !bError; l = l->next, nDocument++)
+    {
+        Document *pDocument = l->data;
+        gfloat fFactor;
+        gboolean bLimited;
+
+        if (pMainWindow->pDocument == NULL)
+        {
+            break;
+        }
+
+        if (analysis_GetGain(lAnalyses[nDocument], ANALYSIS_TARGET_LOUDNESS, g_settings_get_double(g_pGSettings, "normalize-loudness"), g_settings_get_double(g_pGSettings, "normalize-ceiling"), &fFactor, &bLimited))
+        {
+            bSilent = TRUE;
+
+            continue;
+        }
+
+        bLimitedAny = bLimitedAny || bLimited;
+
+        if (fabsf(fFactor - 1.0) > MAINWINDOW_GAIN_EPSILON)
+        {
+            Chunk *pChunk = chunk_Gain(pDocument->pChunk, fFactor, &pMainWindow->cProgress);
+            bError = (pChunk == NULL);
+
+            if (pChunk)
+            {
+                document_Update(pDocument, pChunk, 0, 0);
+            }
+        }
+    }
+
+    if (bSilent && !bError)
+    {
+        message_Warning(_("Silent files were left unchanged"));
+    }
+
+    if (bLimitedAny && !bError)
+    {
+        message_Warning(_("Some files were kept below the peak ceiling and are quieter than the target loudness"));
+    }
+
+    g_object_unref(pMainWindow);
+    g_free(lAnalyses);
+    g_free(lRegions);
+    g_list_free_full(lDocuments, g_object_unref);
+}
+
 static gboolean mainwindow_OnSelectAll(GtkAccelGroup *pAccelGroup, GObject *pObject, guint nKeyVal, GdkModifierType nModifierType, gpointer pUserData)
 {
     MainWindow *pMainWindow = OE_MAINWINDOW(pUserData);
@@ -1369,6 +1856,10 @@ static void mainwindow_init(MainWindow *pMainWindow)
     pMainWindow->lNeedSelectionItems = NULL;
     pMainWindow->lNeedClipboardItems = NULL;
     pMainWindow->lNeedUndoItems = NULL;
+    pMainWindow->cProgress.pOnBegin = mainwindow_OnProgressBegin;
+    pMainWindow->cProgress.pOnProgress = mainwindow_OnProgress;
+    pMainWindow->cProgress.pOnEnd = mainwindow_OnProgressEnd;
+    pMainWindow->cProgress.pUserData = pMainWindow;
     pMainWindow->pAdjustmentView = GTK_ADJUSTMENT(gtk_adjustment_new(0, 0, 0, 0, 0, 0));
     g_signal_connect(pMainWindow->pAdjustmentView, "value-changed", G_CALLBACK(mainwindow_OnViewZoomChanged), pMainWindow);
     pMainWindow->pAdjustmentZoomH = GTK_ADJUSTMENT( gtk_adjustment_new(0, 0, 1.2, 0.01, 0.1, 0.2));
@@ -1500,6 +1991,27 @@ static void mainwindow_init(MainWindow *pMainWindow)
     g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnPlay), pMainWindow);
     gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
     mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_check_menu_item_new_with_label(_("Loop playback"));
+    gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(pMenuItem), player_GetLoop());
+    g_signal_connect(pMenuItem, "toggled", G_CALLBACK(mainwindow_OnLoop), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), gtk_separator_menu_item_new());
+    pMenuItem = gtk_menu_item_new_with_label(_("Preview fade in"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnPreviewFadeIn), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_menu_item_new_with_label(_("Preview fade out"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnPreviewFadeOut), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_menu_item_new_with_label(_("Preview gain"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnPreviewGain), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_menu_item_new_with_label(_("Preview mix paste"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnPreviewMixPaste), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedClipboardItems, pMenuItem);
     gtk_widget_show_all(pMenu);
     pToolItem = gtk_menu_tool_button_new(gtk_image_new_from_icon_name("media-playback-start", GTK_ICON_SIZE_LARGE_TOOLBAR), _("Play"));
     gtk_tool_item_set_tooltip_text(pToolItem, _("Play selection"));
@@ -1515,6 +2027,11 @@ static void mainwindow_init(MainWindow *pMainWindow)
     gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), pToolItem, -1);
     mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pToolItem);
 
+    pToolItem = gtk_tool_button_new(gtk_image_new_from_icon_name("media-record", GTK_ICON_SIZE_LARGE_TOOLBAR), _("Record"));
+    gtk_tool_item_set_tooltip_text(pToolItem, _("Start or stop recording into a new file"));
+    g_signal_connect(pToolItem, "clicked", G_CALLBACK(mainwindow_OnRecord), pMainWindow);
+    gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), pToolItem, -1);
+
     gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), gtk_separator_tool_item_new(), -1);
 
     pIconThemed = g_themed_icon_new_with_default_fallbacks("go-up");
@@ -1545,6 +2062,28 @@ static void mainwindow_init(MainWindow *pMainWindow)
     gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), pToolItem, -1);
     mainwindow_AppendWidget(&pMainWindow->lNeedSelectionItems, pToolItem);
 
+    pMenu = gtk_menu_new();
+    pMenuItem = gtk_menu_item_new_with_label(_("Normalise to peak"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnNormalizePeak), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_menu_item_new_with_label(_("Normalise to loudness"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnNormalizeLoudness), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    pMenuItem = gtk_menu_item_new_with_label(_("Normalise all open files to loudness"));
+    g_signal_connect(pMenuItem, "activate", G_CALLBACK(mainwindow_OnNormalizeAll), pMainWindow);
+    gtk_menu_shell_append(GTK_MENU_SHELL(pMenu), pMenuItem);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pMenuItem);
+    gtk_widget_show_all(pMenu);
+    pToolItem = gtk_menu_tool_button_new(gtk_image_new_from_icon_name("utilities-system-monitor", GTK_ICON_SIZE_LARGE_TOOLBAR), _("Analyse"));
+    gtk_tool_item_set_tooltip_text(pToolItem, _("Measure loudness and peaks of the selection or the whole file"));
+    gtk_menu_tool_button_set_arrow_tooltip_text(GTK_MENU_TOOL_BUTTON(pToolItem), _("Click here for more options"));
+    gtk_menu_tool_button_set_menu(GTK_MENU_TOOL_BUTTON(pToolItem), pMenu);
+    g_signal_connect(pToolItem, "clicked", G_CALLBACK(mainwindow_OnAnalyse), pMainWindow);
+    gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), pToolItem, -1);
+    mainwindow_AppendWidget(&pMainWindow->lNeedChunkItems, pToolItem);
+
     GtkToolItem *pSeparatorToolItem = gtk_separator_tool_item_new();
     gtk_toolbar_insert(GTK_TOOLBAR(pMainWindow->pToolBar), pSeparatorToolItem, -1);
 
@@ -1579,6 +2118,7 @@ static void mainwindow_init(MainWindow *pMainWindow)
     pMainWindow->pLabelView = GTK_LABEL(gtk_widget_new(GTK_TYPE_LABEL, "use-markup", TRUE, "label", sText, "margin", 5, NULL));
     g_snprintf(sText, 150, "<span font-weight=\"bold\">%s:</span> 00:00.000 + 00:00.000", _("Selection"));
     pMainWindow->pLabelSel = GTK_LABEL(gtk_widget_new(GTK_TYPE_LABEL, "use-markup", TRUE, "label", sText, "margin", 5, NULL));
+    pMainWindow->pLabelAnalysis = GTK_LABEL(gtk_widget_new(GTK_TYPE_LABEL, "use-markup", TRUE, "margin", 5, "no-show-all", TRUE, NULL));
     pMainWindow->pProgressBar = GTK_PROGRESS_BAR(gtk_widget_new(GTK_TYPE_PROGRESS_BAR, "margin", 5, "hexpand", TRUE, NULL));
     gtk_progress_bar_set_show_text(pMainWindow->pProgressBar, TRUE);
 
@@ -1613,7 +2153,8 @@ static void mainwindow_init(MainWindow *pMainWindow)
     gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pLabelCursor), 0, 0, 1, 1);
     gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pLabelView), 1, 0, 1, 1);
     gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pLabelSel), 2, 0, 1, 1);
-    gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pProgressBar), 3, 0, 1, 1);
+    gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pLabelAnalysis), 3, 0, 1, 1);
+    gtk_grid_attach(pGridStatus, GTK_WIDGET(pMainWindow->pProgressBar), 4, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(pGrid), GTK_WIDGET(pGridStatus), 0, 3, 2, 1);
     gtk_container_add(GTK_CONTAINER(pMainWindow), pGrid);
     gtk_widget_show_all(GTK_WIDGET(pMainWindow));
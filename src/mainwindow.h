@@ -23,11 +23,13 @@
 #define MAINWINDOW_H_INCLUDED
 
 #include "chunkview.h"
+#include "analysis.h"
 
 #define OE_TYPE_MAINWINDOW mainwindow_get_type()
 G_DECLARE_FINAL_TYPE(MainWindow, mainwindow, OE, MAINWINDOW, GtkWindow)
 #define MAINWINDOW_RECENT_MAX 10
 #define MAINWINDOW_VZOOM_MAX 100
+#define MAINWINDOW_GAIN_EPSILON 0.0001
 
 struct _MainWindow
 {
@@ -52,6 +54,11 @@ struct _MainWindow
     GtkLabel *pLabelCursor;
     GtkLabel *pLabelView;
     GtkLabel *pLabelSel;
+    GtkLabel *pLabelAnalysis;
+    Chunk *pAnalysisChunk;
+    gint64 nAnalysisSelStart;
+    gint64 nAnalysisSelEnd;
+    Analysis cAnalysis;
     GtkProgressBar* pProgressBar;
     gboolean bStatusBarRolling;
     gboolean bStatusBarWorking;
@@ -62,17 +69,17 @@ struct _MainWindow
     gint64 nStatusBarSelStart;
     gint64 nStatusBarSelEnd;
     gint64 nStatusBarTimeLast;
+    Progress cProgress;
 };
 
 extern GList *g_lMainWindows;
 extern MainWindow *g_pFocusedWindow;
 extern GtkFileFilter *g_pFileFilter;
-extern GtkFileFilter *g_pFileFilterWav;
+extern GtkFileFilter *g_pFileFilterSave;
 extern guint m_nStatusBarsWorking;
 
 GtkWidget *mainwindow_new();
 GtkWidget *mainwindow_NewWithFile(gchar *sFilePath);
-gboolean mainwindow_UpdateCaches();
 void mainwindow_RepaintViews();
 void mainwindow_SetSensitive(MainWindow *pMainWindow, gboolean bSensitive);
 gboolean mainwindow_Progress(MainWindow *pMainWindow, gfloat fProgress);
@@ -41,6 +41,25 @@ static void message_SetLabelExpand(GtkWidget *pWidget, gpointer pUserData)
 
 static gint message_ShowDialog(GtkMessageType nMessageType, GtkButtonsType nButtonsType, gchar *sMessage)
 {
+    if (g_bBatch || g_thread_self() != g_pMainThread)
+    {
+        if (sMessage && g_bBatch)
+        {
+            g_printerr("%s\n", sMessage);
+        }
+        else if (sMessage)
+        {
+            g_warning("%s", sMessage);
+        }
+
+        if (nButtonsType == GTK_BUTTONS_OK)
+        {
+            return GTK_RESPONSE_OK;
+        }
+
+        return GTK_RESPONSE_CANCEL;
+    }
+
     GtkWidget *pWidget = gtk_message_dialog_new(GTK_WINDOW(g_pFocusedWindow), GTK_DIALOG_MODAL, nMessageType, nButtonsType, "%s", sMessage);
     GtkWidget *pMessageArea = gtk_message_dialog_get_message_area(GTK_MESSAGE_DIALOG(pWidget));
     gtk_container_forall(GTK_CONTAINER(pMessageArea), message_SetLabelExpand, NULL);
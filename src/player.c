@@ -18,17 +18,204 @@
     Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
 */
 
+#include <math.h>
+#include <string.h>
 #include "player.h"
+#include "counters.h"
+#include "dsp.h"
+
+#define PREVIEW_FRAMES 4096
+#define SCRUB_GRAIN 1024
+#define SCRUB_HOP (SCRUB_GRAIN / 4)
+#define SCRUB_WINDOW 65536
+#define SCRUB_CHASE 4.0
+#define SCRUB_MAX_SPEED 4.0
 
 G_LOCK_DEFINE(PLAYER_LOCK);
 
+typedef struct
+{
+    gint64 nPipelinePos;
+    gint64 nShift;
+
+} LoopWrap;
+
 static gboolean m_bPlaying = FALSE;
 static GstPlayer *m_pGstPlayer = NULL;
 static ChunkHandle *m_pChunkHandle = NULL;
-static guint m_nCurPos = 0;
-static guint m_nStartPos = 0;
-static guint m_nEndPos = 0;
+static gint64 m_nCurPos = 0;
+static gint64 m_nStartPos = 0;
+static gint64 m_nEndPos = 0;
 static OnNotify m_pOnNotify = NULL;
+static ChunkHandle *m_pSwitchHandle = NULL;
+static gint64 m_nSwitchMoveStart = 0;
+static gint64 m_nSwitchMoveDist = 0;
+static GThread *m_pSwitchThread = NULL;
+static gint m_bSwitchReady = FALSE;
+static gboolean m_bSwitchStop = FALSE;
+static gchar *m_lSwitchBuffer = NULL;
+static gint64 m_nSwitchBufferStart = 0;
+static guint m_nSwitchBufferFrames = 0;
+static GList *m_lRetiredHandles = NULL;
+static gboolean m_bLoop = FALSE;
+static gchar *m_lLoopBuffer = NULL;
+static gint64 m_nLoopBufferStart = 0;
+static guint m_nLoopBufferFrames = 0;
+static gint64 m_nPipelinePos = 0;
+static gint64 m_nLoopShift = 0;
+static gint64 m_nNotifyShift = 0;
+static GQueue m_lLoopWraps = G_QUEUE_INIT;
+static gboolean m_bPreview = FALSE;
+static PlayerPreview m_cPreview;
+static ChunkHandle *m_pPreviewMixHandle = NULL;
+static gfloat *m_lPreviewFrames = NULL;
+static gfloat *m_lPreviewMix = NULL;
+static gboolean m_bScrubbing = FALSE;
+static GstAudioInfo *m_pScrubAudioInfo = NULL;
+static gfloat m_lScrubHann[SCRUB_GRAIN];
+static gfloat *m_lScrubGrain = NULL;
+static gfloat *m_lScrubOutput = NULL;
+static gdouble m_fScrubPos = 0.0;
+static gdouble m_fScrubSpeed = 0.0;
+static GMutex m_pScrubMutex;
+static GCond m_pScrubCond;
+static GThread *m_pScrubThread = NULL;
+static gboolean m_bScrubQuit = FALSE;
+static gint64 m_nScrubTarget = 0;
+static gfloat *m_lScrubWindow = NULL;
+static gfloat *m_lScrubWindowSpare = NULL;
+static gint64 m_nScrubWindowStart = -1;
+static guint m_nScrubWindowFrames = 0;
+
+static gint64 player_MovePos(gint64 nPos, gint64 nMoveStart, gint64 nMoveDist, gint64 nFrames)
+{
+    if (nPos >= nMoveStart)
+    {
+        nPos = CLAMP(nPos + nMoveDist, nMoveStart, nFrames);
+    }
+
+    return nPos;
+}
+
+static gpointer player_OnSwitchPrefetch(gpointer pUserData)
+{
+    // Read what the player will need right after the switch, opening and warming up the parts around it
+    if (m_nSwitchBufferStart < m_pSwitchHandle->nFrames)
+    {
+        m_nSwitchBufferFrames = chunk_Read(m_pSwitchHandle, m_nSwitchBufferStart, BUFFER_SIZE / m_pSwitchHandle->pAudioInfo->bpf, m_lSwitchBuffer, FALSE, TRUE);
+    }
+
+    g_atomic_int_set(&m_bSwitchReady, TRUE);
+
+    return NULL;
+}
+
+static void player_SwapChunk()
+{
+    gint64 nFrames = m_pSwitchHandle->nFrames;
+    gint64 nNewPos = m_nCurPos;
+
+    if (nNewPos >= m_nSwitchMoveStart)
+    {
+        nNewPos += m_nSwitchMoveDist;
+
+        // Playback went on into the removed part while the new chunk was being prepared
+        if (nNewPos < m_nSwitchMoveStart || nNewPos > nFrames)
+        {
+            m_bSwitchStop = TRUE;
+        }
+    }
+
+    m_lRetiredHandles = g_list_prepend(m_lRetiredHandles, m_pChunkHandle);
+    m_pChunkHandle = m_pSwitchHandle;
+    m_pSwitchHandle = NULL;
+    m_nStartPos = player_MovePos(m_nStartPos, m_nSwitchMoveStart, m_nSwitchMoveDist, nFrames);
+    m_nEndPos = player_MovePos(m_nEndPos, m_nSwitchMoveStart, m_nSwitchMoveDist, nFrames);
+    m_nCurPos = CLAMP(nNewPos, 0, nFrames);
+    m_nLoopBufferFrames = 0;
+}
+
+static void player_CloseRetired()
+{
+    G_LOCK(PLAYER_LOCK);
+    GList *lRetiredHandles = m_lRetiredHandles;
+    m_lRetiredHandles = NULL;
+    G_UNLOCK(PLAYER_LOCK);
+
+    for (GList *l = lRetiredHandles; l != NULL; l = l->next)
+    {
+        ChunkHandle *pChunkHandle = (ChunkHandle *)l->data;
+        chunk_Close(pChunkHandle, TRUE);
+        g_info("chunk_unref: %d, player:player_CloseRetired %p", chunk_AliveCount(), pChunkHandle);
+        g_object_unref(pChunkHandle);
+    }
+
+    g_list_free(lRetiredHandles);
+}
+
+static gboolean player_FinishSwitch()
+{
+    if (m_pSwitchThread != NULL)
+    {
+        g_thread_join(m_pSwitchThread);
+        m_pSwitchThread = NULL;
+
+        G_LOCK(PLAYER_LOCK);
+
+        if (m_pSwitchHandle != NULL)
+        {
+            player_SwapChunk();
+        }
+
+        G_UNLOCK(PLAYER_LOCK);
+    }
+
+    player_CloseRetired();
+
+    if (m_bSwitchStop)
+    {
+        player_Stop();
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void player_ClearWraps()
+{
+    LoopWrap *pLoopWrap;
+
+    while ((pLoopWrap = g_queue_pop_head(&m_lLoopWraps)) != NULL)
+    {
+        g_free(pLoopWrap);
+    }
+
+    m_nLoopShift = 0;
+    m_nNotifyShift = 0;
+}
+
+static void player_PrefetchLoop()
+{
+    // Read the loop start ahead of time, so wrapping around never waits for the disk
+    guint nFrames = MIN(BUFFER_SIZE / m_pChunkHandle->pAudioInfo->bpf, m_nEndPos - m_nStartPos);
+    gchar *lBuffer = g_malloc(BUFFER_SIZE);
+    guint nFramesRead = 0;
+
+    if (nFrames > 0 && m_nStartPos < m_pChunkHandle->nFrames)
+    {
+        nFramesRead = chunk_Read(m_pChunkHandle, m_nStartPos, nFrames, lBuffer, FALSE, TRUE);
+    }
+
+    G_LOCK(PLAYER_LOCK);
+    gchar *lBufferOld = m_lLoopBuffer;
+    m_lLoopBuffer = lBuffer;
+    m_nLoopBufferStart = m_nStartPos;
+    m_nLoopBufferFrames = nFramesRead;
+    G_UNLOCK(PLAYER_LOCK);
+
+    g_free(lBufferOld);
+}
 
 static gboolean player_OnNotify()
 {   
@@ -36,8 +223,47 @@ static gboolean player_OnNotify()
     {
         return FALSE;
     }
+
+    if (m_bScrubbing)
+    {
+        m_pOnNotify(m_nCurPos, TRUE);
+
+        return TRUE;
+    }
+
+    if (m_pSwitchThread != NULL && g_atomic_int_get(&m_bSwitchReady) && m_pSwitchHandle == NULL)
+    {
+        g_thread_join(m_pSwitchThread);
+        m_pSwitchThread = NULL;
+    }
+
+    if (m_lRetiredHandles != NULL || m_bSwitchStop)
+    {
+        if (player_FinishSwitch())
+        {
+            return FALSE;
+        }
+    }
     
-    guint nCurPos = gstbase_GetPosition(m_pGstPlayer->pGstBase);
+    if (m_bLoop && m_nLoopBufferFrames == 0 && m_pSwitchHandle == NULL)
+    {
+        player_PrefetchLoop();
+    }
+
+    gint64 nCurPos = gstbase_GetPosition(m_pGstPlayer->pGstBase);
+
+    // The pipeline runs on past every wrap, take off the loop lengths it has played through
+    G_LOCK(PLAYER_LOCK);
+    LoopWrap *pLoopWrap;
+
+    while ((pLoopWrap = g_queue_peek_head(&m_lLoopWraps)) != NULL && pLoopWrap->nPipelinePos <= nCurPos)
+    {
+        m_nNotifyShift = pLoopWrap->nShift;
+        g_free(g_queue_pop_head(&m_lLoopWraps));
+    }
+
+    nCurPos -= m_nNotifyShift;
+    G_UNLOCK(PLAYER_LOCK);
         
     if (nCurPos >= m_nEndPos || nCurPos >= m_pChunkHandle->nFrames)
     {
@@ -51,24 +277,374 @@ static gboolean player_OnNotify()
     return TRUE;
 }
 
+static guint player_ReadPreview(gchar *lBuffer, guint nFrames)
+{
+    if (m_nCurPos >= m_pChunkHandle->nFrames)
+    {
+        return 0;
+    }
+
+    // Small blocks, so parameter changes are heard shortly after they are made
+    GstAudioInfo *pAudioInfo = m_pChunkHandle->pAudioInfo;
+    guint nFramesRead = chunk_Read(m_pChunkHandle, m_nCurPos, MIN(nFrames, PREVIEW_FRAMES), (gchar*)m_lPreviewFrames, TRUE, TRUE);
+
+    if (nFramesRead == 0)
+    {
+        return 0;
+    }
+
+    gint64 nFrom = MAX(m_nCurPos, m_cPreview.nStart);
+    gint64 nTo = MIN(m_nCurPos + nFramesRead, m_cPreview.nStart + m_cPreview.nFrames);
+
+    if (nFrom < nTo)
+    {
+        gfloat *lFrames = m_lPreviewFrames + (nFrom - m_nCurPos) * pAudioInfo->channels;
+        gint64 nOffset = nFrom - m_cPreview.nStart;
+
+        if (m_cPreview.fStartFactor != 1.0 || m_cPreview.fEndFactor != 1.0)
+        {
+            dsp_Fade(lFrames, nTo - nFrom, pAudioInfo->channels, m_cPreview.fStartFactor, m_cPreview.fEndFactor, nOffset, m_cPreview.nFrames);
+        }
+
+        if (m_pPreviewMixHandle != NULL && nOffset < m_pPreviewMixHandle->nFrames)
+        {
+            guint nMixFrames = chunk_Read(m_pPreviewMixHandle, nOffset, MIN(nTo - nFrom, m_pPreviewMixHandle->nFrames - nOffset), (gchar*)m_lPreviewMix, TRUE, TRUE);
+            dsp_Accumulate(lFrames, m_lPreviewMix, 1.0f, nMixFrames * pAudioInfo->channels);
+            dsp_Clip(lFrames, nMixFrames * pAudioInfo->channels);
+        }
+    }
+
+    if (pAudioInfo->finfo->format == GST_AUDIO_FORMAT_F32LE)
+    {
+        memcpy(lBuffer, m_lPreviewFrames, nFramesRead * pAudioInfo->bpf);
+    }
+    else
+    {
+        gstconverter_ConvertBuffer((gchar*)m_lPreviewFrames, lBuffer, nFramesRead, pAudioInfo, TRUE);
+    }
+
+    return nFramesRead;
+}
+
+static guint player_ReadFrames(gchar *lBuffer, guint nFrames)
+{
+    guint nBpf = m_pChunkHandle->pAudioInfo->bpf;
+
+    if (m_bPreview)
+    {
+        return player_ReadPreview(lBuffer, nFrames);
+    }
+
+    if (m_pSwitchHandle == NULL && m_nSwitchBufferFrames > 0 && m_nCurPos >= m_nSwitchBufferStart && m_nCurPos < m_nSwitchBufferStart + m_nSwitchBufferFrames)
+    {
+        guint nOffset = m_nCurPos - m_nSwitchBufferStart;
+        nFrames = MIN(nFrames, m_nSwitchBufferFrames - nOffset);
+        memcpy(lBuffer, m_lSwitchBuffer + nOffset * nBpf, nFrames * nBpf);
+
+        return nFrames;
+    }
+
+    if (m_nLoopBufferFrames > 0 && m_nCurPos >= m_nLoopBufferStart && m_nCurPos < m_nLoopBufferStart + m_nLoopBufferFrames)
+    {
+        guint nOffset = m_nCurPos - m_nLoopBufferStart;
+        nFrames = MIN(nFrames, m_nLoopBufferFrames - nOffset);
+        memcpy(lBuffer, m_lLoopBuffer + nOffset * nBpf, nFrames * nBpf);
+
+        return nFrames;
+    }
+
+    if (m_nCurPos >= m_pChunkHandle->nFrames)
+    {
+        return 0;
+    }
+
+    return chunk_Read(m_pChunkHandle, m_nCurPos, nFrames, lBuffer, FALSE, TRUE);
+}
+
 static void player_OnGetFrames(gchar *lBuffer, guint nFrames, guint *nFramesRead)
 {
     G_LOCK(PLAYER_LOCK);
+
+    // Switch to an edited chunk only at a buffer boundary, once its data at the play position is at hand
+    if (m_pSwitchHandle != NULL && g_atomic_int_get(&m_bSwitchReady))
+    {
+        player_SwapChunk();
+    }
+
+    *nFramesRead = 0;
+    gboolean bLoop = m_bLoop && m_nEndPos > m_nStartPos;
     
-    if (!m_bPlaying || m_nEndPos - m_nCurPos == 0)
+    if (m_bPlaying && !m_bSwitchStop && (bLoop || m_nEndPos - m_nCurPos != 0))
+    {
+        gint64 nTime = g_get_monotonic_time();
+        guint nBpf = m_pChunkHandle->pAudioInfo->bpf;
+
+        while (*nFramesRead < nFrames)
+        {
+            // Wrap inside the buffer, so the loop end is followed by the loop start without a gap
+            if (bLoop && m_nCurPos >= m_nEndPos)
+            {
+                LoopWrap *pLoopWrap = g_malloc(sizeof(LoopWrap));
+                m_nLoopShift += m_nCurPos - m_nStartPos;
+                pLoopWrap->nPipelinePos = m_nPipelinePos + *nFramesRead;
+                pLoopWrap->nShift = m_nLoopShift;
+                g_queue_push_tail(&m_lLoopWraps, pLoopWrap);
+                m_nCurPos = m_nStartPos;
+            }
+
+            guint nFramesWanted = nFrames - *nFramesRead;
+
+            if (bLoop)
+            {
+                nFramesWanted = MIN(nFramesWanted, m_nEndPos - m_nCurPos);
+            }
+
+            guint nFramesDone = player_ReadFrames(lBuffer + *nFramesRead * nBpf, nFramesWanted);
+
+            if (nFramesDone == 0)
+            {
+                break;
+            }
+
+            *nFramesRead += nFramesDone;
+            m_nCurPos += nFramesDone;
+
+            if (!bLoop)
+            {
+                break;
+            }
+        }
+
+        m_nPipelinePos += *nFramesRead;
+
+        // Reading took longer than the audio it produced lasts, so playback is falling behind
+        if ((g_get_monotonic_time() - nTime) * m_pChunkHandle->pAudioInfo->rate > (gint64)*nFramesRead * G_USEC_PER_SEC)
+        {
+            counters_Add(COUNTER_PLAYER_SLOW_READS, 1);
+        }
+    }
+    
+    G_UNLOCK(PLAYER_LOCK);
+}
+
+static gpointer player_OnScrubPrefetch(gpointer pUserData)
+{
+    gint64 nFrames = m_pChunkHandle->nFrames;
+
+    g_mutex_lock(&m_pScrubMutex);
+
+    while (!m_bScrubQuit)
+    {
+        gint64 nStart = CLAMP(m_nScrubTarget - SCRUB_WINDOW / 2, 0, MAX(nFrames - SCRUB_WINDOW, 0));
+
+        // Keep the window centred on the pointer, reloading once it drifts a quarter away
+        if (m_nScrubWindowStart != -1 && ABS(nStart - m_nScrubWindowStart) < SCRUB_WINDOW / 4)
+        {
+            g_cond_wait(&m_pScrubCond, &m_pScrubMutex);
+
+            continue;
+        }
+
+        g_mutex_unlock(&m_pScrubMutex);
+        guint nFramesRead = chunk_Read(m_pChunkHandle, nStart, MIN(SCRUB_WINDOW, nFrames - nStart), (gchar*)m_lScrubWindowSpare, TRUE, TRUE);
+        g_mutex_lock(&m_pScrubMutex);
+
+        if (nFramesRead == 0)
+        {
+            m_nScrubWindowStart = -1;
+            g_cond_wait(&m_pScrubCond, &m_pScrubMutex);
+
+            continue;
+        }
+
+        gfloat *lWindow = m_lScrubWindow;
+        m_lScrubWindow = m_lScrubWindowSpare;
+        m_lScrubWindowSpare = lWindow;
+        m_nScrubWindowStart = nStart;
+        m_nScrubWindowFrames = nFramesRead;
+    }
+
+    g_mutex_unlock(&m_pScrubMutex);
+
+    return NULL;
+}
+
+static void player_ReadGrain(gint64 nStart, gfloat *lGrain)
+{
+    guint nChannels = m_pChunkHandle->pAudioInfo->channels;
+    gint64 nFrom = MAX(nStart, 0);
+    gint64 nTo = MIN(nStart + SCRUB_GRAIN, m_pChunkHandle->nFrames);
+
+    memset(lGrain, 0, SCRUB_GRAIN * nChannels * sizeof(gfloat));
+
+    if (nFrom >= nTo)
+    {
+        return;
+    }
+
+    gfloat *lOut = lGrain + (nFrom - nStart) * nChannels;
+
+    g_mutex_lock(&m_pScrubMutex);
+
+    if (m_nScrubWindowStart != -1 && nFrom >= m_nScrubWindowStart && nTo <= m_nScrubWindowStart + m_nScrubWindowFrames)
+    {
+        memcpy(lOut, m_lScrubWindow + (nFrom - m_nScrubWindowStart) * nChannels, (nTo - nFrom) * nChannels * sizeof(gfloat));
+        g_mutex_unlock(&m_pScrubMutex);
+
+        return;
+    }
+
+    g_cond_signal(&m_pScrubCond);
+    g_mutex_unlock(&m_pScrubMutex);
+
+    // The prefetch has not caught up with the pointer yet, a single grain is cheap enough to read directly
+    chunk_Read(m_pChunkHandle, nFrom, nTo - nFrom, (gchar*)lOut, TRUE, TRUE);
+}
+
+static void player_OnGetScrubFrames(gchar *lBuffer, guint nFrames, guint *nFramesRead)
+{
+    G_LOCK(PLAYER_LOCK);
+
+    if (!m_bPlaying || nFrames < SCRUB_HOP)
     {
         *nFramesRead = 0;
+        G_UNLOCK(PLAYER_LOCK);
+
+        return;
+    }
+
+    guint nChannels = m_pChunkHandle->pAudioInfo->channels;
+
+    g_mutex_lock(&m_pScrubMutex);
+    gdouble fTarget = (gdouble)m_nScrubTarget;
+    g_mutex_unlock(&m_pScrubMutex);
+
+    // Chase the pointer over a few hops, so the speed follows how fast it is dragged
+    gdouble fSpeed = CLAMP((fTarget - m_fScrubPos) / (SCRUB_CHASE * SCRUB_HOP), -SCRUB_MAX_SPEED, SCRUB_MAX_SPEED);
+    m_fScrubSpeed = (m_fScrubSpeed + fSpeed) / 2.0;
+    m_fScrubPos = CLAMP(m_fScrubPos + m_fScrubSpeed * SCRUB_HOP, 0.0, (gdouble)m_pChunkHandle->nFrames);
+
+    // A resting pointer is silent, otherwise every hop adds one windowed grain around the play head
+    if (fabs(m_fScrubSpeed * SCRUB_HOP) >= 1.0)
+    {
+        player_ReadGrain((gint64)m_fScrubPos - SCRUB_GRAIN / 2, m_lScrubGrain);
+        gboolean bReverse = m_fScrubSpeed < 0.0;
+
+        for (guint nFrame = 0; nFrame < SCRUB_GRAIN; nFrame++)
+        {
+            gfloat *lIn = m_lScrubGrain + (bReverse ? SCRUB_GRAIN - 1 - nFrame : nFrame) * nChannels;
+            gfloat *lOut = m_lScrubOutput + nFrame * nChannels;
+
+            for (guint nChannel = 0; nChannel < nChannels; nChannel++)
+            {
+                lOut[nChannel] += lIn[nChannel] * m_lScrubHann[nFrame];
+            }
+        }
+    }
+
+    memcpy(lBuffer, m_lScrubOutput, SCRUB_HOP * nChannels * sizeof(gfloat));
+    memmove(m_lScrubOutput, m_lScrubOutput + SCRUB_HOP * nChannels, (SCRUB_GRAIN - SCRUB_HOP) * nChannels * sizeof(gfloat));
+    memset(m_lScrubOutput + (SCRUB_GRAIN - SCRUB_HOP) * nChannels, 0, SCRUB_HOP * nChannels * sizeof(gfloat));
+    *nFramesRead = SCRUB_HOP;
+    m_nCurPos = (gint64)m_fScrubPos;
+
+    G_UNLOCK(PLAYER_LOCK);
+}
+
+static void player_ClearPreview()
+{
+    if (m_pPreviewMixHandle != NULL)
+    {
+        chunk_Close(m_pPreviewMixHandle, TRUE);
+        g_info("chunk_unref: %d, player:player_ClearPreview %p", chunk_AliveCount(), m_pPreviewMixHandle);
+        g_object_unref(m_pPreviewMixHandle);
+        m_pPreviewMixHandle = NULL;
+    }
+
+    g_free(m_lPreviewFrames);
+    g_free(m_lPreviewMix);
+    m_lPreviewFrames = m_lPreviewMix = NULL;
+    m_bPreview = FALSE;
+}
+
+static gboolean player_ApplyPreview(PlayerPreview *pPreview)
+{
+    ChunkHandle *pMixHandle = NULL;
+
+    if (pPreview != NULL && pPreview->pMixChunk != NULL)
+    {
+        if (m_pPreviewMixHandle != NULL && m_cPreview.pMixChunk == pPreview->pMixChunk)
+        {
+            pMixHandle = m_pPreviewMixHandle;
+        }
+        else
+        {
+            pMixHandle = chunk_Open(pPreview->pMixChunk, TRUE);
+
+            if (pMixHandle == NULL)
+            {
+                return TRUE;
+            }
+
+            g_info("chunk_ref: %d, player_SetPreview %p", chunk_AliveCount(), pMixHandle);
+            g_object_ref(pMixHandle);
+        }
+    }
+
+    G_LOCK(PLAYER_LOCK);
+
+    if (pPreview == NULL)
+    {
+        player_ClearPreview();
     }
     else
     {
-        *nFramesRead = chunk_Read(m_pChunkHandle, m_nCurPos, nFrames, lBuffer, FALSE, TRUE);
-        m_nCurPos += *nFramesRead;
+        if (m_pPreviewMixHandle != NULL && m_pPreviewMixHandle != pMixHandle)
+        {
+            chunk_Close(m_pPreviewMixHandle, TRUE);
+            g_info("chunk_unref: %d, player:player_SetPreview %p", chunk_AliveCount(), m_pPreviewMixHandle);
+            g_object_unref(m_pPreviewMixHandle);
+        }
+
+        if (m_lPreviewFrames == NULL)
+        {
+            m_lPreviewFrames = g_malloc(PREVIEW_FRAMES * m_pChunkHandle->pAudioInfo->channels * sizeof(gfloat));
+            m_lPreviewMix = g_malloc(PREVIEW_FRAMES * m_pChunkHandle->pAudioInfo->channels * sizeof(gfloat));
+        }
+
+        m_pPreviewMixHandle = pMixHandle;
+        m_cPreview = *pPreview;
+        m_bPreview = TRUE;
     }
-    
+
     G_UNLOCK(PLAYER_LOCK);
+
+    return FALSE;
+}
+
+gboolean player_SetPreview(PlayerPreview *pPreview)
+{
+    if (!m_bPlaying || m_bScrubbing)
+    {
+        return TRUE;
+    }
+
+    return player_ApplyPreview(pPreview);
 }
 
-gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify pOnNotify)
+gboolean player_GetPreview(PlayerPreview *pPreview)
+{
+    if (!m_bPlaying || !m_bPreview)
+    {
+        return FALSE;
+    }
+
+    *pPreview = m_cPreview;
+
+    return TRUE;
+}
+
+gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify pOnNotify, PlayerPreview *pPreview)
 {
     if (nStartPos == nEndPos)
     {
@@ -79,6 +655,17 @@ gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify p
     m_pChunkHandle = chunk_Open(pChunk, TRUE);
     g_info("chunk_ref: %d, player_Play %p", chunk_AliveCount(), m_pChunkHandle);
     g_object_ref(m_pChunkHandle);
+
+    // Set up before the pipeline starts asking for data, so not even the first buffer is heard unprocessed
+    if (pPreview != NULL && player_ApplyPreview(pPreview))
+    {
+        chunk_Close(m_pChunkHandle, TRUE);
+        g_info("chunk_unref: %d, player:player_Play %p", chunk_AliveCount(), m_pChunkHandle);
+        g_object_unref(m_pChunkHandle);
+        m_pChunkHandle = NULL;
+
+        return TRUE;
+    }
     
     if (m_pGstPlayer == NULL)
     {
@@ -87,6 +674,12 @@ gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify p
 
     m_nStartPos = nStartPos;
     m_nEndPos = nEndPos;
+
+    if (m_bLoop)
+    {
+        player_PrefetchLoop();
+    }
+
     m_bPlaying = TRUE;
     m_pOnNotify = pOnNotify;
     player_SetPos(nStartPos);
@@ -95,9 +688,113 @@ gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify p
     return FALSE;
 }
 
+gboolean player_Scrub(Chunk *pChunk, gint64 nPos, OnNotify pOnNotify)
+{
+    if (pChunk->nFrames == 0)
+    {
+        return TRUE;
+    }
+
+    player_Stop();
+    m_pChunkHandle = chunk_Open(pChunk, TRUE);
+
+    if (m_pChunkHandle == NULL)
+    {
+        return TRUE;
+    }
+
+    g_info("chunk_ref: %d, player_Scrub %p", chunk_AliveCount(), m_pChunkHandle);
+    g_object_ref(m_pChunkHandle);
+
+    guint nChannels = pChunk->pAudioInfo->channels;
+    m_pScrubAudioInfo = gst_audio_info_new();
+    gst_audio_info_set_format(m_pScrubAudioInfo, GST_AUDIO_FORMAT_F32LE, pChunk->pAudioInfo->rate, nChannels, pChunk->pAudioInfo->position);
+
+    // Periodic Hann windows overlapping by three quarters sum to 2, so halve them
+    for (guint nFrame = 0; nFrame < SCRUB_GRAIN; nFrame++)
+    {
+        m_lScrubHann[nFrame] = 0.25 * (1.0 - cos(2.0 * G_PI * nFrame / SCRUB_GRAIN));
+    }
+
+    m_lScrubGrain = g_malloc(SCRUB_GRAIN * nChannels * sizeof(gfloat));
+    m_lScrubOutput = g_malloc0(SCRUB_GRAIN * nChannels * sizeof(gfloat));
+    m_lScrubWindow = g_malloc(SCRUB_WINDOW * nChannels * sizeof(gfloat));
+    m_lScrubWindowSpare = g_malloc(SCRUB_WINDOW * nChannels * sizeof(gfloat));
+    m_nScrubWindowStart = -1;
+    m_nScrubWindowFrames = 0;
+    nPos = CLAMP(nPos, 0, pChunk->nFrames);
+    m_nScrubTarget = nPos;
+    m_fScrubPos = (gdouble)nPos;
+    m_fScrubSpeed = 0.0;
+    m_bScrubQuit = FALSE;
+
+    m_nStartPos = 0;
+    m_nEndPos = pChunk->nFrames;
+    m_nCurPos = nPos;
+    m_bPlaying = TRUE;
+    m_bScrubbing = TRUE;
+    m_pOnNotify = pOnNotify;
+    m_pScrubThread = g_thread_new("scrub", player_OnScrubPrefetch, NULL);
+    m_pGstPlayer = gstplayer_NewScrub(m_pScrubAudioInfo, SCRUB_HOP, player_OnGetScrubFrames);
+    g_timeout_add(40, player_OnNotify, NULL);
+
+    return FALSE;
+}
+
+void player_ScrubTo(gint64 nPos)
+{
+    if (!m_bScrubbing)
+    {
+        return;
+    }
+
+    g_mutex_lock(&m_pScrubMutex);
+    m_nScrubTarget = CLAMP(nPos, 0, m_nEndPos);
+    g_cond_signal(&m_pScrubCond);
+    g_mutex_unlock(&m_pScrubMutex);
+}
+
+static void player_ScrubFree()
+{
+    g_mutex_lock(&m_pScrubMutex);
+    m_bScrubQuit = TRUE;
+    g_cond_signal(&m_pScrubCond);
+    g_mutex_unlock(&m_pScrubMutex);
+    g_thread_join(m_pScrubThread);
+    m_pScrubThread = NULL;
+
+    g_free(m_lScrubGrain);
+    g_free(m_lScrubOutput);
+    g_free(m_lScrubWindow);
+    g_free(m_lScrubWindowSpare);
+    m_lScrubGrain = m_lScrubOutput = m_lScrubWindow = m_lScrubWindowSpare = NULL;
+    gst_audio_info_free(m_pScrubAudioInfo);
+    m_pScrubAudioInfo = NULL;
+    m_bScrubbing = FALSE;
+}
+
 void player_SetPos(gint64 nPos)
 {
+    if (m_bScrubbing)
+    {
+        player_ScrubTo(nPos);
+
+        return;
+    }
+
+    G_LOCK(PLAYER_LOCK);
+
+    // Outside the loop there is nothing to come back to, start over at its beginning
+    if (m_bLoop && m_nEndPos > m_nStartPos && (nPos < m_nStartPos || nPos >= m_nEndPos))
+    {
+        nPos = m_nStartPos;
+    }
+
     m_nCurPos = nPos;
+    m_nPipelinePos = nPos;
+    player_ClearWraps();
+    G_UNLOCK(PLAYER_LOCK);
+
     gstbase_Seek(m_pGstPlayer->pGstBase, nPos);
 }
 
@@ -117,6 +814,48 @@ void player_Stop()
         gstplayer_Free(m_pGstPlayer);
         m_pGstPlayer = NULL;
     }
+
+    // A scrub leaves the cursor where it was heard last, that is the edit point being looked for
+    gint64 nNotifyPos = -1;
+
+    if (m_bScrubbing)
+    {
+        nNotifyPos = m_nCurPos;
+        player_ScrubFree();
+    }
+
+    player_ClearPreview();
+
+    if (m_pSwitchThread != NULL)
+    {
+        g_thread_join(m_pSwitchThread);
+        m_pSwitchThread = NULL;
+    }
+
+    if (m_pSwitchHandle != NULL)
+    {
+        m_lRetiredHandles = g_list_prepend(m_lRetiredHandles, m_pSwitchHandle);
+        m_pSwitchHandle = NULL;
+    }
+
+    for (GList *l = m_lRetiredHandles; l != NULL; l = l->next)
+    {
+        ChunkHandle *pChunkHandle = (ChunkHandle *)l->data;
+        chunk_Close(pChunkHandle, TRUE);
+        g_info("chunk_unref: %d, player:player_Stop %p", chunk_AliveCount(), pChunkHandle);
+        g_object_unref(pChunkHandle);
+    }
+
+    g_list_free(m_lRetiredHandles);
+    m_lRetiredHandles = NULL;
+    g_free(m_lSwitchBuffer);
+    m_lSwitchBuffer = NULL;
+    g_free(m_lLoopBuffer);
+    m_lLoopBuffer = NULL;
+    m_nLoopBufferFrames = 0;
+    player_ClearWraps();
+    m_nSwitchBufferFrames = 0;
+    m_bSwitchStop = FALSE;
         
     if (m_pChunkHandle != NULL)
     {
@@ -126,7 +865,7 @@ void player_Stop()
         m_pChunkHandle = NULL;
     }
         
-    m_pOnNotify(-1, FALSE);
+    m_pOnNotify(nNotifyPos, FALSE);
     
     G_UNLOCK(PLAYER_LOCK);
 }
@@ -143,8 +882,32 @@ gint64 player_GetPos()
 
 void player_ChangeRange(gint64 nStart, gint64 nEnd)
 {
+    G_LOCK(PLAYER_LOCK);
     m_nStartPos = nStart;
     m_nEndPos = nEnd;
+    G_UNLOCK(PLAYER_LOCK);
+
+    if (m_bLoop && m_bPlaying && !m_bScrubbing)
+    {
+        player_PrefetchLoop();
+    }
+}
+
+void player_SetLoop(gboolean bLoop)
+{
+    if (bLoop && m_bPlaying && !m_bScrubbing)
+    {
+        player_PrefetchLoop();
+    }
+
+    G_LOCK(PLAYER_LOCK);
+    m_bLoop = bLoop;
+    G_UNLOCK(PLAYER_LOCK);
+}
+
+gboolean player_GetLoop()
+{
+    return m_bLoop;
 }
 
 void player_Switch(Chunk *pChunk, gint64 nMoveStart, gint64 nMoveDist)
@@ -154,58 +917,38 @@ void player_Switch(Chunk *pChunk, gint64 nMoveStart, gint64 nMoveDist)
         return;
     }
 
-    gint64 nNewPos = m_nCurPos;
-
-    if (nNewPos >= nMoveStart)
+    if (m_bScrubbing)
     {
-        nNewPos += nMoveDist;
+        player_Stop();
 
-        if (nNewPos < nMoveStart)
-        {
-            player_Stop();
-            
-            return;
-        }
-
-        if (nNewPos > pChunk->nFrames)
-        {
-            player_Stop();
-            
-            return;
-        }
+        return;
     }
 
-    gint64 nNewStart = m_nStartPos;
-    ;
-    if (nNewStart >= nMoveStart)
+    // The preview was set up for frame positions of the old chunk
+    if (m_bPreview)
     {
-        nNewStart += nMoveDist;
-
-        if (nNewStart < nMoveStart)
-        {
-            nNewStart = nMoveStart;
-        }
+        G_LOCK(PLAYER_LOCK);
+        player_ClearPreview();
+        G_UNLOCK(PLAYER_LOCK);
+    }
 
-        if (nNewStart >= pChunk->nFrames)
-        {
-            nNewStart = pChunk->nFrames;
-        }
+    // Moves are relative to the chunk before them, so an earlier switch still waiting has to happen first
+    if (player_FinishSwitch())
+    {
+        return;
     }
 
-    gint64 nNewEnd = m_nEndPos;
+    gint64 nNewPos = m_nCurPos;
 
-    if (nNewEnd >= nMoveStart)
+    if (nNewPos >= nMoveStart)
     {
-        nNewEnd += nMoveDist;
-
-        if (nNewEnd < nMoveStart)
-        {
-            nNewEnd = nMoveStart;
-        }
+        nNewPos += nMoveDist;
 
-        if (nNewEnd >= pChunk->nFrames)
+        if (nNewPos < nMoveStart || nNewPos > pChunk->nFrames)
         {
-            nNewEnd = pChunk->nFrames;
+            player_Stop();
+            
+            return;
         }
     }
 
@@ -216,14 +959,22 @@ void player_Switch(Chunk *pChunk, gint64 nMoveStart, gint64 nMoveDist)
         return;
     }
 
-    chunk_Close(m_pChunkHandle, TRUE);
-    g_info("chunk_unref: %d, player:player_Switch %p", chunk_AliveCount(), m_pChunkHandle);
-    g_object_unref(m_pChunkHandle);
-    m_pChunkHandle = pChunkHandle;
-    g_info("chunk_ref: %d, player:player_Switch %p", chunk_AliveCount(), m_pChunkHandle);
-    g_object_ref(m_pChunkHandle);
+    g_info("chunk_ref: %d, player:player_Switch %p", chunk_AliveCount(), pChunkHandle);
+    g_object_ref(pChunkHandle);
+
+    if (m_lSwitchBuffer == NULL)
+    {
+        m_lSwitchBuffer = g_malloc(BUFFER_SIZE);
+    }
+
+    G_LOCK(PLAYER_LOCK);
+    m_pSwitchHandle = pChunkHandle;
+    m_nSwitchMoveStart = nMoveStart;
+    m_nSwitchMoveDist = nMoveDist;
+    m_nSwitchBufferStart = nNewPos;
+    m_nSwitchBufferFrames = 0;
+    g_atomic_int_set(&m_bSwitchReady, FALSE);
+    G_UNLOCK(PLAYER_LOCK);
 
-    m_nStartPos = nNewStart;
-    m_nEndPos = nNewEnd;
-    m_nCurPos = nNewPos;
+    m_pSwitchThread = g_thread_new("switch", player_OnSwitchPrefetch, NULL);
 }
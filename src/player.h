@@ -24,14 +24,30 @@
 #include <glib.h>
 #include "chunk.h"
 
-typedef void (*OnNotify)(gint nPos, gboolean is_running);
+typedef void (*OnNotify)(gint64 nPos, gboolean is_running);
 
-gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify pOnNotify);
+typedef struct
+{
+    gint64 nStart;
+    gint64 nFrames;
+    gfloat fStartFactor;
+    gfloat fEndFactor;
+    Chunk *pMixChunk;
+
+} PlayerPreview;
+
+gboolean player_Play(Chunk *pChunk, gint64 nStartPos, gint64 nEndPos, OnNotify pOnNotify, PlayerPreview *pPreview);
+gboolean player_Scrub(Chunk *pChunk, gint64 nPos, OnNotify pOnNotify);
+void player_ScrubTo(gint64 nPos);
 void player_SetPos(gint64 nPos);
 void player_Stop();
 gboolean player_Playing();
 gint64 player_GetPos();
 void player_ChangeRange(gint64 nStart, gint64 nEnd);
+void player_SetLoop(gboolean bLoop);
+gboolean player_GetLoop();
 void player_Switch(Chunk *pChunk, gint64 nMoveStart, gint64 nMoveDist);
+gboolean player_SetPreview(PlayerPreview *pPreview);
+gboolean player_GetPreview(PlayerPreview *pPreview);
 
 #endif
@@ -0,0 +1,47 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include "progress.h"
+
+void progress_Begin(Progress *pProgress, gchar *sDescription)
+{
+    if (pProgress && pProgress->pOnBegin)
+    {
+        pProgress->pOnBegin(sDescription, pProgress->pUserData);
+    }
+}
+
+gboolean progress_Update(Progress *pProgress, gfloat fProgress)
+{
+    if (pProgress && pProgress->pOnProgress)
+    {
+        return pProgress->pOnProgress(fProgress, pProgress->pUserData);
+    }
+
+    return FALSE;
+}
+
+void progress_End(Progress *pProgress)
+{
+    if (pProgress && pProgress->pOnEnd)
+    {
+        pProgress->pOnEnd(pProgress->pUserData);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef PROGRESS_H_INCLUDED
+#define PROGRESS_H_INCLUDED
+
+#include <glib.h>
+
+typedef void (*OnProgressBegin)(gchar *sDescription, gpointer pUserData);
+typedef gboolean (*OnProgress)(gfloat fProgress, gpointer pUserData);
+typedef void (*OnProgressEnd)(gpointer pUserData);
+
+typedef struct
+{
+    OnProgressBegin pOnBegin;
+    OnProgress pOnProgress;
+    OnProgressEnd pOnEnd;
+    gpointer pUserData;
+
+} Progress;
+
+void progress_Begin(Progress *pProgress, gchar *sDescription);
+gboolean progress_Update(Progress *pProgress, gfloat fProgress);
+void progress_End(Progress *pProgress);
+
+#endif
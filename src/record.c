@@ -0,0 +1,313 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <glib/gi18n.h>
+#include "record.h"
+#include "tempfile.h"
+#include "ringbuf.h"
+#include "scratch.h"
+#include "message.h"
+#include "counters.h"
+#include "main.h"
+
+#define RECORD_RING_SECONDS 10
+#define RECORD_POLL_TIME 5000
+#define RECORD_REFRESH_TIME 250
+
+G_LOCK_DEFINE(RECORD_LOCK);
+
+static GstRecorder *m_pGstRecorder = NULL;
+static GstAudioInfo *m_pAudioInfo = NULL;
+static TempFile *m_pTempFile = NULL;
+static Ringbuf *m_pRingbuf = NULL;
+static GThread *m_pWriterThread = NULL;
+static gint m_bWriterStop = FALSE;
+static gint m_bWriteError = FALSE;
+static gint m_nOverruns = 0;
+static gboolean m_bCapturing = FALSE;
+static gint64 m_nFramesWritten = 0;
+static DataSource *m_pDataSource = NULL;
+static guint m_nTimeoutId = 0;
+static OnRecord m_pOnRecord = NULL;
+static gpointer m_pUserData = NULL;
+
+static GstAudioInfo *record_LoadSettings(gchar **sSource)
+{
+    guint nChannels = 2;
+    guint nRate = 48000;
+    *sSource = g_strdup("autoaudiosrc");
+    GSettings *pSettings = getSettings("record-source");
+
+    if (pSettings != NULL)
+    {
+        gchar *sSetting = g_settings_get_string(pSettings, "record-source");
+
+        if (sSetting != NULL && *sSetting != '\0')
+        {
+            g_free(*sSource);
+            *sSource = sSetting;
+        }
+        else
+        {
+            g_free(sSetting);
+        }
+
+        nChannels = CLAMP(g_settings_get_uint(pSettings, "record-channels"), 1, 64);
+        nRate = CLAMP(g_settings_get_uint(pSettings, "record-rate"), 8000, 384000);
+        g_object_unref(pSettings);
+    }
+
+    GstAudioInfo *pAudioInfo = gst_audio_info_new();
+    gst_audio_info_set_format(pAudioInfo, GST_AUDIO_FORMAT_S24LE, nRate, nChannels, NULL);
+
+    return pAudioInfo;
+}
+
+// Runs on the GStreamer streaming thread, so it only touches the ring
+static void record_OnPutFrames(gchar *lBuffer, guint nBytes, gboolean bDiscont)
+{
+    // After the first buffer a discontinuity means the source itself dropped audio
+    if (bDiscont && m_bCapturing)
+    {
+        g_atomic_int_inc(&m_nOverruns);
+        counters_Add(COUNTER_RECORD_OVERRUNS, 1);
+    }
+
+    m_bCapturing = TRUE;
+
+    // Drop whole buffers only, so the frames that are kept stay aligned
+    if (m_pRingbuf->nBytes - ringbuf_Available(m_pRingbuf) < nBytes)
+    {
+        g_atomic_int_inc(&m_nOverruns);
+        counters_Add(COUNTER_RECORD_OVERRUNS, 1);
+
+        return;
+    }
+
+    ringbuf_Enqueue(m_pRingbuf, lBuffer, nBytes);
+}
+
+static gpointer record_OnWrite(gpointer pData)
+{
+    gchar *lBuffer = g_malloc(BUFFER_SIZE);
+
+    while (TRUE)
+    {
+        // Check before draining, so everything captured before the stop still gets written
+        gboolean bStop = g_atomic_int_get(&m_bWriterStop);
+        guint64 nBytes = ringbuf_Dequeue(m_pRingbuf, lBuffer, BUFFER_SIZE);
+
+        if (nBytes == 0)
+        {
+            if (bStop)
+            {
+                break;
+            }
+
+            g_usleep(RECORD_POLL_TIME);
+
+            continue;
+        }
+
+        if (tempfile_Write(m_pTempFile, lBuffer, nBytes))
+        {
+            g_atomic_int_set(&m_bWriteError, TRUE);
+
+            break;
+        }
+
+        G_LOCK(RECORD_LOCK);
+        m_nFramesWritten = m_pTempFile->nBytesWritten / m_pAudioInfo->bpf;
+        G_UNLOCK(RECORD_LOCK);
+    }
+
+    g_free(lBuffer);
+
+    return NULL;
+}
+
+static void record_Update()
+{
+    G_LOCK(RECORD_LOCK);
+    gint64 nFrames = m_nFramesWritten;
+    G_UNLOCK(RECORD_LOCK);
+
+    if (nFrames == 0 || (m_pDataSource != NULL && m_pDataSource->nFrames == nFrames))
+    {
+        return;
+    }
+
+    // Each take gets its own source, sources are never resized once other threads can read them
+    DataSource *pDataSource = datasource_new();
+    pDataSource->nType = DATASOURCE_TEMPFILE;
+    pDataSource->pAudioInfo = gst_audio_info_copy(m_pAudioInfo);
+    pDataSource->pData.pVirtual.sFilePath = g_strdup(m_pTempFile->pFile->sFilePath);
+    pDataSource->pData.pVirtual.nOffset = m_pTempFile->nDataOffset;
+    pDataSource->nFrames = nFrames;
+    pDataSource->nBytes = nFrames * m_pAudioInfo->bpf;
+    scratch_Ref(pDataSource->pData.pVirtual.sFilePath);
+    scratch_SetSize(pDataSource->pData.pVirtual.sFilePath, m_pTempFile->nDataOffset + pDataSource->nBytes);
+
+    if (m_pDataSource != NULL)
+    {
+        g_info("datasource_unref %d, record:record_Update %p", datasource_Count(), m_pDataSource);
+        g_object_unref(m_pDataSource);
+    }
+
+    m_pDataSource = pDataSource;
+    g_object_ref(m_pDataSource);
+    g_info("datasource_ref %d, record:record_Update %p", datasource_Count(), m_pDataSource);
+    m_pOnRecord(chunk_NewFromDatasource(m_pDataSource), FALSE, m_pUserData);
+}
+
+static gboolean record_OnTimeout(gpointer pUserData)
+{
+    if (g_atomic_int_get(&m_bWriteError))
+    {
+        m_nTimeoutId = 0;
+        message_Error(_("Recording stopped because the temporary file could not be written."));
+        record_Stop();
+
+        return G_SOURCE_REMOVE;
+    }
+
+    record_Update();
+
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean record_Start(OnRecord pOnRecord, gpointer pUserData)
+{
+    if (m_pGstRecorder != NULL)
+    {
+        return TRUE;
+    }
+
+    gchar *sSource = NULL;
+    m_pAudioInfo = record_LoadSettings(&sSource);
+    m_pTempFile = tempfile_InitStream(m_pAudioInfo);
+
+    if (m_pTempFile == NULL)
+    {
+        gst_audio_info_free(m_pAudioInfo);
+        m_pAudioInfo = NULL;
+        g_free(sSource);
+
+        return TRUE;
+    }
+
+    m_pRingbuf = ringbuf_NewSize((guint64)m_pAudioInfo->rate * m_pAudioInfo->bpf * RECORD_RING_SECONDS);
+    m_bWriterStop = FALSE;
+    m_bWriteError = FALSE;
+    m_nOverruns = 0;
+    m_bCapturing = FALSE;
+    m_nFramesWritten = 0;
+    m_pOnRecord = pOnRecord;
+    m_pUserData = pUserData;
+    m_pWriterThread = g_thread_new("record", record_OnWrite, NULL);
+    m_pGstRecorder = gstrecorder_New(sSource, m_pAudioInfo, record_OnPutFrames);
+
+    if (m_pGstRecorder == NULL)
+    {
+        // Translators: %s is a GStreamer pipeline description
+        gchar *sMessage = g_strdup_printf(_("Could not start recording from %s"), sSource);
+        message_Error(sMessage);
+        g_free(sMessage);
+        g_free(sSource);
+        g_atomic_int_set(&m_bWriterStop, TRUE);
+        g_thread_join(m_pWriterThread);
+        m_pWriterThread = NULL;
+        ringbuf_Free(m_pRingbuf);
+        m_pRingbuf = NULL;
+        tempfile_Abort(m_pTempFile);
+        m_pTempFile = NULL;
+        gst_audio_info_free(m_pAudioInfo);
+        m_pAudioInfo = NULL;
+
+        return TRUE;
+    }
+
+    g_free(sSource);
+    m_nTimeoutId = g_timeout_add(RECORD_REFRESH_TIME, record_OnTimeout, NULL);
+
+    return FALSE;
+}
+
+void record_Stop()
+{
+    if (m_pGstRecorder == NULL)
+    {
+        return;
+    }
+
+    if (m_nTimeoutId != 0)
+    {
+        g_source_remove(m_nTimeoutId);
+        m_nTimeoutId = 0;
+    }
+
+    // Once the pipeline is down nothing is added to the ring, the writer drains it and ends
+    gstrecorder_Free(m_pGstRecorder);
+    m_pGstRecorder = NULL;
+    g_atomic_int_set(&m_bWriterStop, TRUE);
+    g_thread_join(m_pWriterThread);
+    m_pWriterThread = NULL;
+    ringbuf_Free(m_pRingbuf);
+    m_pRingbuf = NULL;
+    Chunk *pChunk = NULL;
+
+    if (g_atomic_int_get(&m_bWriteError))
+    {
+        tempfile_Abort(m_pTempFile);
+    }
+    else
+    {
+        pChunk = tempfile_Finished(m_pTempFile);
+    }
+
+    m_pTempFile = NULL;
+
+    if (m_pDataSource != NULL)
+    {
+        g_info("datasource_unref %d, record:record_Stop %p", datasource_Count(), m_pDataSource);
+        g_object_unref(m_pDataSource);
+        m_pDataSource = NULL;
+    }
+
+    gst_audio_info_free(m_pAudioInfo);
+    m_pAudioInfo = NULL;
+    gint nOverruns = g_atomic_int_get(&m_nOverruns);
+
+    if (nOverruns > 0)
+    {
+        gchar *sMessage = g_strdup_printf(_("Audio was lost %d times while recording, the system or the disk could not keep up."), nOverruns);
+        message_Warning(sMessage);
+        g_free(sMessage);
+    }
+
+    m_pOnRecord(pChunk, TRUE, m_pUserData);
+    m_pOnRecord = NULL;
+    m_pUserData = NULL;
+}
+
+gboolean record_Recording()
+{
+    return m_pGstRecorder != NULL;
+}
@@ -26,6 +26,12 @@
 Ringbuf *ringbuf_New()
 {
     guint64 nBytes = (((sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE)) / 2) / BUFFER_SIZE) * BUFFER_SIZE;
+
+    return ringbuf_NewSize(nBytes);
+}
+
+Ringbuf *ringbuf_NewSize(guint64 nBytes)
+{
     Ringbuf *pRingbuf = g_malloc(sizeof(Ringbuf) + nBytes);
     pRingbuf->nBytes = nBytes;
     pRingbuf->nStart = 0;
@@ -41,8 +47,8 @@ void ringbuf_Free(Ringbuf *pRingbuf)
 
 guint64 ringbuf_Available(Ringbuf *pRingbuf)
 {
-    guint64 nStart = pRingbuf->nStart;
-    guint64 nEnd = pRingbuf->nEnd;
+    gsize nStart = (gsize)g_atomic_pointer_get(&pRingbuf->nStart);
+    gsize nEnd = (gsize)g_atomic_pointer_get(&pRingbuf->nEnd);
 
     if (nEnd >= nStart)
     {
@@ -54,12 +60,14 @@ guint64 ringbuf_Available(Ringbuf *pRingbuf)
     }
 }
 
+// Single producer, single consumer: each side publishes its own index after the copy
+
 guint64 ringbuf_Enqueue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
 {
     guint64 nBlockSize;
     guint64 nBytesDone = 0;
-    guint64 nStart = pRingbuf->nStart;
-    guint64 nEnd = pRingbuf->nEnd;
+    gsize nStart = (gsize)g_atomic_pointer_get(&pRingbuf->nStart);
+    gsize nEnd = pRingbuf->nEnd;
 
     if (nEnd >= nStart)
     {
@@ -87,7 +95,7 @@ guint64 ringbuf_Enqueue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
         }
         else
         {
-            pRingbuf->nEnd = nEnd;
+            g_atomic_pointer_set(&pRingbuf->nEnd, nEnd);
             
             return nBlockSize;
         }
@@ -97,7 +105,7 @@ guint64 ringbuf_Enqueue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
 
     if (nBlockSize == 0)
     {
-        pRingbuf->nEnd = nEnd;
+        g_atomic_pointer_set(&pRingbuf->nEnd, nEnd);
         
         return nBytesDone;
     }
@@ -105,7 +113,7 @@ guint64 ringbuf_Enqueue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
     memcpy(pRingbuf->lBytes + nEnd, G_STRUCT_MEMBER_P(lBytes, nBytesDone), nBlockSize);
     nEnd += nBlockSize;
     nBytesDone += nBlockSize;
-    pRingbuf->nEnd = nEnd;
+    g_atomic_pointer_set(&pRingbuf->nEnd, nEnd);
 
     return nBytesDone;
 }
@@ -114,8 +122,8 @@ guint64 ringbuf_Dequeue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
 {
     guint64 nBlockSize;
     guint64 nBytesDone = 0;
-    guint64 nStart = pRingbuf->nStart;
-    guint64 nEnd = pRingbuf->nEnd;
+    gsize nStart = pRingbuf->nStart;
+    gsize nEnd = (gsize)g_atomic_pointer_get(&pRingbuf->nEnd);
 
     if (nStart > nEnd)
     {
@@ -130,7 +138,7 @@ guint64 ringbuf_Dequeue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
         }
         else
         {
-            pRingbuf->nStart = nStart;
+            g_atomic_pointer_set(&pRingbuf->nStart, nStart);
             
             return nBlockSize;
         }
@@ -140,7 +148,7 @@ guint64 ringbuf_Dequeue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
 
     if (nBlockSize == 0)
     {
-        pRingbuf->nStart=nStart;
+        g_atomic_pointer_set(&pRingbuf->nStart, nStart);
         
         return nBytesDone;
     }
@@ -148,7 +156,7 @@ guint64 ringbuf_Dequeue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes)
     memcpy(G_STRUCT_MEMBER_P(lBytes, nBytesDone), pRingbuf->lBytes + nStart, nBlockSize);
     nStart += nBlockSize;
     nBytesDone += nBlockSize;
-    pRingbuf->nStart = nStart;
+    g_atomic_pointer_set(&pRingbuf->nStart, nStart);
 
     return nBytesDone;
 }
@@ -26,15 +26,15 @@
 
 typedef struct
 {
-
-    volatile guint64 nStart;
-    volatile guint64 nEnd;
+    gsize nStart;
+    gsize nEnd;
     guint64 nBytes;
     gchar lBytes[1];
 
 } Ringbuf;
 
 Ringbuf *ringbuf_New();
+Ringbuf *ringbuf_NewSize(guint64 nBytes);
 void ringbuf_Free(Ringbuf *pRingbuf);
 guint64 ringbuf_Available(Ringbuf *pRingbuf);
 guint64 ringbuf_Enqueue(Ringbuf *pRingbuf, gchar *lBytes, guint64 nBytes);
@@ -0,0 +1,505 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include "scratch.h"
+#include "message.h"
+#include "main.h"
+
+#define SCRATCH_PLACEMENT_ROUND_ROBIN 0
+#define SCRATCH_PLACEMENT_FREE_SPACE 1
+
+typedef struct
+{
+    gchar *sPath;
+    guint64 nQuota;
+    guint64 nUsage;
+
+} ScratchDirectory;
+
+typedef struct
+{
+    gint nRefs;
+    guint64 nBytes;
+    ScratchDirectory *pDirectory;
+
+} ScratchFile;
+
+G_LOCK_DEFINE_STATIC(SCRATCH);
+
+static GPtrArray *m_lDirectories = NULL;
+static gint m_nPlacement = SCRATCH_PLACEMENT_FREE_SPACE;
+static guint m_nNext = 0;
+static gint m_nTempfiles = 0;
+static GHashTable *m_lFiles = NULL;
+static GThreadPool *m_pReclaimPool = NULL;
+
+static void scratch_OnReclaim(gpointer pData, gpointer pUserData)
+{
+    gchar *sFilePath = (gchar*)pData;
+
+    if (g_unlink(sFilePath) != 0 && errno != ENOENT)
+    {
+        g_warning("Could not remove scratch file %s: %s", sFilePath, strerror(errno));
+    }
+
+    g_free(sFilePath);
+}
+
+static void scratch_Reclaim(gchar *sFilePath)
+{
+    g_thread_pool_push(m_pReclaimPool, sFilePath, NULL);
+}
+
+static gboolean scratch_IsAlive(gint nPid)
+{
+    if (kill(nPid, 0) != 0 && errno != EPERM)
+    {
+        return FALSE;
+    }
+
+    // The pid may have been reused by an unrelated process since ours died
+    gchar *sCommPath = g_strdup_printf("/proc/%d/comm", nPid);
+    gchar *sComm = NULL;
+    gboolean bAlive = TRUE;
+
+    if (g_file_get_contents(sCommPath, &sComm, NULL, NULL))
+    {
+        bAlive = g_str_has_prefix(sComm, "odio-edit");
+        g_free(sComm);
+    }
+
+    g_free(sCommPath);
+
+    return bAlive;
+}
+
+static void scratch_Sweep(ScratchDirectory *pDirectory)
+{
+    GDir *pDir = g_dir_open(pDirectory->sPath, 0, NULL);
+
+    if (pDir == NULL)
+    {
+        return;
+    }
+
+    const gchar *sName;
+
+    while ((sName = g_dir_read_name(pDir)) != NULL)
+    {
+        gint nPid;
+        gint nIndex;
+        gint nLength = 0;
+
+        gchar *sPath = g_build_filename(pDirectory->sPath, sName, NULL);
+        GStatBuf cStat;
+
+        if (sscanf(sName, "%d-%d.wav%n", &nPid, &nIndex, &nLength) == 2 && nLength == (gint)strlen(sName) && nPid != getpid() && !scratch_IsAlive(nPid))
+        {
+            g_info("Reclaiming orphaned scratch file %s", sName);
+            scratch_Reclaim(sPath);
+        }
+        else
+        {
+            // Whatever stays counts against the quota; it is only walked here, later changes are tracked in the file table
+            if (g_stat(sPath, &cStat) == 0 && S_ISREG(cStat.st_mode))
+            {
+                pDirectory->nUsage += cStat.st_size;
+            }
+
+            g_free(sPath);
+        }
+    }
+
+    g_dir_close(pDir);
+}
+
+static void scratch_FreeDirectory(gpointer pData)
+{
+    ScratchDirectory *pDirectory = (ScratchDirectory*)pData;
+    g_free(pDirectory->sPath);
+    g_free(pDirectory);
+}
+
+static void scratch_AddDirectory(const gchar *sPath, guint64 nQuotaMiB)
+{
+    if (g_mkdir_with_parents(sPath, 0755) != 0 || access(sPath, W_OK) != 0)
+    {
+        g_warning("Scratch directory %s is not writable, skipping it", sPath);
+
+        return;
+    }
+
+    ScratchDirectory *pDirectory = g_malloc(sizeof(ScratchDirectory));
+    pDirectory->sPath = g_canonicalize_filename(sPath, NULL);
+    pDirectory->nQuota = nQuotaMiB * 1024 * 1024;
+    pDirectory->nUsage = 0;
+    g_ptr_array_add(m_lDirectories, pDirectory);
+}
+
+gboolean scratch_Init()
+{
+    m_lDirectories = g_ptr_array_new_with_free_func(scratch_FreeDirectory);
+    m_lFiles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    m_pReclaimPool = g_thread_pool_new(scratch_OnReclaim, NULL, 1, FALSE, NULL);
+
+    GSettings *pSettings = getSettings("scratch-directories");
+
+    if (pSettings != NULL)
+    {
+        gchar **lPaths = g_settings_get_strv(pSettings, "scratch-directories");
+        GVariant *pQuotas = g_settings_get_value(pSettings, "scratch-quotas");
+        gsize nQuotas = 0;
+        const guint64 *lQuotas = g_variant_get_fixed_array(pQuotas, &nQuotas, sizeof(guint64));
+        gchar *sPlacement = g_settings_get_string(pSettings, "scratch-placement");
+
+        for (guint nPath = 0; lPaths[nPath] != NULL; nPath++)
+        {
+            scratch_AddDirectory(lPaths[nPath], nPath < nQuotas ? lQuotas[nPath] : 0);
+        }
+
+        if (g_str_equal(sPlacement, "round-robin"))
+        {
+            m_nPlacement = SCRATCH_PLACEMENT_ROUND_ROBIN;
+        }
+
+        g_free(sPlacement);
+        g_variant_unref(pQuotas);
+        g_strfreev(lPaths);
+        g_object_unref(pSettings);
+    }
+
+    // Per user, another user's directory in the shared temporary directory is usually not writable
+    if (m_lDirectories->len == 0)
+    {
+        gchar *sName = g_strdup_printf("odio-edit-%u", (guint)getuid());
+        gchar *sPath = g_build_filename(g_get_tmp_dir(), sName, NULL);
+        scratch_AddDirectory(sPath, 0);
+        g_free(sPath);
+        g_free(sName);
+    }
+
+    if (m_lDirectories->len == 0)
+    {
+        message_Error(_("None of the scratch directories is writable. Set scratch-directories to a directory you can write to."));
+
+        return TRUE;
+    }
+
+    for (guint nDirectory = 0; nDirectory < m_lDirectories->len; nDirectory++)
+    {
+        scratch_Sweep(g_ptr_array_index(m_lDirectories, nDirectory));
+    }
+
+    return FALSE;
+}
+
+void scratch_Free()
+{
+    GHashTableIter cIter;
+    gpointer pKey;
+    g_hash_table_iter_init(&cIter, m_lFiles);
+
+    while (g_hash_table_iter_next(&cIter, &pKey, NULL))
+    {
+        g_warning("Scratch file %s is still referenced on exit", (gchar*)pKey);
+        scratch_Reclaim(g_strdup(pKey));
+    }
+
+    g_thread_pool_free(m_pReclaimPool, FALSE, TRUE);
+    m_pReclaimPool = NULL;
+    g_hash_table_destroy(m_lFiles);
+    m_lFiles = NULL;
+    g_ptr_array_free(m_lDirectories, TRUE);
+    m_lDirectories = NULL;
+}
+
+static guint64 scratch_GetRoom(ScratchDirectory *pDirectory)
+{
+    struct statvfs cStat;
+
+    if (statvfs(pDirectory->sPath, &cStat) != 0)
+    {
+        return 0;
+    }
+
+    guint64 nRoom = (guint64)cStat.f_bavail * cStat.f_frsize;
+
+    if (pDirectory->nQuota != 0)
+    {
+        nRoom = MIN(nRoom, pDirectory->nUsage < pDirectory->nQuota ? pDirectory->nQuota - pDirectory->nUsage : 0);
+    }
+
+    return nRoom;
+}
+
+static ScratchDirectory *scratch_Select(gint64 nBytes, gboolean bFallback)
+{
+    guint nDirectories = m_lDirectories->len;
+    guint64 *lRoom = g_newa(guint64, nDirectories);
+    guint64 nRoomTotal = 0;
+    guint nLargest = 0;
+
+    for (guint nDirectory = 0; nDirectory < nDirectories; nDirectory++)
+    {
+        lRoom[nDirectory] = scratch_GetRoom(g_ptr_array_index(m_lDirectories, nDirectory));
+
+        if (lRoom[nDirectory] > lRoom[nLargest])
+        {
+            nLargest = nDirectory;
+        }
+
+        if (lRoom[nDirectory] < (guint64)nBytes)
+        {
+            lRoom[nDirectory] = 0;
+        }
+
+        nRoomTotal += lRoom[nDirectory];
+    }
+
+    if (nRoomTotal == 0)
+    {
+        return bFallback ? g_ptr_array_index(m_lDirectories, nLargest) : NULL;
+    }
+
+    if (m_nPlacement == SCRATCH_PLACEMENT_ROUND_ROBIN)
+    {
+        for (guint nTry = 0; nTry < nDirectories; nTry++)
+        {
+            guint nDirectory = (m_nNext + nTry) % nDirectories;
+
+            if (lRoom[nDirectory] > 0)
+            {
+                m_nNext = nDirectory + 1;
+
+                return g_ptr_array_index(m_lDirectories, nDirectory);
+            }
+        }
+    }
+
+    // Weight the choice by free room, so larger volumes take a larger share of the files
+    guint64 nPick = (guint64)(g_random_double() * (gdouble)nRoomTotal);
+
+    for (guint nDirectory = 0; nDirectory < nDirectories; nDirectory++)
+    {
+        if (nPick < lRoom[nDirectory])
+        {
+            return g_ptr_array_index(m_lDirectories, nDirectory);
+        }
+
+        nPick -= lRoom[nDirectory];
+    }
+
+    return g_ptr_array_index(m_lDirectories, nLargest);
+}
+
+static void scratch_Register(gchar *sPath, ScratchDirectory *pDirectory, guint64 nBytes)
+{
+    ScratchFile *pFile = g_malloc(sizeof(ScratchFile));
+    pFile->nRefs = 1;
+    pFile->nBytes = nBytes;
+    pFile->pDirectory = pDirectory;
+
+    if (pDirectory != NULL)
+    {
+        pDirectory->nUsage += nBytes;
+    }
+
+    g_hash_table_insert(m_lFiles, g_strdup(sPath), pFile);
+}
+
+static ScratchDirectory *scratch_FindDirectory(gchar *sFilePath)
+{
+    gchar *sDirectory = g_path_get_dirname(sFilePath);
+    gchar *sCanonical = g_canonicalize_filename(sDirectory, NULL);
+    ScratchDirectory *pFound = NULL;
+
+    for (guint nDirectory = 0; nDirectory < m_lDirectories->len && pFound == NULL; nDirectory++)
+    {
+        ScratchDirectory *pDirectory = g_ptr_array_index(m_lDirectories, nDirectory);
+
+        if (g_str_equal(pDirectory->sPath, sCanonical))
+        {
+            pFound = pDirectory;
+        }
+    }
+
+    g_free(sCanonical);
+    g_free(sDirectory);
+
+    return pFound;
+}
+
+gchar *scratch_GetDirectory(gint64 nBytes)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchDirectory *pDirectory = scratch_Select(nBytes, TRUE);
+    gchar *sPath = g_strconcat(pDirectory->sPath, G_DIR_SEPARATOR_S, NULL);
+
+    G_UNLOCK(SCRATCH);
+
+    return sPath;
+}
+
+gchar *scratch_GetFileName(gint64 nBytes)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchDirectory *pDirectory = scratch_Select(nBytes, TRUE);
+    gchar *sName = g_strdup_printf("%d-%04d.wav", (gint)getpid(), ++m_nTempfiles);
+    gchar *sPath = g_build_filename(pDirectory->sPath, sName, NULL);
+    g_free(sName);
+    scratch_Register(sPath, pDirectory, MAX(nBytes, 0));
+
+    G_UNLOCK(SCRATCH);
+
+    return sPath;
+}
+
+gchar *scratch_Adopt(gchar *sFilePath)
+{
+    G_LOCK(SCRATCH);
+
+    gchar *sDirectory = g_path_get_dirname(sFilePath);
+    gchar *sName = g_strdup_printf("%d-%04d.wav", (gint)getpid(), ++m_nTempfiles);
+    gchar *sPath = g_build_filename(sDirectory, sName, NULL);
+    g_free(sDirectory);
+    g_free(sName);
+
+    if (g_rename(sFilePath, sPath) != 0)
+    {
+        g_warning("Could not rename %s to %s: %s", sFilePath, sPath, strerror(errno));
+        g_free(sPath);
+        sPath = g_strdup(sFilePath);
+    }
+
+    GStatBuf cStat;
+    scratch_Register(sPath, scratch_FindDirectory(sPath), (g_stat(sPath, &cStat) == 0) ? cStat.st_size : 0);
+
+    G_UNLOCK(SCRATCH);
+
+    return sPath;
+}
+
+// Files are charged at their expected size when named and at their real size once written
+void scratch_SetSize(gchar *sFilePath, gint64 nBytes)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchFile *pFile = g_hash_table_lookup(m_lFiles, sFilePath);
+
+    if (pFile != NULL && pFile->pDirectory != NULL)
+    {
+        pFile->pDirectory->nUsage -= MIN(pFile->pDirectory->nUsage, pFile->nBytes);
+        pFile->pDirectory->nUsage += MAX(nBytes, 0);
+    }
+
+    if (pFile != NULL)
+    {
+        pFile->nBytes = MAX(nBytes, 0);
+    }
+
+    G_UNLOCK(SCRATCH);
+}
+
+void scratch_Ref(gchar *sFilePath)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchFile *pFile = g_hash_table_lookup(m_lFiles, sFilePath);
+
+    g_assert(pFile != NULL);
+
+    pFile->nRefs++;
+
+    G_UNLOCK(SCRATCH);
+}
+
+void scratch_Unref(gchar *sFilePath)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchFile *pFile = g_hash_table_lookup(m_lFiles, sFilePath);
+
+    if (pFile == NULL)
+    {
+        g_warning("Scratch file %s is not registered", sFilePath);
+    }
+    else if (--pFile->nRefs == 0)
+    {
+        if (pFile->pDirectory != NULL)
+        {
+            pFile->pDirectory->nUsage -= MIN(pFile->pDirectory->nUsage, pFile->nBytes);
+        }
+
+        g_hash_table_remove(m_lFiles, sFilePath);
+        scratch_Reclaim(g_strdup(sFilePath));
+    }
+
+    G_UNLOCK(SCRATCH);
+}
+
+guint scratch_Count()
+{
+    G_LOCK(SCRATCH);
+
+    guint nFiles = g_hash_table_size(m_lFiles);
+
+    G_UNLOCK(SCRATCH);
+
+    return nFiles;
+}
+
+gboolean scratch_HasRoom(gint64 nBytes)
+{
+    G_LOCK(SCRATCH);
+
+    ScratchDirectory *pDirectory = scratch_Select(nBytes, FALSE);
+
+    G_UNLOCK(SCRATCH);
+
+    return (pDirectory != NULL);
+}
+
+gboolean scratch_Check(gint64 nBytes)
+{
+    if (!scratch_HasRoom(nBytes))
+    {
+        gchar *sSize = g_format_size(nBytes);
+        // Translators: %s will be a size, for example "1.2 GB"
+        gchar *sMessage = g_strdup_printf(_("None of the scratch directories has room for %s of temporary data. Free some space or add a scratch directory."), sSize);
+        message_Error(sMessage);
+        g_free(sMessage);
+        g_free(sSize);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
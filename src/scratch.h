@@ -0,0 +1,38 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef SCRATCH_H_INCLUDED
+#define SCRATCH_H_INCLUDED
+
+#include <glib.h>
+
+gboolean scratch_Init();
+void scratch_Free();
+gchar *scratch_GetDirectory(gint64 nBytes);
+gchar *scratch_GetFileName(gint64 nBytes);
+gboolean scratch_HasRoom(gint64 nBytes);
+gboolean scratch_Check(gint64 nBytes);
+gchar *scratch_Adopt(gchar *sFilePath);
+void scratch_SetSize(gchar *sFilePath, gint64 nBytes);
+void scratch_Ref(gchar *sFilePath);
+void scratch_Unref(gchar *sFilePath);
+guint scratch_Count();
+
+#endif
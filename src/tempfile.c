@@ -21,10 +21,12 @@
 
 #include "tempfile.h"
 #include "main.h"
+#include "trace.h"
+#include "scratch.h"
 
-G_LOCK_DEFINE_STATIC(TEMPFILE);
+#define TEMPFILE_DS64_SIZE 28
 
-static gint m_nTempfiles = 0;
+static gboolean m_bFloatIntermediates = FALSE;
 
 static guint8 *tempfile_CopyLE16(guint8 *lBytes, guint16 nValue)
 {
@@ -56,54 +58,94 @@ static guint8 *tempfile_CopyBE32(guint8 *lBytes, guint32 nValue)
     return lBytes + 4;
 }
 
-static gboolean tempfile_WriteWavHeader(File *pFile, GstAudioInfo *pAudioInfo, gint64 nBytes)
-{    
-    guint32 nLength = nBytes + 36;
+static guint8 *tempfile_CopyLE64(guint8 *lBytes, guint64 nValue)
+{
+    memcpy(lBytes, &nValue, 8);
 
-    if (pAudioInfo->finfo->flags & GST_AUDIO_FORMAT_FLAG_FLOAT)
-    {
-        nLength = nBytes + 50;
-    }
-    
-    if (GUINT32(nLength) < nBytes)
+    return lBytes + 8;
+}
+
+static gint64 tempfile_GetRiffSize(GstAudioInfo *pAudioInfo, gint64 nBytes)
+{
+    gboolean bFloat = pAudioInfo->finfo->flags & GST_AUDIO_FORMAT_FLAG_FLOAT;
+
+    return nBytes + (bFloat ? 50 : 36) + 8 + TEMPFILE_DS64_SIZE;
+}
+
+// RIFX has no 64-bit form, so big-endian data has to stay below 4 GiB
+static gboolean tempfile_HasRoom(GstAudioInfo *pAudioInfo, gint64 nBytes)
+{
+    return pAudioInfo->finfo->endianness != G_BIG_ENDIAN || tempfile_GetRiffSize(pAudioInfo, nBytes) <= 0xFFFFFFFF;
+}
+
+// The header always reserves room for a ds64 chunk as JUNK, so it keeps its size when the file turns into RF64
+static gboolean tempfile_WriteWavHeader(File *pFile, GstAudioInfo *pAudioInfo, gint64 nBytes)
+{
+    if (!tempfile_HasRoom(pAudioInfo, nBytes))
     {
-        nLength = 0xFFFFFFFF;
+        return TRUE;
     }
-    
-    guint8 lBuffer[58];
+
+    gboolean bBigEndian = pAudioInfo->finfo->endianness == G_BIG_ENDIAN;
+    gboolean bFloat = pAudioInfo->finfo->flags & GST_AUDIO_FORMAT_FLAG_FLOAT;
+    gint64 nRiffSize = tempfile_GetRiffSize(pAudioInfo, nBytes);
+    gint64 nSamples = nBytes / pAudioInfo->bpf;
+    gboolean bRF64 = nRiffSize > 0xFFFFFFFF;
+    guint8 lBuffer[58 + 8 + TEMPFILE_DS64_SIZE];
     guint8 *pBuffer = lBuffer;
 
-    if (pAudioInfo->finfo->endianness == G_BIG_ENDIAN)
+    if (bBigEndian)
     {
         memcpy(pBuffer, "RIFX", 4);
     }
+    else if (bRF64)
+    {
+        memcpy(pBuffer, "RF64", 4);
+    }
     else
     {
         memcpy(pBuffer, "RIFF", 4);
     }
 
     pBuffer += 4;
-    pBuffer = (pAudioInfo->finfo->endianness == G_BIG_ENDIAN) ? tempfile_CopyBE32(pBuffer, nLength) : tempfile_CopyLE32(pBuffer, nLength);
+    guint32 nLength = bRF64 ? 0xFFFFFFFF : GUINT32(MIN(nRiffSize, 0xFFFFFFFF));
+    pBuffer = bBigEndian ? tempfile_CopyBE32(pBuffer, nLength) : tempfile_CopyLE32(pBuffer, nLength);
+    memcpy(pBuffer, bRF64 ? "WAVEds64" : "WAVEJUNK", 8);
+    pBuffer += 8;
+    pBuffer = bBigEndian ? tempfile_CopyBE32(pBuffer, TEMPFILE_DS64_SIZE) : tempfile_CopyLE32(pBuffer, TEMPFILE_DS64_SIZE);
 
-    if (pAudioInfo->finfo->flags & GST_AUDIO_FORMAT_FLAG_FLOAT)
+    if (bRF64)
     {
-        memcpy(pBuffer, "WAVEfmt \22\0\0\0\3\0", 14);
+        pBuffer = tempfile_CopyLE64(pBuffer, nRiffSize);
+        pBuffer = tempfile_CopyLE64(pBuffer, nBytes);
+        pBuffer = tempfile_CopyLE64(pBuffer, bFloat ? nSamples : 0);
+        pBuffer = tempfile_CopyLE32(pBuffer, 0);
     }
     else
     {
-        if (pAudioInfo->finfo->endianness == G_BIG_ENDIAN)
+        memset(pBuffer, 0, TEMPFILE_DS64_SIZE);
+        pBuffer += TEMPFILE_DS64_SIZE;
+    }
+
+    if (bFloat)
+    {
+        memcpy(pBuffer, "fmt \22\0\0\0\3\0", 10);
+    }
+    else
+    {
+        if (bBigEndian)
         {
-            memcpy(pBuffer, "WAVEfmt \0\0\0\20\0\1", 14);
+            memcpy(pBuffer, "fmt \0\0\0\20\0\1", 10);
         }
         else
         {
-            memcpy(pBuffer, "WAVEfmt \20\0\0\0\1\0", 14);
+            memcpy(pBuffer, "fmt \20\0\0\0\1\0", 10);
         }
     }
 
-    pBuffer += 14;
+    pBuffer += 10;
 
-    if (pAudioInfo->finfo->endianness == G_BIG_ENDIAN)
+    if (bBigEndian)
     {
         pBuffer = tempfile_CopyBE16(pBuffer, pAudioInfo->channels);
         pBuffer = tempfile_CopyBE32(pBuffer, pAudioInfo->rate);
@@ -120,49 +162,44 @@ static gboolean tempfile_WriteWavHeader(File *pFile, GstAudioInfo *pAudioInfo, g
         pBuffer = tempfile_CopyLE16(pBuffer, pAudioInfo->finfo->width);
     }
 
-    if (pAudioInfo->finfo->flags & GST_AUDIO_FORMAT_FLAG_FLOAT)
+    if (bFloat)
     {
         memcpy(pBuffer, "\0\0fact\4\0\0\0", 10);
         pBuffer += 10;
-        nLength = nBytes / pAudioInfo->bpf;
-
-        if (((gint64)nLength) < nBytes / pAudioInfo->bpf)
-        {
-            nLength = 0xFFFFFFFF;
-        }
-
+        nLength = bRF64 ? 0xFFFFFFFF : GUINT32(MIN(nSamples, 0xFFFFFFFF));
         pBuffer = tempfile_CopyLE32(pBuffer, nLength);
     }
 
     memcpy(pBuffer, "data", 4);
     pBuffer += 4;
-    nLength = GUINT32(nBytes);
-
-    if (GUINT32(nLength) < nBytes)
-    {
-        nLength = 0xFFFFFFFF;
-    }
-    
-    pBuffer = (pAudioInfo->finfo->endianness == G_BIG_ENDIAN) ? tempfile_CopyBE32(pBuffer, nLength) : tempfile_CopyLE32(pBuffer, nLength);
+    nLength = bRF64 ? 0xFFFFFFFF : GUINT32(MIN(nBytes, 0xFFFFFFFF));
+    pBuffer = bBigEndian ? tempfile_CopyBE32(pBuffer, nLength) : tempfile_CopyLE32(pBuffer, nLength);
 
     return file_Write((gchar *)lBuffer, (guint)((pBuffer - (guint8 *)lBuffer)), pFile);
 }
 
-gchar *tempfile_GetFileName()
+void tempfile_LoadSettings()
 {
-    G_LOCK(TEMPFILE);
-
-    gchar *sFileName = g_strdup_printf("/tmp/odio-edit/%d-%04d.wav", (gint)getpid(), ++m_nTempfiles);
-
-    G_UNLOCK(TEMPFILE);
+    GSettings *pSettings = getSettings("float-intermediates");
 
-    return sFileName;
+    if (pSettings != NULL)
+    {
+        m_bFloatIntermediates = g_settings_get_boolean(pSettings, "float-intermediates");
+        g_object_unref(pSettings);
+    }
 }
 
-TempFile* tempfile_Init(GstAudioInfo *pAudioInfo)
+TempFile* tempfile_Init(GstAudioInfo *pAudioInfo, gint64 nBytesExpected)
 {
+    if (scratch_Check(nBytesExpected))
+    {
+        return NULL;
+    }
+
     TempFile *pTempFile = g_malloc(sizeof(TempFile));
     pTempFile->pAudioInfo = pAudioInfo;
+    pTempFile->pStorageInfo = pAudioInfo;
+    pTempFile->bFloat = FALSE;
     pTempFile->pFile = NULL;
     pTempFile->nBytesWritten = 0;
     pTempFile->pRingbuf = ringbuf_New();
@@ -170,10 +207,55 @@ TempFile* tempfile_Init(GstAudioInfo *pAudioInfo)
     g_assert(ringbuf_Available(pTempFile->pRingbuf) == 0);
 
     pTempFile->nBufPos = 0;
+    pTempFile->nBytesExpected = nBytesExpected;
+    pTempFile->nDataOffset = 0;
+
+    return pTempFile;
+}
+
+TempFile* tempfile_InitIntermediate(GstAudioInfo *pAudioInfo, gint64 nFrames)
+{
+    // 32-bit integers do not fit a float mantissa, so they stay in their own format
+    if (!m_bFloatIntermediates || pAudioInfo->finfo->format == GST_AUDIO_FORMAT_F32LE || GST_AUDIO_FORMAT_INFO_DEPTH(pAudioInfo->finfo) > 24)
+    {
+        return tempfile_Init(pAudioInfo, nFrames * pAudioInfo->bpf);
+    }
+
+    TempFile *pTempFile = tempfile_Init(pAudioInfo, nFrames * pAudioInfo->channels * 4);
+
+    if (pTempFile != NULL)
+    {
+        pTempFile->pStorageInfo = gst_audio_info_new();
+        gst_audio_info_set_format(pTempFile->pStorageInfo, GST_AUDIO_FORMAT_F32LE, pAudioInfo->rate, pAudioInfo->channels, pAudioInfo->position);
+        pTempFile->bFloat = TRUE;
+    }
+
+    return pTempFile;
+}
+
+// Without the memory ring every write reaches the file at once, so readers can follow it while it grows
+TempFile* tempfile_InitStream(GstAudioInfo *pAudioInfo)
+{
+    TempFile *pTempFile = tempfile_Init(pAudioInfo, 0);
+
+    if (pTempFile != NULL)
+    {
+        ringbuf_Free(pTempFile->pRingbuf);
+        pTempFile->pRingbuf = NULL;
+    }
 
     return pTempFile;
 }
 
+static void tempfile_Discard(TempFile *pTempFile)
+{
+    gchar *sFilePath = g_strdup(pTempFile->pFile->sFilePath);
+    file_Close(pTempFile->pFile, FALSE);
+    pTempFile->pFile = NULL;
+    scratch_Unref(sFilePath);
+    g_free(sFilePath);
+}
+
 static gboolean tempfile_writeMain(TempFile *pTempFile, gchar *lBytes, guint nBytes)
 {
     if (nBytes == 0)
@@ -183,15 +265,33 @@ static gboolean tempfile_writeMain(TempFile *pTempFile, gchar *lBytes, guint nBy
 
     if (pTempFile->pFile == NULL)
     {
-        gchar *strFileName = tempfile_GetFileName();
+        gchar *strFileName = scratch_GetFileName(pTempFile->nBytesExpected);
         pTempFile->pFile = file_Open(strFileName, FILE_WRITE, FALSE);
+
+        if (pTempFile->pFile == NULL)
+        {
+            scratch_Unref(strFileName);
+        }
+
         g_free(strFileName);
 
-        if (pTempFile->pFile != NULL && tempfile_WriteWavHeader(pTempFile->pFile, pTempFile->pAudioInfo, 0x7FFFFFFF))
+        if (pTempFile->pFile != NULL && tempfile_WriteWavHeader(pTempFile->pFile, pTempFile->pStorageInfo, 0x7FFFFFFF))
         {
-            file_Close(pTempFile->pFile, TRUE);
-            pTempFile->pFile = NULL;
+            tempfile_Discard(pTempFile);
         }
+
+        if (pTempFile->pFile == NULL)
+        {
+            return TRUE;
+        }
+
+        pTempFile->nDataOffset = file_Tell(pTempFile->pFile);
+    }
+
+    // Fail the write that would overflow a RIFX header, rather than throwing the whole file away when it is finished
+    if (!tempfile_HasRoom(pTempFile->pStorageInfo, pTempFile->nBytesWritten + nBytes))
+    {
+        return TRUE;
     }
 
     gboolean bError = file_Write(lBytes, nBytes, pTempFile->pFile);
@@ -200,7 +300,7 @@ static gboolean tempfile_writeMain(TempFile *pTempFile, gchar *lBytes, guint nBy
     return bError;
 }
 
-gboolean tempfile_Write(TempFile *pTempFile, gchar *lBuffer, guint nBytes)
+static gboolean tempfile_writeRing(TempFile *pTempFile, gchar *lBuffer, guint nBytes)
 {
     gchar *lOutBuffer = lBuffer;
 
@@ -239,11 +339,20 @@ gboolean tempfile_Write(TempFile *pTempFile, gchar *lBuffer, guint nBytes)
     return tempfile_writeMain(pTempFile, lOutBuffer, nBytes);
 }
 
+gboolean tempfile_Write(TempFile *pTempFile, gchar *lBuffer, guint nBytes)
+{
+    gint64 nTraceStart = trace_Begin();
+    gboolean bResult = tempfile_writeRing(pTempFile, lBuffer, nBytes);
+    trace_End("tempfile_Write", nTraceStart);
+
+    return bResult;
+}
+
 void tempfile_Abort(TempFile *pTempFile)
 {
     if (pTempFile->pFile != NULL)
     {
-        file_Close(pTempFile->pFile, TRUE);
+        tempfile_Discard(pTempFile);
     }
 
     if (pTempFile->pRingbuf != NULL)
@@ -251,6 +360,11 @@ void tempfile_Abort(TempFile *pTempFile)
         ringbuf_Free(pTempFile->pRingbuf);
     }
 
+    if (pTempFile->bFloat)
+    {
+        gst_audio_info_free(pTempFile->pStorageInfo);
+    }
+
     g_free(pTempFile);
 }
 
@@ -261,11 +375,12 @@ Chunk *tempfile_Finished(TempFile *pTempFile)
         DataSource *pDataSource = datasource_new();
         pDataSource->nType = DATASOURCE_REAL;
         pDataSource->pAudioInfo = gst_audio_info_copy(pTempFile->pAudioInfo);
+        pDataSource->bFloatStorage = pTempFile->bFloat;
         guint64 nBytes = ringbuf_Available(pTempFile->pRingbuf);
         pDataSource->pData.lReal = g_malloc(nBytes);
         ringbuf_Dequeue(pTempFile->pRingbuf, pDataSource->pData.lReal, nBytes);
         pDataSource->nBytes = (gint64)nBytes;
-        pDataSource->nFrames = (gint64)(nBytes / pDataSource->pAudioInfo->bpf);
+        pDataSource->nFrames = (gint64)(nBytes / pTempFile->pStorageInfo->bpf);
         tempfile_Abort(pTempFile);
 
         return chunk_NewFromDatasource(pDataSource);
@@ -280,16 +395,14 @@ Chunk *tempfile_Finished(TempFile *pTempFile)
 
     if (pTempFile->nBytesWritten == 0)
     {
-        file_Close(pTempFile->pFile, TRUE);
-        pTempFile->pFile = NULL;
+        tempfile_Discard(pTempFile);
         
         goto END;
     }
 
-    if (file_Seek(pTempFile->pFile, 0, SEEK_SET) || tempfile_WriteWavHeader(pTempFile->pFile, pTempFile->pAudioInfo, pTempFile->nBytesWritten))
+    if (file_Seek(pTempFile->pFile, 0, SEEK_SET) || tempfile_WriteWavHeader(pTempFile->pFile, pTempFile->pStorageInfo, pTempFile->nBytesWritten))
     {
-        file_Close(pTempFile->pFile, TRUE);
-        pTempFile->pFile = NULL;
+        tempfile_Discard(pTempFile);
         
         goto END;
     }
@@ -298,8 +411,7 @@ Chunk *tempfile_Finished(TempFile *pTempFile)
 
     if (nOffset < 0)
     {
-        file_Close(pTempFile->pFile, TRUE);
-        pTempFile->pFile = NULL;
+        tempfile_Discard(pTempFile);
         
         goto END;
     }
@@ -307,10 +419,12 @@ Chunk *tempfile_Finished(TempFile *pTempFile)
     DataSource *pDataSource = datasource_new();
     pDataSource->nType = DATASOURCE_TEMPFILE;
     pDataSource->pAudioInfo = gst_audio_info_copy(pTempFile->pAudioInfo);
-    pDataSource->nFrames = pTempFile->nBytesWritten / pTempFile->pAudioInfo->bpf;
-    pDataSource->nBytes = pDataSource->nFrames * pDataSource->pAudioInfo->bpf;
+    pDataSource->bFloatStorage = pTempFile->bFloat;
+    pDataSource->nFrames = pTempFile->nBytesWritten / pTempFile->pStorageInfo->bpf;
+    pDataSource->nBytes = pDataSource->nFrames * pTempFile->pStorageInfo->bpf;
     pDataSource->pData.pVirtual.sFilePath = g_strdup(pTempFile->pFile->sFilePath);
     pDataSource->pData.pVirtual.nOffset = nOffset;
+    scratch_SetSize(pDataSource->pData.pVirtual.sFilePath, nOffset + pTempFile->nBytesWritten);
     file_Close(pTempFile->pFile, FALSE);
     pTempFile->pFile = NULL;
     pChunk = chunk_NewFromDatasource(pDataSource);
@@ -321,3 +435,204 @@ END:
 
     return pChunk;
 }
+
+static guint32 tempfile_GetLE32(guint8 *lBytes)
+{
+    guint32 nValue;
+    memcpy(&nValue, lBytes, 4);
+
+    return GUINT32_FROM_LE(nValue);
+}
+
+static guint64 tempfile_GetLE64(guint8 *lBytes)
+{
+    guint64 nValue;
+    memcpy(&nValue, lBytes, 8);
+
+    return GUINT64_FROM_LE(nValue);
+}
+
+static guint16 tempfile_GetLE16(guint8 *lBytes)
+{
+    guint16 nValue;
+    memcpy(&nValue, lBytes, 2);
+
+    return GUINT16_FROM_LE(nValue);
+}
+
+static GstAudioInfo *tempfile_ReadWavHeader(File *pFile, gint64 nFileSize, gint64 *nOffset, gint64 *nBytes)
+{
+    guint8 lChunk[12];
+    guint8 lData[40];
+
+    if (nFileSize < 20 || file_Read((gchar*)lChunk, 12, pFile) || (memcmp(lChunk, "RIFF", 4) && memcmp(lChunk, "RF64", 4)) || memcmp(lChunk + 8, "WAVE", 4))
+    {
+        return NULL;
+    }
+
+    GstAudioInfo *pAudioInfo = NULL;
+    gboolean bRF64 = !memcmp(lChunk, "RF64", 4);
+    gint64 nPos = 12;
+    gint64 nDataSize = -1;
+
+    while (nPos + 8 <= nFileSize && !file_Read((gchar*)lChunk, 8, pFile))
+    {
+        gint64 nChunkSize = tempfile_GetLE32(lChunk + 4);
+        nPos += 8;
+
+        if (!memcmp(lChunk, "data", 4))
+        {
+            if (pAudioInfo == NULL)
+            {
+                return NULL;
+            }
+
+            *nOffset = nPos;
+            *nBytes = (nChunkSize == 0xFFFFFFFF && nDataSize >= 0) ? nDataSize : nChunkSize;
+
+            return pAudioInfo;
+        }
+
+        gint64 nSkip = nChunkSize + (nChunkSize & 1);
+
+        // RF64 keeps the real 64-bit sizes in ds64, the 32-bit fields read 0xFFFFFFFF
+        if (bRF64 && !memcmp(lChunk, "ds64", 4) && nChunkSize >= 24 && nPos + nChunkSize <= nFileSize)
+        {
+            if (file_Read((gchar*)lData, 24, pFile))
+            {
+                break;
+            }
+
+            nDataSize = tempfile_GetLE64(lData + 8);
+            nPos += 24;
+            nSkip -= 24;
+        }
+        else if (!memcmp(lChunk, "fmt ", 4) && pAudioInfo == NULL && nChunkSize >= 16 && nPos + nChunkSize <= nFileSize)
+        {
+            guint nFormatSize = MIN(nChunkSize, 40);
+
+            if (file_Read((gchar*)lData, nFormatSize, pFile))
+            {
+                return NULL;
+            }
+
+            guint16 nTag = tempfile_GetLE16(lData);
+            guint nChannels = tempfile_GetLE16(lData + 2);
+            guint nRate = tempfile_GetLE32(lData + 4);
+            guint nBlockAlign = tempfile_GetLE16(lData + 12);
+            guint nBits = tempfile_GetLE16(lData + 14);
+            guint64 nMask = 0;
+
+            if (nTag == 0xFFFE && nFormatSize >= 26)
+            {
+                nMask = tempfile_GetLE32(lData + 20);
+                nTag = tempfile_GetLE16(lData + 24);
+            }
+
+            if (nChannels == 0 || nRate == 0 || nBlockAlign % nChannels)
+            {
+                return NULL;
+            }
+
+            GstAudioFormat nFormat = GST_AUDIO_FORMAT_UNKNOWN;
+            guint nWidth = (nBlockAlign / nChannels) * 8;
+
+            if (nTag == 1)
+            {
+                nFormat = gst_audio_format_build_integer(nBits > 8, G_LITTLE_ENDIAN, nWidth, nBits);
+            }
+            else if (nTag == 3 && nWidth == 32)
+            {
+                nFormat = GST_AUDIO_FORMAT_F32LE;
+            }
+            else if (nTag == 3 && nWidth == 64)
+            {
+                nFormat = GST_AUDIO_FORMAT_F64LE;
+            }
+
+            if (nFormat == GST_AUDIO_FORMAT_UNKNOWN)
+            {
+                return NULL;
+            }
+
+            if (nMask == 0)
+            {
+                nMask = gst_audio_channel_get_fallback_mask(nChannels);
+            }
+
+            GstAudioChannelPosition *lPositions = g_newa(GstAudioChannelPosition, nChannels);
+
+            if (!gst_audio_channel_positions_from_mask(nChannels, nMask, lPositions))
+            {
+                lPositions = NULL;
+            }
+
+            pAudioInfo = gst_audio_info_new();
+            gst_audio_info_set_format(pAudioInfo, nFormat, nRate, nChannels, lPositions);
+            nPos += nFormatSize;
+            nSkip -= nFormatSize;
+        }
+
+        if (nPos + nSkip > nFileSize || file_Seek(pFile, nSkip, SEEK_CUR))
+        {
+            break;
+        }
+
+        nPos += nSkip;
+    }
+
+    if (pAudioInfo != NULL)
+    {
+        gst_audio_info_free(pAudioInfo);
+    }
+
+    return NULL;
+}
+
+Chunk *tempfile_Open(gchar *sFilePath)
+{
+    File *pFile = file_Open(sFilePath, FILE_READ, FALSE);
+
+    if (pFile == NULL)
+    {
+        return NULL;
+    }
+
+    gint64 nOffset = 0;
+    gint64 nBytes = 0;
+    gint64 nFileSize = -1;
+    GstAudioInfo *pAudioInfo = NULL;
+
+    if (!file_Seek(pFile, 0, SEEK_END))
+    {
+        nFileSize = file_Tell(pFile);
+    }
+
+    if (nFileSize > 0 && !file_Seek(pFile, 0, SEEK_SET))
+    {
+        pAudioInfo = tempfile_ReadWavHeader(pFile, nFileSize, &nOffset, &nBytes);
+    }
+
+    file_Close(pFile, FALSE);
+
+    if (pAudioInfo == NULL)
+    {
+        return NULL;
+    }
+
+    // Headers of unfinished or oversized files carry 0 or 0xFFFFFFFF
+    if (nBytes == 0 || nBytes == 0xFFFFFFFF || nOffset + nBytes > nFileSize)
+    {
+        nBytes = nFileSize - nOffset;
+    }
+
+    DataSource *pDataSource = datasource_new();
+    pDataSource->nType = DATASOURCE_TEMPFILE;
+    pDataSource->pAudioInfo = pAudioInfo;
+    pDataSource->nFrames = nBytes / pAudioInfo->bpf;
+    pDataSource->nBytes = pDataSource->nFrames * pAudioInfo->bpf;
+    pDataSource->pData.pVirtual.sFilePath = g_strdup(sFilePath);
+    pDataSource->pData.pVirtual.nOffset = nOffset;
+
+    return chunk_NewFromDatasource(pDataSource);
+}
@@ -33,15 +33,22 @@ typedef struct
     gint64 nBytesWritten;
     Ringbuf *pRingbuf;
     GstAudioInfo *pAudioInfo;
+    GstAudioInfo *pStorageInfo;
+    gboolean bFloat;
     gchar lBuffer[64];
     guint nBufPos;
+    gint64 nBytesExpected;
+    gint64 nDataOffset;
     
 } TempFile;
 
-TempFile* tempfile_Init(GstAudioInfo *pAudioInfo);
+void tempfile_LoadSettings();
+TempFile* tempfile_Init(GstAudioInfo *pAudioInfo, gint64 nBytesExpected);
+TempFile* tempfile_InitIntermediate(GstAudioInfo *pAudioInfo, gint64 nFrames);
+TempFile* tempfile_InitStream(GstAudioInfo *pAudioInfo);
 gboolean tempfile_Write(TempFile *pTempFile, gchar *lBuffer, guint nBytes);
 void tempfile_Abort(TempFile *pTempFile);
 Chunk *tempfile_Finished(TempFile *pTempFile);
-gchar *tempfile_GetFileName();
+Chunk *tempfile_Open(gchar *sFilePath);
 
 #endif
@@ -0,0 +1,176 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+#define TRACE_EVENTS 65536
+
+typedef struct
+{
+    const gchar *sName;
+    gint64 nStart;
+    gint64 nEnd;
+
+} TraceEvent;
+
+typedef struct
+{
+    gint nThread;
+    guint nPos;
+    gboolean bWrapped;
+    TraceEvent lEvents[TRACE_EVENTS];
+
+} TraceBuffer;
+
+gboolean g_bTrace = FALSE;
+static gchar *m_sFilePath = NULL;
+static GSList *m_lBuffers = NULL;
+static gint m_nThreads = 0;
+static gint m_nWriters = 0;
+static GPrivate m_pBuffer;
+G_LOCK_DEFINE_STATIC(TRACE_LOCK);
+
+void trace_Init()
+{
+    const gchar *sFilePath = g_getenv("ODIO_EDIT_TRACE");
+
+    if (sFilePath == NULL || *sFilePath == '\0')
+    {
+        return;
+    }
+
+    m_sFilePath = g_strdup(sFilePath);
+    g_bTrace = TRUE;
+}
+
+gint64 trace_Now()
+{
+    struct timespec cTime;
+    clock_gettime(CLOCK_MONOTONIC, &cTime);
+
+    return (gint64)cTime.tv_sec * 1000000000 + cTime.tv_nsec;
+}
+
+void trace_Add(const gchar *sName, gint64 nStart)
+{
+    gint64 nEnd = trace_Now();
+
+    // Writers register before checking the flag, so trace_Finish can wait for those already inside
+    g_atomic_int_inc(&m_nWriters);
+
+    if (!g_atomic_int_get(&g_bTrace))
+    {
+        g_atomic_int_add(&m_nWriters, -1);
+
+        return;
+    }
+
+    TraceBuffer *pBuffer = g_private_get(&m_pBuffer);
+
+    if (pBuffer == NULL)
+    {
+        // Buffers outlive their threads and are only released after the trace is written
+        pBuffer = g_new0(TraceBuffer, 1);
+        pBuffer->nThread = g_atomic_int_add(&m_nThreads, 1) + 1;
+        g_private_set(&m_pBuffer, pBuffer);
+
+        G_LOCK(TRACE_LOCK);
+        m_lBuffers = g_slist_prepend(m_lBuffers, pBuffer);
+        G_UNLOCK(TRACE_LOCK);
+    }
+
+    TraceEvent *pEvent = &pBuffer->lEvents[pBuffer->nPos];
+    pEvent->sName = sName;
+    pEvent->nStart = nStart;
+    pEvent->nEnd = nEnd;
+
+    if (++pBuffer->nPos == TRACE_EVENTS)
+    {
+        pBuffer->nPos = 0;
+        pBuffer->bWrapped = TRUE;
+    }
+
+    g_atomic_int_add(&m_nWriters, -1);
+}
+
+void trace_Finish()
+{
+    if (!g_atomic_int_get(&g_bTrace))
+    {
+        return;
+    }
+
+    g_atomic_int_set(&g_bTrace, FALSE);
+
+    while (g_atomic_int_get(&m_nWriters) > 0)
+    {
+        g_thread_yield();
+    }
+
+    FILE *pFile = fopen(m_sFilePath, "w");
+
+    if (pFile == NULL)
+    {
+        g_warning("Could not write trace to %s: %s", m_sFilePath, strerror(errno));
+    }
+    else
+    {
+        gint nPid = getpid();
+        gboolean bFirst = TRUE;
+        fputs("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n", pFile);
+
+        G_LOCK(TRACE_LOCK);
+
+        for (GSList *l = m_lBuffers; l != NULL; l = l->next)
+        {
+            TraceBuffer *pBuffer = (TraceBuffer*)l->data;
+            guint nEvents = pBuffer->bWrapped ? TRACE_EVENTS : pBuffer->nPos;
+            guint nFirst = pBuffer->bWrapped ? pBuffer->nPos : 0;
+
+            fprintf(pFile, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}", bFirst ? "" : ",\n", nPid, pBuffer->nThread, pBuffer->nThread);
+            bFirst = FALSE;
+
+            for (guint nEvent = 0; nEvent < nEvents; nEvent++)
+            {
+                TraceEvent *pEvent = &pBuffer->lEvents[(nFirst + nEvent) % TRACE_EVENTS];
+                fprintf(pFile, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}", pEvent->sName, nPid, pBuffer->nThread, pEvent->nStart / 1000.0, (pEvent->nEnd - pEvent->nStart) / 1000.0);
+            }
+        }
+
+        G_UNLOCK(TRACE_LOCK);
+
+        fputs("\n]}\n", pFile);
+        fclose(pFile);
+        g_info("Trace written to %s", m_sFilePath);
+    }
+
+    G_LOCK(TRACE_LOCK);
+    g_slist_free_full(m_lBuffers, g_free);
+    m_lBuffers = NULL;
+    G_UNLOCK(TRACE_LOCK);
+
+    g_free(m_sFilePath);
+    m_sFilePath = NULL;
+}
@@ -0,0 +1,37 @@
+/*
+    Copyright (C) 2025, Robert Tari <robert@tari.in>
+
+    This file is part of Odio Edit.
+
+    Odio Edit is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Odio Edit is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with odio-edit; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <glib.h>
+
+extern gboolean g_bTrace;
+
+void trace_Init();
+void trace_Finish();
+gint64 trace_Now();
+void trace_Add(const gchar *sName, gint64 nStart);
+
+// Spans are cheap enough to leave in hot paths: with tracing off they cost one branch
+#define trace_Begin() (G_UNLIKELY(g_bTrace) ? trace_Now() : 0)
+#define trace_End(sName, nStart) G_STMT_START { if (G_UNLIKELY(nStart)) trace_Add(sName, nStart); } G_STMT_END
+
+#endif
@@ -22,6 +22,8 @@
 #include <math.h>
 #include "viewcache.h"
 #include "main.h"
+#include "trace.h"
+#include "counters.h"
 
 #define CALC_UNKNOWN 0
 #define CALC_DIRTY 1
@@ -83,7 +85,7 @@ void viewcache_Free(ViewCache *pViewCache)
     g_free(pViewCache);
 }
 
-gboolean viewcache_Update(ViewCache *pCache, Chunk *pChunk, gint64 nStartFrame, gint64 nEndFrame, gint nWidth, gint *nUpdatedLeft, gint *nUpdatedRight)
+static gboolean viewcache_updateMain(ViewCache *pCache, Chunk *pChunk, gint64 nStartFrame, gint64 nEndFrame, gint nWidth, gint *nUpdatedLeft, gint *nUpdatedRight)
 {
     if (pCache->bReading)
     {
@@ -370,6 +372,7 @@ gboolean viewcache_Update(ViewCache *pCache, Chunk *pChunk, gint64 nStartFrame,
     }
 
     memset(pCache->lCalced + nUncalcStart, CALC_DONE, nUncalcEnd - nUncalcStart);
+    counters_Add(COUNTER_VIEWCACHE_PIXELS, nUncalcEnd - nUncalcStart);
 
     if (nUpdatedLeft)
     {
@@ -444,6 +447,15 @@ gboolean viewcache_Update(ViewCache *pCache, Chunk *pChunk, gint64 nStartFrame,
     return TRUE;
 }
 
+gboolean viewcache_Update(ViewCache *pCache, Chunk *pChunk, gint64 nStartFrame, gint64 nEndFrame, gint nWidth, gint *nUpdatedLeft, gint *nUpdatedRight)
+{
+    gint64 nTraceStart = trace_Begin();
+    gboolean bResult = viewcache_updateMain(pCache, pChunk, nStartFrame, nEndFrame, nWidth, nUpdatedLeft, nUpdatedRight);
+    trace_End("viewcache_Update", nTraceStart);
+
+    return bResult;
+}
+
 gboolean viewcache_Updated(ViewCache *pViewCache)
 {
     return (pViewCache->pChunkHandle == NULL);
@@ -456,6 +468,7 @@ void viewcache_DrawPart(ViewCache *pViewCache, cairo_t *pCairo, gint nWidth, gin
         return;
     }
 
+    gint64 nTraceStart = trace_Begin();
     guint nChannels = (pViewCache->pChunk) ? pViewCache->pChunk->pAudioInfo->channels : 1;
     gfloat nChannelHeight = nHeight / (2 * nChannels) - 5;
     Segment *pSegment1 = g_malloc(((nChannels + 1) / 2) * nWidth * sizeof(Segment));
@@ -593,6 +606,7 @@ void viewcache_DrawPart(ViewCache *pViewCache, cairo_t *pCairo, gint nWidth, gin
         *pSegment = nSegmentCurr;
     }
 
+    gint64 nTraceStroke = trace_Begin();
     cairo_set_line_width(pCairo, 1);
     gdk_cairo_set_source_rgba(pCairo, &g_lColours[WAVE1]);
 
@@ -617,6 +631,8 @@ void viewcache_DrawPart(ViewCache *pViewCache, cairo_t *pCairo, gint nWidth, gin
         }
     }
 
+    trace_End("cairo_stroke", nTraceStroke);
     g_free(pSegment1);
     g_free(pSegment2);
+    trace_End("viewcache_DrawPart", nTraceStart);
 }